@@ -135,8 +135,10 @@ int cgp_main(algo_data_t *wd)
                     ga_reevaluate_pop(wd->pred_population);
                     #pragma omp critical (PRED_ARCHIVE__CGP_POP)
                     {
-                        ga_reevaluate_chr(wd->pred_population,
-                            arc_get(wd->pred_archive, 0));
+                        ga_chr_t archived = arc_get(wd->pred_archive, 0);
+                        ga_reevaluate_chr(wd->pred_population, archived);
+                        // circular predictor may have changed its phenotype
+                        pred_prepare_for_simd(archived->genome);
                     }
                 }
 
@@ -197,6 +199,9 @@ int cgp_main(algo_data_t *wd)
                 predicted_fitness,
                 active_predictor_fitness,
                 fitness_get_cgp_evals(),
+                cgp_get_skipped_evals(),
+                fitness_get_cgp_aborted_evals(),
+                fitness_get_cgp_saved_pixels(),
                 pred_length,
                 pred_used_length,
                 pred_generation
@@ -295,13 +300,17 @@ void pred_main(algo_data_t *wd)
                 int old_used_length = ((pred_genome_t) arc_get(wd->pred_archive, 0)->genome)->used_pixels;
                 int new_used_length;
 
-                pred_set_length(new_length);
-
                 // recalculate predictors' phenotypes
-                pred_pop_calculate_phenotype(wd->pred_population);
+                #pragma omp critical (CGP_ARCHIVE__PRED_POP)
+                {
+                    pred_set_length(new_length);
+                    pred_pop_calculate_phenotype(wd->pred_population);
+                }
                 #pragma omp critical (PRED_ARCHIVE__CGP_POP)
                 {
-                    pred_calculate_phenotype(arc_get(wd->pred_archive, 0)->genome);
+                    pred_genome_t active = arc_get(wd->pred_archive, 0)->genome;
+                    pred_calculate_phenotype(active);
+                    pred_prepare_for_simd(active);
                 }
 
                 ga_chr_t active_predictor = arc_get(wd->pred_archive, 0);
@@ -313,8 +322,10 @@ void pred_main(algo_data_t *wd)
                     ga_reevaluate_pop(wd->pred_population);
                     #pragma omp critical (PRED_ARCHIVE__CGP_POP)
                     {
-                        ga_reevaluate_chr(wd->pred_population,
-                            arc_get(wd->pred_archive, 0));
+                        ga_chr_t archived = arc_get(wd->pred_archive, 0);
+                        ga_reevaluate_chr(wd->pred_population, archived);
+                        // circular predictor may have changed its phenotype
+                        pred_prepare_for_simd(archived->genome);
                     }
                 }
 
@@ -348,10 +359,17 @@ void pred_main(algo_data_t *wd)
             );
 
             // store and invalidate CGP fitness
-            #pragma omp critical (PRED_ARCHIVE__CGP_POP)
+            // CGP thread may be reevaluating (and recalculating circular
+            // phenotypes of) predictors population at the same time
+            #pragma omp critical (CGP_ARCHIVE__PRED_POP)
             {
-                arc_insert(wd->pred_archive, wd->pred_population->best_chromosome);
-                ga_reevaluate_pop(wd->cgp_population);
+                #pragma omp critical (PRED_ARCHIVE__CGP_POP)
+                {
+                    ga_chr_t archived = arc_insert(wd->pred_archive,
+                        wd->pred_population->best_chromosome);
+                    pred_prepare_for_simd(archived->genome);
+                    ga_reevaluate_pop(wd->cgp_population);
+                }
             }
         }
     }
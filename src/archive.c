@@ -116,7 +116,8 @@ void arc_empty(archive_t arc)
  *
  * Chromosome is copied into place and pointer to it is returned.
  *
- * Chromosome is reevaluated using `arc->methods.fitness` (if set).
+ * Chromosome is reevaluated using `arc->methods.slot_fitness` or
+ * `arc->methods.fitness` (if set).
  *
  * @param  arc
  * @param  chr
@@ -128,7 +129,11 @@ ga_chr_t arc_insert(archive_t arc, ga_chr_t chr)
     ga_copy_chr(dst, chr, arc->methods.copy_genome);
     arc->original_fitness[arc->pointer] = chr->has_fitness? chr->fitness : 0;
 
-    if (arc->methods.fitness != NULL) {
+    if (arc->methods.slot_fitness != NULL) {
+        dst->fitness = arc->methods.slot_fitness(arc, arc->pointer);
+        dst->has_fitness = true;
+
+    } else if (arc->methods.fitness != NULL) {
         dst->fitness = arc->methods.fitness(dst);
         dst->has_fitness = true;
     }
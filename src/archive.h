@@ -29,6 +29,16 @@
 #include "ga.h"
 
 
+typedef struct archive* archive_t;
+
+
+/**
+ * Fitness function which gets archive slot of evaluated chromosome too,
+ * so that data computed for the chromosome can be kept for each slot
+ */
+typedef ga_fitness_t (*arc_slot_fitness_func_t)(archive_t arc, int slot);
+
+
  /**
   * User-defined methods
   */
@@ -42,6 +52,9 @@
 
      /* fitness function */
      ga_fitness_func_t fitness;
+
+     /* fitness function with archive slot, used instead of `fitness` */
+     arc_slot_fitness_func_t slot_fitness;
  } arc_func_vect_t;
 
 
@@ -72,7 +85,6 @@ struct archive
     /* problem type to determine best item */
     ga_problem_type_t problem_type;
 };
-typedef struct archive* archive_t;
 
 
 /**
@@ -103,7 +115,8 @@ void arc_empty(archive_t arc);
  *
  * Chromosome is copied into place and pointer to it is returned.
  *
- * Chromosome is reevaluated using `arc->methods.fitness` (if set).
+ * Chromosome is reevaluated using `arc->methods.slot_fitness` or
+ * `arc->methods.fitness` (if set).
  *
  * @param  arc
  * @param  chr
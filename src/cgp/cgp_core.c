@@ -35,6 +35,8 @@ typedef struct {
 static int_array _allowed_gene_vals[CGP_COLS];
 static int _mutation_rate;
 static ga_fitness_func_t _fitness_func;
+static ga_fitness_batch_func_t _fitness_batch_func;
+static long _skipped_evals;
 
 
 #ifdef CGP_LIMIT_FUNCS
@@ -66,10 +68,13 @@ static ga_fitness_func_t _fitness_func;
 /**
  * Initialize CGP internals
  */
-void cgp_init(int mutation_rate, ga_fitness_func_t fitness_func)
+void cgp_init(int mutation_rate, ga_fitness_func_t fitness_func,
+    ga_fitness_batch_func_t fitness_batch_func)
 {
     _mutation_rate = mutation_rate;
     _fitness_func = fitness_func;
+    _fitness_batch_func = fitness_batch_func;
+    _skipped_evals = 0;
 
     // calculate allowed values of node inputs in each column
     for (int x = 0; x < CGP_COLS; x++) {
@@ -136,6 +141,7 @@ ga_pop_t cgp_init_pop(int pop_size)
         .init_genome = cgp_randomize_genome,
 
         .fitness = _fitness_func,
+        .fitness_batch = _fitness_batch_func,
         .offspring = cgp_offspring,
     };
 
@@ -248,13 +254,18 @@ void cgp_mutate_chr(ga_chr_t chromosome)
     assert(_mutation_rate <= CGP_CHR_LENGTH);
     cgp_genome_t genome = (cgp_genome_t) chromosome->genome;
 
+    bool phenotype_changed = false;
     int genes_to_change = rand_range(1, _mutation_rate);
     for (int i = 0; i < genes_to_change; i++) {
         int gene = rand_range(0, CGP_CHR_LENGTH - 1);
-        cgp_randomize_gene(genome, gene);
+        phenotype_changed |= cgp_randomize_gene(genome, gene);
     }
 
-    cgp_find_active_blocks(chromosome);
+    // program is compiled from active nodes only, so there is nothing
+    // to rebuild if none of them has changed
+    if (phenotype_changed) {
+        cgp_find_active_blocks(chromosome);
+    }
     chromosome->has_fitness = false;
 }
 
@@ -272,6 +283,9 @@ void cgp_copy_genome(void *_dst, void *_src)
 
     memcpy(dst->nodes, src->nodes, sizeof(cgp_node_t) * CGP_NODES);
     memcpy(dst->outputs, src->outputs, sizeof(int) * CGP_OUTPUTS);
+    memcpy(dst->program, src->program, sizeof(cgp_instr_t) * src->program_length);
+    dst->program_length = src->program_length;
+    dst->phenotype_hash = src->phenotype_hash;
 }
 
 
@@ -297,14 +311,13 @@ bool cgp_get_output(ga_chr_t chromosome, cgp_value_t *inputs, cgp_value_t *outpu
     // copy primary inputs to working array
     memcpy(inner_outputs, inputs, sizeof(cgp_value_t) * CGP_INPUTS);
 
-    for (int i = 0; i < CGP_NODES; i++) {
-        cgp_node_t *n = &(genome->nodes[i]);
+    // only active blocks are compiled into program
+    for (int i = 0; i < genome->program_length; i++) {
+        cgp_instr_t *instr = &(genome->program[i]);
+        cgp_node_t *n = &(genome->nodes[instr->output - CGP_INPUTS]);
 
-        // skip inactive blocks
-        if (!n->is_active) continue;
-
-        cgp_value_t A = inner_outputs[n->inputs[0]];
-        cgp_value_t B = inner_outputs[n->inputs[1]];
+        cgp_value_t A = inner_outputs[instr->inputs[0]];
+        cgp_value_t B = inner_outputs[instr->inputs[1]];
         cgp_value_t Y;
 
         if (n->is_constant) {
@@ -317,7 +330,7 @@ bool cgp_get_output(ga_chr_t chromosome, cgp_value_t *inputs, cgp_value_t *outpu
             }
         }
 
-        inner_outputs[CGP_INPUTS + i] = Y;
+        inner_outputs[instr->output] = Y;
     }
 
     for (int i = 0; i < CGP_OUTPUTS; i++) {
@@ -338,7 +351,43 @@ bool cgp_get_output(ga_chr_t chromosome, cgp_value_t *inputs, cgp_value_t *outpu
 
 
 /**
- * Finds which blocks are active.
+ * One step of FNV-1a hash
+ */
+static inline uint64_t _fnv_add(uint64_t hash, uint64_t value)
+{
+    return (hash ^ value) * 1099511628211ULL;
+}
+
+
+/**
+ * Calculates FNV-1a hash of compiled phenotype and output connections.
+ * Only inputs used by node function are included, so rewiring unused
+ * input of unary function does not change the hash.
+ * @param genome
+ */
+static uint64_t _cgp_phenotype_hash(cgp_genome_t genome)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < genome->program_length; i++) {
+        cgp_instr_t *instr = &(genome->program[i]);
+        hash = _fnv_add(hash, instr->output);
+        hash = _fnv_add(hash, instr->function);
+        for (int k = 0; k < CGP_FUNC_ARITY[instr->function]; k++) {
+            hash = _fnv_add(hash, instr->inputs[k]);
+        }
+    }
+
+    for (int i = 0; i < CGP_OUTPUTS; i++) {
+        hash = _fnv_add(hash, genome->outputs[i]);
+    }
+
+    return hash;
+}
+
+
+/**
+ * Finds which blocks are active and compiles them into program.
  * @param chromosome
  * @param active
  */
@@ -375,10 +424,68 @@ void cgp_find_active_blocks(ga_chr_t chromosome)
             }
         }
     }
+
+    cgp_build_program(genome);
+    genome->phenotype_hash = _cgp_phenotype_hash(genome);
+}
+
+
+/**
+ * Compiles nodes marked as active into linear program (instruction tape)
+ * used by evaluators. Called by `cgp_find_active_blocks`.
+ * @param genome
+ */
+void cgp_build_program(cgp_genome_t genome)
+{
+    int length = 0;
+
+    // nodes can be connected only to the left, so node order is also
+    // valid evaluation order
+    for (int i = 0; i < CGP_NODES; i++) {
+        cgp_node_t *n = &(genome->nodes[i]);
+        if (!n->is_active) continue;
+
+        cgp_instr_t *instr = &(genome->program[length]);
+        instr->function = n->function;
+        instr->output = CGP_INPUTS + i;
+        for (int k = 0; k < CGP_FUNC_INPUTS; k++) {
+            instr->inputs[k] = n->inputs[k];
+        }
+        length++;
+    }
+
+    genome->program_length = length;
 }
 
 
 
+/**
+ * Returns whether both genomes compute the same function - whether
+ * they have the same active nodes, wired the same way
+ * @param a
+ * @param b
+ */
+bool cgp_same_phenotype(cgp_genome_t a, cgp_genome_t b)
+{
+    if (a->phenotype_hash != b->phenotype_hash) return false;
+
+    // hashes match, make sure it is not a collision
+    if (a->program_length != b->program_length) return false;
+    if (memcmp(a->outputs, b->outputs, sizeof(int) * CGP_OUTPUTS) != 0) return false;
+
+    for (int i = 0; i < a->program_length; i++) {
+        cgp_instr_t *x = &(a->program[i]);
+        cgp_instr_t *y = &(b->program[i]);
+        if (x->output != y->output || x->function != y->function) return false;
+        for (int k = 0; k < CGP_FUNC_ARITY[x->function]; k++) {
+            if (x->inputs[k] != y->inputs[k]) return false;
+        }
+    }
+
+    return true;
+}
+
+
 /* population *****************************************************************/
 
 
@@ -390,6 +497,7 @@ void cgp_find_active_blocks(ga_chr_t chromosome)
 void cgp_offspring(ga_pop_t pop)
 {
     ga_chr_t parent = pop->best_chromosome;
+    cgp_genome_t parent_genome = (cgp_genome_t) parent->genome;
 
     #pragma omp parallel for
     for (int i = 0; i < pop->size; i++) {
@@ -397,5 +505,25 @@ void cgp_offspring(ga_pop_t pop)
         if (chr == parent) continue;
         ga_copy_chr(chr, parent, cgp_copy_genome);
         cgp_mutate_chr(chr);
+
+        // neutral mutation - offspring computes the same function as
+        // parent, so it would get the same fitness
+        if (parent->has_fitness
+            && cgp_same_phenotype((cgp_genome_t) chr->genome, parent_genome)) {
+            chr->fitness = parent->fitness;
+            chr->has_fitness = true;
+            #pragma omp atomic
+                _skipped_evals++;
+        }
     }
 }
+
+
+/**
+ * Returns number of offspring whose evaluation was skipped, because
+ * they had the same phenotype as their parent
+ */
+long cgp_get_skipped_evals()
+{
+    return _skipped_evals;
+}
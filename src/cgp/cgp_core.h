@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include "../ga.h"
 
 
@@ -49,20 +51,41 @@ typedef struct {
 } cgp_node_t;
 
 
+/**
+ * One instruction of compiled phenotype (= one active node)
+ */
+typedef struct {
+    cgp_func_t function;
+    int inputs[CGP_FUNC_INPUTS];
+    int output;
+} cgp_instr_t;
+
+
 /**
  * Chromosome
  */
 struct cgp_genome {
     cgp_node_t nodes[CGP_NODES];
     int outputs[CGP_OUTPUTS];
+
+    /* compiled phenotype - active nodes only, in evaluation order */
+    int program_length;
+    cgp_instr_t program[CGP_NODES];
+
+    /* fingerprint of compiled phenotype, equal phenotypes have equal hash */
+    uint64_t phenotype_hash;
 };
 typedef struct cgp_genome* cgp_genome_t;
 
 
 /**
  * Initialize CGP internals
+ * @param mutation_rate
+ * @param fitness_func
+ * @param fitness_batch_func Evaluates whole population at once, may be NULL
  */
-void cgp_init(int mutation_rate, ga_fitness_func_t fitness_func);
+void cgp_init(int mutation_rate, ga_fitness_func_t fitness_func,
+    ga_fitness_batch_func_t fitness_batch_func);
 
 
 /**
@@ -202,8 +225,32 @@ static inline int cgp_node_row(int index)
 
 
 /**
- * Finds which blocks are active.
+ * Finds which blocks are active and compiles them into program.
  * @param chromosome
  * @param active
  */
 void cgp_find_active_blocks(ga_chr_t chromosome);
+
+
+/**
+ * Compiles nodes marked as active into linear program (instruction tape)
+ * used by evaluators. Called by `cgp_find_active_blocks`.
+ * @param genome
+ */
+void cgp_build_program(cgp_genome_t genome);
+
+
+/**
+ * Returns whether both genomes compute the same function - whether
+ * they have the same active nodes, wired the same way
+ * @param a
+ * @param b
+ */
+bool cgp_same_phenotype(cgp_genome_t a, cgp_genome_t b);
+
+
+/**
+ * Returns number of offspring whose evaluation was skipped, because
+ * they had the same phenotype as their parent
+ */
+long cgp_get_skipped_evals();
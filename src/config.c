@@ -58,6 +58,10 @@
 #define OPT_CGP_MUTATE 'm'
 #define OPT_CGP_POPSIZE 'p'
 #define OPT_CGP_ARCSIZE 's'
+#define OPT_CGP_NODE_CACHE 2001
+#define OPT_CGP_JIT 2002
+#define OPT_IMAGES 2003
+#define OPT_DATASET_CACHE 2004
 
 #define OPT_PRED_SIZE 'S'
 #define OPT_PRED_MUTATE 'M'
@@ -102,6 +106,8 @@ static struct option long_options[] =
         /* Input images */
         {"original", required_argument, 0, OPT_ORIGINAL},
         {"noisy", required_argument, 0, OPT_NOISY},
+        {"images", required_argument, 0, OPT_IMAGES},
+        {"dataset-cache", required_argument, 0, OPT_DATASET_CACHE},
         {"target-psnr", required_argument, 0, OPT_TARGET_PSNR},
     #endif
 
@@ -123,6 +129,10 @@ static struct option long_options[] =
     {"cgp-mutate", required_argument, 0, OPT_CGP_MUTATE},
     {"cgp-population-size", required_argument, 0, OPT_CGP_POPSIZE},
     {"cgp-archive-size", required_argument, 0, OPT_CGP_ARCSIZE},
+    #ifndef SYMREG
+        {"cgp-node-cache", required_argument, 0, OPT_CGP_NODE_CACHE},
+        {"cgp-jit", no_argument, 0, OPT_CGP_JIT},
+    #endif
 
     /* Predictors */
     {"pred-size", required_argument, 0, OPT_PRED_SIZE},
@@ -263,6 +273,16 @@ config_retval_t config_load_args(int argc, char **argv, config_t *cfg)
                     strncpy(cfg->noisy_image, optarg, MAX_FILENAME_LENGTH);
                     break;
 
+                case OPT_IMAGES:
+                    CHECK_FILENAME_LENGTH;
+                    strncpy(cfg->images_list, optarg, MAX_FILENAME_LENGTH);
+                    break;
+
+                case OPT_DATASET_CACHE:
+                    CHECK_FILENAME_LENGTH;
+                    strncpy(cfg->dataset_cache, optarg, MAX_FILENAME_LENGTH);
+                    break;
+
                 case OPT_TARGET_PSNR:
                     PARSE_DOUBLE(target_psnr);
                     cfg->target_fitness = pow(10, (target_psnr / 10));
@@ -328,6 +348,16 @@ config_retval_t config_load_args(int argc, char **argv, config_t *cfg)
                 PARSE_INT(cfg->cgp_archive_size);
                 break;
 
+            #ifndef SYMREG
+                case OPT_CGP_NODE_CACHE:
+                    PARSE_INT(cfg->cgp_node_cache);
+                    break;
+
+                case OPT_CGP_JIT:
+                    cfg->cgp_jit = true;
+                    break;
+            #endif
+
             case OPT_PRED_SIZE:
                 PARSE_PERCENT(cfg->pred_size);
                 break;
@@ -495,6 +525,8 @@ void config_save_file(FILE *file, config_t *cfg)
         fprintf(file, "task: image filter\n");
         fprintf(file, "original: %s\n", cfg->input_image);
         fprintf(file, "noisy: %s\n", cfg->noisy_image);
+        fprintf(file, "images: %s\n", cfg->images_list);
+        fprintf(file, "dataset-cache: %s\n", cfg->dataset_cache);
     #endif
     fprintf(file, "algorithm: %s\n", config_algorithm_names[cfg->algorithm]);
     fprintf(file, "random-seed: %u\n", cfg->random_seed);
@@ -508,6 +540,10 @@ void config_save_file(FILE *file, config_t *cfg)
     fprintf(file, "cgp-mutate: %d\n", cfg->cgp_mutate_genes);
     fprintf(file, "cgp-population-size: %d\n", cfg->cgp_population_size);
     fprintf(file, "cgp-archive-size: %d\n", cfg->cgp_archive_size);
+    #ifndef SYMREG
+        fprintf(file, "cgp-node-cache: %d\n", cfg->cgp_node_cache);
+        fprintf(file, "cgp-jit: %s\n", cfg->cgp_jit? "yes" : "no");
+    #endif
     fprintf(file, "\n");
     fprintf(file, "pred-size: %.5g\n", cfg->pred_size);
     fprintf(file, "pred-mutate: %.5g\n", cfg->pred_mutation_rate);
@@ -555,6 +591,12 @@ void config_save_file(FILE *file, config_t *cfg)
     #else
         fprintf(file, "# OpenMP: no\n");
     #endif
+    #ifdef AVX512
+        fprintf(file, "# AVX-512BW compiled: yes\n");
+    #else
+        fprintf(file, "# AVX-512BW compiled: no\n");
+    #endif
+    fprintf(file, "# AVX-512BW supported by CPU/OS: %s\n", can_use_avx512bw()? "yes" : "no");
     #ifdef AVX2
         fprintf(file, "# AVX2 compiled: yes\n");
     #else
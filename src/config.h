@@ -61,6 +61,8 @@ typedef struct
     #else
         char input_image[MAX_FILENAME_LENGTH + 1];
         char noisy_image[MAX_FILENAME_LENGTH + 1];
+        char images_list[MAX_FILENAME_LENGTH + 1];
+        char dataset_cache[MAX_FILENAME_LENGTH + 1];
     #endif
 
     int max_generations;
@@ -71,6 +73,10 @@ typedef struct
     int cgp_mutate_genes;
     int cgp_population_size;
     int cgp_archive_size;
+    #ifndef SYMREG
+        int cgp_node_cache;
+        bool cgp_jit;
+    #endif
 
     float pred_size;
     float pred_initial_size;
@@ -140,6 +146,15 @@ static inline void print_help() {
         "          Original (target) image filename.\n"
         "    --noisy FILE, -n FILE\n"
         "          Noisy (source) image filename.\n"
+        "    --images FILE\n"
+        "          Text file with one pair of original and noisy image filenames\n"
+        "          per line, used instead of --original and --noisy. Fitness is\n"
+        "          computed over all pixels of all listed images. Relative paths\n"
+        "          are relative to the list file.\n"
+        "    --dataset-cache DIR\n"
+        "          Directory with decoded input images. Images are stored there\n"
+        "          on first run and mapped to memory by later runs with the same\n"
+        "          input files.\n"
     #endif
         "\n"
         "Optional:\n"
@@ -194,6 +209,18 @@ static inline void print_help() {
         "    --cgp-archive-size NUM, -s NUM\n"
         "          CGP archive size, default is 10.\n"
         "\n"
+    #ifndef SYMREG
+        "    --cgp-node-cache NUM\n"
+        "          Memory limit (in MiB) for caching parent's node outputs, which\n"
+        "          allows offspring to be evaluated incrementally, default is 64.\n"
+        "          If the image needs more memory, the cache is not used.\n"
+        "          Use 0 to disable.\n"
+        "\n"
+        "    --cgp-jit\n"
+        "          Compile evaluated circuits to native SSE2/AVX2 code instead of\n"
+        "          interpreting them. Node cache is not used in this mode.\n"
+        "\n"
+    #endif
         "    --pred-size NUM, -S NUM\n"
         "          Predictor size (in percent), default is 0.25.\n"
         "\n"
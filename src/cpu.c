@@ -38,6 +38,11 @@ int check_4th_gen_intel_core_features()
     return _may_i_use_cpu_feature( the_4th_gen_features );
 }
 
+int check_avx512bw()
+{
+    return _may_i_use_cpu_feature(_FEATURE_AVX512F | _FEATURE_AVX512BW);
+}
+
 int check_sse4_1()
 {
     return _may_i_use_cpu_feature(_FEATURE_SSE4_1);
@@ -116,6 +121,47 @@ int check_4th_gen_intel_core_features()
     return 1;
 }
 
+int check_xcr0_zmm()
+{
+        uint32_t xcr0;
+        uint32_t zmm_ymm_xmm = (7 << 5) | (1 << 2) | (1 << 1);
+    #if defined(_MSC_VER)
+        xcr0 = (uint32_t)_xgetbv(0);
+    #else
+        __asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "%edx" );
+    #endif
+        /* checking if xmm, ymm, opmask and zmm state are enabled in XCR0 */
+        return ((xcr0 & zmm_ymm_xmm) == zmm_ymm_xmm);
+}
+
+
+/**
+ * Checks whether current CPU supports AVX-512F and AVX-512BW instruction sets
+ */
+int check_avx512bw()
+{
+    uint32_t abcd[4];
+    uint32_t osxsave_mask = (1 << 27);
+    uint32_t avx512f_bw_mask = (1 << 16) | (1 << 30);
+
+    /* CPUID.(EAX=01H, ECX=0H):ECX.OSXSAVE[bit 27]==1 */
+    run_cpuid( 1, 0, abcd );
+    if ( (abcd[2] & osxsave_mask) != osxsave_mask )
+        return 0;
+
+    if ( ! check_xcr0_zmm() )
+        return 0;
+
+    /*  CPUID.(EAX=07H, ECX=0H):EBX.AVX512F[bit 16]==1  &&
+        CPUID.(EAX=07H, ECX=0H):EBX.AVX512BW[bit 30]==1 */
+    run_cpuid( 7, 0, abcd );
+    if ( (abcd[1] & avx512f_bw_mask) != avx512f_bw_mask )
+        return 0;
+
+    return 1;
+}
+
+
 /**
  * Checks whether current CPU supports SSE4.1 instruction set
  *
@@ -168,6 +214,18 @@ bool can_use_intel_core_4th_gen_features()
 }
 
 
+/**
+ * Checks whether current CPU supports AVX-512 Foundation and Byte/Word
+ * instructions
+ */
+bool can_use_avx512bw()
+{
+    static int available = -1;
+    if (available < 0) available = check_avx512bw();
+    return available;
+}
+
+
 /**
  * Checks whether current CPU supports SSE4.1 instruction set
  */
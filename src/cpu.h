@@ -39,6 +39,13 @@
 bool can_use_intel_core_4th_gen_features();
 
 
+/**
+ * Checks whether current CPU supports AVX-512 Foundation and Byte/Word
+ * instructions
+ */
+bool can_use_avx512bw();
+
+
 /**
  * Checks whether current CPU supports SSE4.1 instruction set
  */
@@ -58,6 +65,12 @@ static inline bool can_use_simd() {
         return false;
     #endif
 
+    #ifdef AVX512
+        if (can_use_avx512bw()) {
+            return true;
+        }
+    #endif
+
     #ifdef AVX2
         if (can_use_intel_core_4th_gen_features()) {
             return true;
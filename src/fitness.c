@@ -24,12 +24,12 @@
 #endif
 
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
 #include "cpu.h"
-#include "random.h"
 #include "fitness.h"
 #include "inputdata.h"
 
@@ -37,7 +37,12 @@
 input_data_t *fitness_input_data;
 archive_t fitness_cgp_archive;
 archive_t fitness_pred_archive;
-long fitness_cgp_evals;
+fitness_counters_t fitness_counters[FITNESS_COUNTER_SLOTS];
+
+
+// counters slot of current thread, assigned on first use
+static _Thread_local int _counter_slot = -1;
+static int _counter_slots_used = 0;
 
 
 /**
@@ -53,7 +58,7 @@ void fitness_init(config_t *config, input_data_t *input,
     fitness_input_data = input;
     fitness_cgp_archive = cgp_archive;
     fitness_pred_archive = pred_archive;
-    fitness_cgp_evals = 0;
+    memset(fitness_counters, 0, sizeof(fitness_counters));
     _fitness_init(config, input, cgp_archive, pred_archive);
 }
 
@@ -63,6 +68,81 @@ void fitness_init(config_t *config, input_data_t *input,
  */
 void fitness_deinit()
 {
+    _fitness_deinit();
+}
+
+
+/**
+ * Adds to evaluation counters of calling thread
+ *
+ * @param evals Number of evaluated pixels (fitness cases)
+ * @param aborted Number of evaluations stopped early
+ * @param saved_pixels Number of pixels skipped by stopping early
+ */
+void fitness_count_cgp_evals(long evals, long aborted, long saved_pixels)
+{
+    if (_counter_slot < 0) {
+        #pragma omp atomic capture
+            _counter_slot = _counter_slots_used++;
+    }
+
+    if (_counter_slot < FITNESS_COUNTER_SLOTS - 1) {
+        fitness_counters_t *counters = &fitness_counters[_counter_slot];
+        counters->cgp_evals += evals;
+        counters->cgp_aborted_evals += aborted;
+        counters->cgp_saved_pixels += saved_pixels;
+
+    } else {
+        // too many threads, last slot is shared
+        fitness_counters_t *counters = &fitness_counters[FITNESS_COUNTER_SLOTS - 1];
+        #pragma omp atomic
+            counters->cgp_evals += evals;
+        #pragma omp atomic
+            counters->cgp_aborted_evals += aborted;
+        #pragma omp atomic
+            counters->cgp_saved_pixels += saved_pixels;
+    }
+}
+
+
+/**
+ * Returns number of performed CGP evaluations
+ */
+long fitness_get_cgp_evals()
+{
+    long sum = 0;
+    for (int i = 0; i < FITNESS_COUNTER_SLOTS; i++) {
+        sum += fitness_counters[i].cgp_evals;
+    }
+    return sum;
+}
+
+
+/**
+ * Returns number of CGP evaluations stopped early, because the circuit
+ * could not be better than its parent
+ */
+long fitness_get_cgp_aborted_evals()
+{
+    long sum = 0;
+    for (int i = 0; i < FITNESS_COUNTER_SLOTS; i++) {
+        sum += fitness_counters[i].cgp_aborted_evals;
+    }
+    return sum;
+}
+
+
+/**
+ * Returns number of pixels which were not evaluated thanks to stopping
+ * evaluations early
+ */
+long fitness_get_cgp_saved_pixels()
+{
+    long sum = 0;
+    for (int i = 0; i < FITNESS_COUNTER_SLOTS; i++) {
+        sum += fitness_counters[i].cgp_saved_pixels;
+    }
+    return sum;
 }
 
 
@@ -83,17 +163,54 @@ ga_fitness_t fitness_eval_or_predict_cgp(ga_chr_t chr)
 
 
 /**
- * Evaluates predictor fitness
+ * Evaluates fitness of multiple CGP circuits at once
+ *
+ * @param  chrs
+ * @param  n
+ * @param  parent
+ */
+void fitness_eval_or_predict_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t parent)
+{
+    if (fitness_pred_archive && fitness_pred_archive->stored > 0) {
+        ga_chr_t predictor = arc_get(fitness_pred_archive, 0);
+        fitness_predict_cgp_batch(chrs, n, predictor, parent);
+    } else {
+        fitness_eval_cgp_batch(chrs, n, parent);
+    }
+}
+
+
+/**
+ * Evaluates CGP circuit stored in archive slot. Its error in each fitness
+ * case is kept, so that predictors can be evaluated without running the
+ * circuit again.
+ *
+ * @param  arc CGP archive given to `fitness_init`
+ * @param  slot
+ * @return fitness value, same as `fitness_eval_cgp` gives
+ */
+ga_fitness_t fitness_eval_archived_cgp(archive_t arc, int slot)
+{
+    assert(arc == fitness_cgp_archive);
+    return _fitness_eval_archived_cgp(arc->chromosomes[slot], slot);
+}
+
+
+/**
+ * Evaluates predictor fitness. Fitness predicted for archived circuits is
+ * computed from their errors kept by `fitness_eval_archived_cgp`.
  *
  * @param  chr
  * @return fitness value
  */
 ga_fitness_t fitness_eval_predictor(ga_chr_t pred_chr)
 {
+    pred_genome_t predictor = (pred_genome_t) pred_chr->genome;
     double sum = 0;
     for (int i = 0; i < fitness_cgp_archive->stored; i++) {
-        ga_chr_t cgp_chr = arc_get(fitness_cgp_archive, i);
-        double predicted = fitness_predict_cgp(cgp_chr, pred_chr);
+        int slot = arc_real_index(fitness_cgp_archive, i);
+        ga_chr_t cgp_chr = fitness_cgp_archive->chromosomes[slot];
+        double predicted = _fitness_predict_archived_cgp(slot, predictor);
         sum += fabs(cgp_chr->fitness - predicted);
     }
     return sum / fitness_cgp_archive->stored;
@@ -101,8 +218,73 @@ ga_fitness_t fitness_eval_predictor(ga_chr_t pred_chr)
 
 
 /**
- * Evaluates circular predictor fitness, using PRED_CIRCULAR_TRIES to
- * determine best offset
+ * Locus of circular genotype with its gene value
+ */
+typedef struct {
+    pred_gene_t value;
+    int locus;
+} _fitness_locus_t;
+
+
+static int _fitness_compare_loci(const void *a, const void *b)
+{
+    const _fitness_locus_t *x = (const _fitness_locus_t*) a;
+    const _fitness_locus_t *y = (const _fitness_locus_t*) b;
+    if (x->value != y->value) return (x->value < y->value) ? -1 : 1;
+    return x->locus - y->locus;
+}
+
+
+/**
+ * Finds circular distance from each locus to the previous and the next
+ * locus with the same gene value. Distance of unique value is the genotype
+ * length.
+ *
+ * @param  genes
+ * @param  length Genotype length
+ * @param  prev_distance
+ * @param  next_distance
+ * @return Whether memory was allocated
+ */
+static bool _fitness_find_repeated_genes(pred_gene_t *genes, int length,
+    int *prev_distance, int *next_distance)
+{
+    _fitness_locus_t *loci = (_fitness_locus_t*) malloc(sizeof(_fitness_locus_t) * length);
+    if (loci == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < length; i++) {
+        loci[i].value = genes[i];
+        loci[i].locus = i;
+    }
+    qsort(loci, length, sizeof(_fitness_locus_t), _fitness_compare_loci);
+
+    // loci of the same value are sorted, last one precedes the first one
+    int first = 0;
+    for (int i = 0; i < length; i++) {
+        bool last = i == length - 1 || loci[i + 1].value != loci[i].value;
+        int next = last ? first : i + 1;
+        int distance = (loci[next].locus - loci[i].locus + length) % length;
+        if (distance == 0) distance = length;
+
+        next_distance[loci[i].locus] = distance;
+        prev_distance[loci[next].locus] = distance;
+        if (last) first = i + 1;
+    }
+
+    free(loci);
+    return true;
+}
+
+
+/**
+ * Evaluates circular predictor fitness at all offsets of its genotype and
+ * moves it to the best one
+ *
+ * Phenotype window is moved along the genotype and only the values leaving
+ * and entering it are updated. Pixel is used when no earlier locus of the
+ * window has the same value.
  *
  * @param  chr
  * @return fitness value
@@ -110,25 +292,85 @@ ga_fitness_t fitness_eval_predictor(ga_chr_t pred_chr)
 ga_fitness_t fitness_eval_circular_predictor(ga_chr_t pred_chr)
 {
     pred_genome_t predictor = (pred_genome_t) pred_chr->genome;
-    int best_offset = predictor->_circular_offset;
-    ga_fitness_t best_fitness = fitness_eval_predictor(pred_chr);
+    int length = pred_get_max_length();
+    int used = pred_get_length();
 
-    for (int i = 0; i < PRED_CIRCULAR_TRIES; i++) {
-        // generate new phenotype
-        int offset = rand_urange(0, pred_get_max_length() - 1);
-        predictor->_circular_offset = offset;
-        pred_calculate_phenotype(predictor);
+    int *prev_distance = (int*) malloc(sizeof(int) * length);
+    int *next_distance = (int*) malloc(sizeof(int) * length);
+    int *used_pixels = (int*) malloc(sizeof(int) * length);
+    uint64_t *errors = (uint64_t*) malloc(sizeof(uint64_t) * length);
+    double *fitness = (double*) calloc(length, sizeof(double));
+
+    if (prev_distance == NULL || next_distance == NULL || used_pixels == NULL
+        || errors == NULL || fitness == NULL
+        || !_fitness_find_repeated_genes(predictor->_genes, length,
+            prev_distance, next_distance))
+    {
+        fprintf(stderr, "Failed to allocate memory for circular predictor.\n");
+        exit(1);
+    }
 
-        // calculate predictor fitness
-        ga_fitness_t fit = fitness_eval_predictor(pred_chr);
+    // first pass counts pixels, following ones sum errors of each circuit
+    for (int i = -1; i < fitness_cgp_archive->stored; i++) {
+        ga_chr_t cgp_chr = NULL;
+        if (i < 0) {
+            for (int locus = 0; locus < length; locus++) {
+                errors[locus] = 1;
+            }
 
-        // if it is better, store it
+        } else {
+            int slot = arc_real_index(fitness_cgp_archive, i);
+            cgp_chr = fitness_cgp_archive->chromosomes[slot];
+            _fitness_get_archived_cgp_errors(slot, predictor->_genes, length,
+                errors);
+        }
+
+        uint64_t sum = 0;
+        for (int locus = 0; locus < used; locus++) {
+            if (prev_distance[locus] > locus) sum += errors[locus];
+        }
+
+        for (int offset = 0; offset < length; offset++) {
+            if (offset > 0) {
+                // first locus leaves, next one with its value is now first
+                int leaving = offset - 1;
+                sum -= errors[leaving];
+                if (next_distance[leaving] < used) {
+                    sum += errors[(leaving + next_distance[leaving]) % length];
+                }
+
+                int entering = (leaving + used) % length;
+                if (prev_distance[entering] >= used) {
+                    sum += errors[entering];
+                }
+            }
+
+            if (i < 0) {
+                used_pixels[offset] = sum;
+            } else {
+                double predicted = _fitness_predict_cgp_by_errors(sum,
+                    used_pixels[offset]);
+                fitness[offset] += fabs(cgp_chr->fitness - predicted);
+            }
+        }
+    }
+
+    int best_offset = predictor->_circular_offset;
+    ga_fitness_t best_fitness = fitness[best_offset] / fitness_cgp_archive->stored;
+    for (int offset = 0; offset < length; offset++) {
+        ga_fitness_t fit = fitness[offset] / fitness_cgp_archive->stored;
         if (ga_is_better(PRED_PROBLEM_TYPE, fit, best_fitness)) {
             best_offset = offset;
             best_fitness = fit;
         }
     }
 
+    free(prev_distance);
+    free(next_distance);
+    free(used_pixels);
+    free(errors);
+    free(fitness);
+
     // set predictor to best found phenotype
     if (predictor->_circular_offset != best_offset) {
         predictor->_circular_offset = best_offset;
@@ -21,6 +21,8 @@
 #pragma once
 
 
+#include <math.h>
+
 #include "config.h"
 #include "cgp/cgp.h"
 #include "archive.h"
@@ -29,22 +31,60 @@
 
 
 static const int FITNESS_SSE2_STEP = 16;
-static const int FITNESS_AVX2_STEP = 32;
+#ifdef PIXEL16
+    static const int FITNESS_AVX2_STEP = 16;
+#else
+    static const int FITNESS_AVX2_STEP = 32;
+#endif
+static const int FITNESS_AVX512_STEP = 64;
+
+// SIMD kernels sum squared differences in 32-bit lanes, each block adds at
+// most 2 * 2 * 255^2 to a lane - move them to 64 bits before they overflow
+static const int FITNESS_SIMD_FLUSH_BLOCKS = 8192;
+
+// pixels processed by all circuits in batch before moving to next tile,
+// input planes of one tile fit in L1 cache (must be multiple of SIMD steps)
+static const int FITNESS_BATCH_TILE = 2048;
+
+// pixels evaluated by one thread when single circuit is split among threads
+// (must be multiple of SIMD steps)
+static const int FITNESS_PARALLEL_TILE = 16384;
+
+// fitness of circuits whose evaluation was stopped early, because they
+// could not beat their parent - worse than any real fitness
+static const double FITNESS_ABORTED = -INFINITY;
 
-static const int PRED_CIRCULAR_TRIES = 3;
+// threads with their own evaluation counters, others share the last one
+#define FITNESS_COUNTER_SLOTS 64
+
+
+/**
+ * Evaluation counters of one thread, aligned to whole cache line so that
+ * threads never write to the same line
+ */
+typedef struct {
+    _Alignas(64) long cgp_evals;
+    long cgp_aborted_evals;
+    long cgp_saved_pixels;
+} fitness_counters_t;
 
 
 extern input_data_t *fitness_input_data;
 extern archive_t fitness_cgp_archive;
 extern archive_t fitness_pred_archive;
-extern long fitness_cgp_evals;
+extern fitness_counters_t fitness_counters[FITNESS_COUNTER_SLOTS];
 
 
 /**
  * Private functions, defined in ifilter/fitness.c or symreg/fitness.c
  */
 void _fitness_init(config_t *config, input_data_t *input, archive_t cgp_archive, archive_t pred_archive);
+void _fitness_deinit();
 ga_fitness_t _fitness_predict_cgp_by_genome(ga_chr_t cgp_chr, pred_genome_t predictor);
+ga_fitness_t _fitness_eval_archived_cgp(ga_chr_t chr, int slot);
+ga_fitness_t _fitness_predict_archived_cgp(int slot, pred_genome_t predictor);
+void _fitness_get_archived_cgp_errors(int slot, pred_gene_t *cases, int count, uint64_t *errors);
+ga_fitness_t _fitness_predict_cgp_by_errors(uint64_t sum, int used_pixels);
 
 
 #ifdef SYMREG
@@ -71,13 +111,35 @@ void fitness_init(config_t *config, input_data_t *input,
 void fitness_deinit();
 
 
+/**
+ * Adds to evaluation counters of calling thread
+ *
+ * @param evals Number of evaluated pixels (fitness cases)
+ * @param aborted Number of evaluations stopped early
+ * @param saved_pixels Number of pixels skipped by stopping early
+ */
+void fitness_count_cgp_evals(long evals, long aborted, long saved_pixels);
+
+
 /**
  * Returns number of performed CGP evaluations
  */
-static inline long fitness_get_cgp_evals()
-{
-    return fitness_cgp_evals;
-}
+long fitness_get_cgp_evals();
+
+
+/**
+ * Returns number of CGP evaluations stopped early, because the circuit
+ * could not be better than its parent
+ */
+long fitness_get_cgp_aborted_evals();
+
+
+/**
+ * Returns number of pixels which were not evaluated thanks to stopping
+ * evaluations early
+ */
+long fitness_get_cgp_saved_pixels();
+
 
 /**
  * Evaluates CGP circuit fitness
@@ -88,6 +150,20 @@ static inline long fitness_get_cgp_evals()
 ga_fitness_t fitness_eval_cgp(ga_chr_t chr);
 
 
+/**
+ * Evaluates fitness of multiple CGP circuits at once, stores it in their
+ * `fitness` attributes
+ *
+ * Circuits which turn out to be worse than parent may be evaluated only
+ * partially, their fitness is then set to FITNESS_ABORTED.
+ *
+ * @param  chrs
+ * @param  n number of circuits
+ * @param  parent Circuit the others were derived from, may be NULL
+ */
+void fitness_eval_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t parent);
+
+
 /**
  * Predictes CGP circuit fitness
  *
@@ -98,6 +174,22 @@ ga_fitness_t fitness_eval_cgp(ga_chr_t chr);
 ga_fitness_t fitness_predict_cgp(ga_chr_t cgp_chr, ga_chr_t pred_chr);
 
 
+/**
+ * Predicts fitness of multiple CGP circuits at once, stores it in their
+ * `fitness` attributes
+ *
+ * Circuits which turn out to be worse than parent may be evaluated only
+ * partially, their fitness is then set to FITNESS_ABORTED.
+ *
+ * @param  chrs
+ * @param  n number of circuits
+ * @param  pred_chr
+ * @param  parent Circuit the others were derived from, may be NULL
+ */
+void fitness_predict_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t pred_chr,
+    ga_chr_t parent);
+
+
 /**
  * If predictors archive is empty, returns `fitness_eval_cgp` result.
  * If there is at least one predictor in archive
@@ -110,7 +202,31 @@ ga_fitness_t fitness_eval_or_predict_cgp(ga_chr_t chr);
 
 
 /**
- * Evaluates predictor fitness
+ * Batch version of `fitness_eval_or_predict_cgp`, stores fitness
+ * in chromosomes `fitness` attributes
+ *
+ * @param  chrs
+ * @param  n number of circuits
+ * @param  parent Circuit the others were derived from, may be NULL
+ */
+void fitness_eval_or_predict_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t parent);
+
+
+/**
+ * Evaluates CGP circuit stored in archive slot. Its error in each fitness
+ * case is kept, so that predictors can be evaluated without running the
+ * circuit again.
+ *
+ * @param  arc CGP archive given to `fitness_init`
+ * @param  slot
+ * @return fitness value, same as `fitness_eval_cgp` gives
+ */
+ga_fitness_t fitness_eval_archived_cgp(archive_t arc, int slot);
+
+
+/**
+ * Evaluates predictor fitness. Fitness predicted for archived circuits is
+ * computed from their errors kept by `fitness_eval_archived_cgp`.
  *
  * @param  chr
  * @return fitness value
@@ -119,8 +235,8 @@ ga_fitness_t fitness_eval_predictor(ga_chr_t chr);
 
 
 /**
- * Evaluates circular predictor fitness, using PRED_CIRCULAR_TRIES to
- * determine best offset
+ * Evaluates circular predictor fitness at all offsets of its genotype and
+ * moves it to the best one
  *
  * @param  chr
  * @return fitness value
@@ -136,8 +252,21 @@ static inline double fitness_to_psnr(ga_fitness_t f) {
 }
 
 
+#ifndef SYMREG
+    /**
+     * Evaluates CGP circuit fitness on single image of training set
+     *
+     * @param  chr
+     * @param  image Image index
+     * @return fitness value
+     */
+    ga_fitness_t fitness_eval_cgp_image(ga_chr_t chr, int image);
+#endif
+
+
 /**
- * Fills simd-friendly predictor arrays with correct image data
+ * Fills simd-friendly predictor arrays with correct image data, positions
+ * already holding the right pixel are skipped
  * @param  genome
  */
 void fitness_prepare_predictor_for_simd(pred_genome_t predictor);
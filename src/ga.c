@@ -95,6 +95,7 @@ ga_pop_t ga_create_pop(int size, ga_problem_type_t type, ga_func_vect_t methods)
     new_pop->problem_type = type;
     new_pop->methods = methods;
     new_pop->best_chr_index = -1;
+    new_pop->best_chromosome = NULL;
 
     /* allocate chromosome array */
     new_pop->chromosomes = _ga_allocate_chromosomes(size, methods.alloc_genome,
@@ -279,15 +280,49 @@ void ga_invalidate_fitness(ga_pop_t pop)
 
 
 /**
- * Calculate fitness of whole population, using `ga_evaluate_chr`
+ * Calculate fitness of chromosomes using batch fitness function
+ * @param pop
+ * @param only_missing Skip chromosomes with `has_fitness` set to `true`
+ */
+void _ga_evaluate_batch(ga_pop_t pop, bool only_missing)
+{
+    assert(pop->methods.fitness_batch != NULL);
+
+    ga_chr_t pending[pop->size];
+    int n = 0;
+
+    for (int i = 0; i < pop->size; i++) {
+        ga_chr_t chr = pop->chromosomes[i];
+        if (!only_missing || !chr->has_fitness) {
+            pending[n++] = chr;
+        }
+    }
+
+    if (n == 0) return;
+
+    pop->methods.fitness_batch(pending, n, pop->best_chromosome);
+    for (int i = 0; i < n; i++) {
+        pending[i]->has_fitness = true;
+    }
+}
+
+
+/**
+ * Calculate fitness of whole population, using batch fitness function
+ * if available or `ga_evaluate_chr` otherwise
  * @param chr
  */
 void ga_evaluate_pop(ga_pop_t pop)
 {
     // evaluate population
-    #pragma omp parallel for
-    for (int i = 0; i < pop->size; i++) {
-        ga_evaluate_chr(pop, pop->chromosomes[i]);
+    if (pop->methods.fitness_batch != NULL) {
+        _ga_evaluate_batch(pop, true);
+
+    } else {
+        #pragma omp parallel for
+        for (int i = 0; i < pop->size; i++) {
+            ga_evaluate_chr(pop, pop->chromosomes[i]);
+        }
     }
 
     /* find new best chromosome */
@@ -296,15 +331,21 @@ void ga_evaluate_pop(ga_pop_t pop)
 
 
 /**
- * Re-calculate fitness of whole population, using `ga_reevaluate_chr`
+ * Re-calculate fitness of whole population, using batch fitness function
+ * if available or `ga_reevaluate_chr` otherwise
  * @param chr
  */
 void ga_reevaluate_pop(ga_pop_t pop)
 {
     // reevaluate population
-    #pragma omp parallel for
-    for (int i = 0; i < pop->size; i++) {
-        ga_reevaluate_chr(pop, pop->chromosomes[i]);
+    if (pop->methods.fitness_batch != NULL) {
+        _ga_evaluate_batch(pop, false);
+
+    } else {
+        #pragma omp parallel for
+        for (int i = 0; i < pop->size; i++) {
+            ga_reevaluate_chr(pop, pop->chromosomes[i]);
+        }
     }
 
     /* find new best chromosome */
@@ -110,6 +110,23 @@ typedef void (*ga_copy_genome_func_t)(void *dst, void* src);
 typedef ga_fitness_t (*ga_fitness_func_t)(ga_chr_t chromosome);
 
 
+/**
+ * Batch fitness function
+ *
+ * Optional. This function should calculate fitness of all given
+ * chromosomes at once and store it in their `fitness` attributes.
+ * Like `ga_fitness_func_t`, it must not skip calculation even if
+ * `has_fitness` attribute is set to `true`.
+ *
+ * @param  chromosomes
+ * @param  n number of chromosomes
+ * @param  parent Chromosome the others were most likely derived from
+ *                (current best one), may be NULL
+ */
+typedef void (*ga_fitness_batch_func_t)(ga_chr_t *chromosomes, int n,
+    ga_chr_t parent);
+
+
 /**
  * New generation population generator function
  *
@@ -171,6 +188,9 @@ typedef struct {
     /* fitness function */
     ga_fitness_func_t fitness;
 
+    /* fitness function for whole population at once (optional) */
+    ga_fitness_batch_func_t fitness_batch;
+
     /* children generator */
     ga_offspring_func_t offspring;
 
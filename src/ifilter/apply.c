@@ -0,0 +1,203 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../cpu.h"
+#include "apply.h"
+
+
+/**
+ * Filters one image row with scalar CGP evaluation
+ */
+void apply_row_scalar(ga_chr_t chromosome, img_pixel_t *rows[3],
+    int width, img_pixel_t *output)
+{
+    for (int x = 0; x < width; x++) {
+        cgp_value_t inputs[WINDOW_SIZE];
+        for (int r = 0; r < 3; r++) {
+            inputs[3 * r + 0] = rows[r][x];
+            inputs[3 * r + 1] = rows[r][x + 1];
+            inputs[3 * r + 2] = rows[r][x + 2];
+        }
+        cgp_value_t output_pixel;
+        cgp_get_output(chromosome, inputs, &output_pixel);
+        output[x] = output_pixel;
+    }
+}
+
+
+/**
+ * Returns fastest row filter supported by CPU. All of them give the
+ * same results as the scalar one.
+ */
+apply_row_func_t apply_get_row_func()
+{
+    apply_row_func_t func = apply_row_scalar;
+
+    #ifdef SSE2
+        if (can_use_sse2()) {
+            func = apply_row_sse;
+        }
+    #endif
+
+    #ifdef AVX2
+        if (can_use_intel_core_4th_gen_features()) {
+            func = apply_row_avx;
+        }
+    #endif
+
+    return func;
+}
+
+
+/**
+ * Prepares padded rows above, at and below row `y` of image. Row `ny` is
+ * kept padded in `padded[ny % 3]`, rows already there are not copied again.
+ *
+ * @param input
+ * @param y
+ * @param padded Three buffers of `apply_row_size` pixels
+ * @param padded_y Rows held by buffers, -1 for none
+ * @param rows Output, padded neighbour rows
+ */
+static inline void _apply_padded_rows(img_image_t input, int y,
+    img_pixel_t *padded[3], int padded_y[3], img_pixel_t *rows[3])
+{
+    int width = input->width;
+    int height = input->height;
+    int neighbours[3] = {
+        (y > 0) ? y - 1 : 0,
+        y,
+        (y < height - 1) ? y + 1 : height - 1
+    };
+
+    for (int r = 0; r < 3; r++) {
+        int ny = neighbours[r];
+        int slot = ny % 3;
+        if (padded_y[slot] != ny) {
+            memcpy(padded[slot] + 1, &input->data[ny * width],
+                sizeof(img_pixel_t) * width);
+            apply_pad_row(padded[slot], width);
+            padded_y[slot] = ny;
+        }
+        rows[r] = padded[slot];
+    }
+}
+
+
+/**
+ * Filters whole image, rows are split among OpenMP threads
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  output Image of the same size as input
+ * @return 0 on success
+ */
+int apply_filter_image(ga_chr_t chromosome, img_image_t input,
+    img_image_t output)
+{
+    apply_row_func_t func = apply_get_row_func();
+    int width = input->width;
+    int height = input->height;
+    bool failed = false;
+
+    #pragma omp parallel
+    {
+        // each thread gets a contiguous band of rows
+        int size = apply_row_size(width);
+        img_pixel_t *buffer = (img_pixel_t*) calloc(3 * size, sizeof(img_pixel_t));
+        img_pixel_t *padded[3] = { buffer, buffer + size, buffer + 2 * size };
+        int padded_y[3] = { -1, -1, -1 };
+
+        if (buffer == NULL) {
+            #pragma omp atomic write
+                failed = true;
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            if (buffer == NULL) continue;
+
+            img_pixel_t *rows[3];
+            _apply_padded_rows(input, y, padded, padded_y, rows);
+            func(chromosome, rows, width, &output->data[y * width]);
+        }
+
+        free(buffer);
+    }
+
+    return failed ? -1 : 0;
+}
+
+
+/**
+ * Calculates PSNR of filtered image with reference one, without storing
+ * the filtered image. Rows are split among OpenMP threads, each filtered
+ * row is compared right away.
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  reference Image of the same size as input
+ * @param  psnr Output
+ * @return 0 on success
+ */
+int apply_psnr_image(ga_chr_t chromosome, img_image_t input,
+    img_image_t reference, double *psnr)
+{
+    apply_row_func_t func = apply_get_row_func();
+    int width = input->width;
+    int height = input->height;
+    bool failed = false;
+    uint64_t sum = 0;
+
+    #pragma omp parallel reduction(+:sum)
+    {
+        // padded input rows followed by filtered row
+        int size = apply_row_size(width);
+        img_pixel_t *buffer = (img_pixel_t*) calloc(3 * size + width, sizeof(img_pixel_t));
+        img_pixel_t *padded[3] = { buffer, buffer + size, buffer + 2 * size };
+        img_pixel_t *output_row = buffer + 3 * size;
+        int padded_y[3] = { -1, -1, -1 };
+
+        if (buffer == NULL) {
+            #pragma omp atomic write
+                failed = true;
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            if (buffer == NULL) continue;
+
+            img_pixel_t *rows[3];
+            _apply_padded_rows(input, y, padded, padded_y, rows);
+            func(chromosome, rows, width, output_row);
+            sum += img_row_sqdiff(output_row, &reference->data[y * width], width);
+        }
+
+        free(buffer);
+    }
+
+    *psnr = img_psnr_from_sqdiff(sum, (double) width * height);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#pragma once
+
+
+#include "image.h"
+#include "../cgp/cgp.h"
+
+
+static const int APPLY_SSE2_STEP = 16;
+#ifdef PIXEL16
+    static const int APPLY_AVX2_STEP = 16;
+#else
+    static const int APPLY_AVX2_STEP = 32;
+#endif
+
+// padded row holds one clamped pixel on both sides, followed by space
+// read (but not used) by the last SIMD block
+static const int APPLY_ROW_PADDING = 2 + 32;
+
+
+/**
+ * Filters one image row
+ *
+ * @param chromosome
+ * @param rows Padded rows above, at and below the filtered row
+ * @param width
+ * @param output Filtered row, `width` pixels
+ */
+typedef void (*apply_row_func_t)(ga_chr_t chromosome, img_pixel_t *rows[3],
+    int width, img_pixel_t *output);
+
+
+/**
+ * Returns size of padded row buffer in pixels
+ * @param  width
+ */
+static inline int apply_row_size(int width)
+{
+    return width + APPLY_ROW_PADDING;
+}
+
+
+/**
+ * Clamps borders of padded row. Row pixels must already be stored
+ * starting at index 1.
+ *
+ * @param padded
+ * @param width
+ */
+static inline void apply_pad_row(img_pixel_t *padded, int width)
+{
+    padded[0] = padded[1];
+    padded[width + 1] = padded[width];
+}
+
+
+/**
+ * Filters one image row with scalar CGP evaluation
+ */
+void apply_row_scalar(ga_chr_t chromosome, img_pixel_t *rows[3],
+    int width, img_pixel_t *output);
+
+
+/**
+ * Filters one image row, 16 pixels at once using SSE2 instructions
+ */
+void apply_row_sse(ga_chr_t chromosome, img_pixel_t *rows[3],
+    int width, img_pixel_t *output);
+
+
+/**
+ * Filters one image row, 32 pixels at once using AVX2 instructions
+ */
+void apply_row_avx(ga_chr_t chromosome, img_pixel_t *rows[3],
+    int width, img_pixel_t *output);
+
+
+/**
+ * Returns fastest row filter supported by CPU. All of them give the
+ * same results as the scalar one.
+ */
+apply_row_func_t apply_get_row_func();
+
+
+/**
+ * Filters whole image, rows are split among OpenMP threads
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  output Image of the same size as input
+ * @return 0 on success
+ */
+int apply_filter_image(ga_chr_t chromosome, img_image_t input,
+    img_image_t output);
+
+
+/**
+ * Calculates PSNR of filtered image with reference one, without storing
+ * the filtered image. Rows are split among OpenMP threads, each filtered
+ * row is compared right away.
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  reference Image of the same size as input
+ * @param  psnr Output
+ * @return 0 on success
+ */
+int apply_psnr_image(ga_chr_t chromosome, img_image_t input,
+    img_image_t reference, double *psnr);
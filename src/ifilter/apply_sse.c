@@ -0,0 +1,80 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#include <string.h>
+#include <immintrin.h>
+
+#include "apply.h"
+#include "cgp_sse.h"
+
+
+// primary inputs are read directly (see cgp_get_output_sse)
+#define VALUE(idx) ((idx) < CGP_INPUTS ? inputs[(idx)] : values[(idx)])
+
+
+/**
+ * Calculates circuit output for 16 pixels, with results identical to
+ * scalar evaluation
+ */
+static inline __m128i _get_output_exact_sse(cgp_genome_t genome,
+    __m128i_aligned inputs[CGP_INPUTS])
+{
+    __m128i_aligned values[CGP_INPUTS + CGP_NODES];
+
+    for (int i = 0; i < genome->program_length; i++) {
+        cgp_instr_t *instr = &(genome->program[i]);
+        values[instr->output] = cgp_eval_node_exact_sse(instr->function,
+            VALUE(instr->inputs[0]), VALUE(instr->inputs[1]));
+    }
+
+    return VALUE(genome->outputs[0]);
+}
+
+
+/**
+ * Filters one image row, 16 pixels at once using SSE2 instructions
+ */
+void apply_row_sse(ga_chr_t chromosome, img_pixel_t *rows[3],
+    int width, img_pixel_t *output)
+{
+#ifdef SSE2
+    cgp_genome_t genome = (cgp_genome_t) chromosome->genome;
+    __m128i_aligned inputs[CGP_INPUTS];
+
+    for (int x = 0; x < width; x += APPLY_SSE2_STEP) {
+        // neighbours are unaligned loads shifted by one pixel
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                inputs[3 * r + c] = _mm_loadu_si128((__m128i*) &rows[r][x + c]);
+            }
+        }
+
+        __m128i Y = _get_output_exact_sse(genome, inputs);
+
+        if (width - x >= APPLY_SSE2_STEP) {
+            _mm_storeu_si128((__m128i*) &output[x], Y);
+        } else {
+            __m128i_aligned tail = Y;
+            memcpy(&output[x], &tail, width - x);
+        }
+    }
+#endif
+}
@@ -0,0 +1,663 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include "batch.h"
+#include "image.h"
+#include "apply.h"
+#include "../utils.h"
+
+
+// queue between two stages holds this many images per consuming thread
+#define BATCH_QUEUE_IMAGES 2
+
+
+typedef enum {
+    BATCH_DECODE,
+    BATCH_FILTER,
+    BATCH_ENCODE,
+    BATCH_STAGES
+} batch_stage_id_t;
+
+
+static const char * const BATCH_STAGE_NAMES[] = {
+    "decode",
+    "filter",
+    "encode",
+};
+
+
+/**
+ * Image passed between stages
+ */
+typedef struct {
+    int index; // of input filename
+    img_image_t image; // decoded input, filtered output after filter stage
+} batch_job_t;
+
+
+/**
+ * Bounded blocking queue of jobs
+ */
+typedef struct {
+    batch_job_t **jobs;
+    int capacity;
+    int head;
+    int count;
+    int producers; // threads which can still push jobs
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} batch_queue_t;
+
+
+/**
+ * Statistics of one stage
+ */
+typedef struct {
+    int threads;
+    long images;
+    double busy; // seconds spent working, summed over threads
+} batch_stage_t;
+
+
+typedef struct {
+    ga_chr_t chromosome;
+    char **inputs;
+    int inputs_count;
+    char const *output_dir;
+    img_format_t format;
+
+    pthread_mutex_t lock; // guards fields below
+    int next_input;
+    int failed;
+    batch_stage_t stages[BATCH_STAGES];
+
+    batch_queue_t decoded;
+    batch_queue_t filtered;
+} batch_t;
+
+
+/* queue **********************************************************************/
+
+
+static bool _batch_queue_init(batch_queue_t *queue, int capacity,
+    int producers)
+{
+    queue->jobs = (batch_job_t**) malloc(sizeof(batch_job_t*) * capacity);
+    if (queue->jobs == NULL) {
+        return false;
+    }
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->producers = producers;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return true;
+}
+
+
+static void _batch_queue_destroy(batch_queue_t *queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->jobs);
+}
+
+
+/**
+ * Adds job to queue, waits while queue is full
+ */
+static void _batch_queue_push(batch_queue_t *queue, batch_job_t *job)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+
+    queue->jobs[(queue->head + queue->count) % queue->capacity] = job;
+    queue->count++;
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+
+/**
+ * Removes job from queue, waits while queue is empty
+ *
+ * @return NULL if queue is empty and all producers have finished
+ */
+static batch_job_t *_batch_queue_pop(batch_queue_t *queue)
+{
+    batch_job_t *job = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && queue->producers > 0) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+
+    if (queue->count > 0) {
+        job = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+
+/**
+ * Marks one producer as finished, consumers are woken up when it was
+ * the last one
+ */
+static void _batch_queue_producer_done(batch_queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->producers--;
+    if (queue->producers == 0) {
+        pthread_cond_broadcast(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+
+/* stages *********************************************************************/
+
+
+static double _batch_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Adds time spent on one image to stage statistics
+ */
+static void _batch_stage_done(batch_t *batch, batch_stage_id_t stage,
+    double start, bool success)
+{
+    double busy = _batch_time() - start;
+
+    pthread_mutex_lock(&batch->lock);
+    batch->stages[stage].busy += busy;
+    if (success) {
+        batch->stages[stage].images++;
+    } else {
+        batch->failed++;
+    }
+    pthread_mutex_unlock(&batch->lock);
+}
+
+
+/**
+ * Composes output filename - input basename with extension of output format
+ */
+static void _batch_output_filename(batch_t *batch, char const *input,
+    char out[MAX_FILENAME_LENGTH + 1])
+{
+    char const *name = strrchr(input, '/');
+    name = (name == NULL) ? input : name + 1;
+
+    char const *extension = strrchr(name, '.');
+    int length = (extension == NULL || extension == name)
+        ? (int) strlen(name) : (int) (extension - name);
+
+    snprintf(out, MAX_FILENAME_LENGTH + 1, "%s/%.*s%s",
+        batch->output_dir, length, name, img_format_extension(batch->format));
+}
+
+
+typedef struct {
+    char filename[MAX_FILENAME_LENGTH + 1];
+    int index;
+} _batch_output_t;
+
+
+static int _batch_compare_outputs(const void *a, const void *b)
+{
+    return strcmp(((const _batch_output_t*) a)->filename,
+        ((const _batch_output_t*) b)->filename);
+}
+
+
+/**
+ * Checks no two inputs would be written to the same output file (e.g.
+ * `a.png` and `a.pgm`), encoders would overwrite each other's output
+ *
+ * @return false if output names collide or memory cannot be allocated
+ */
+static bool _batch_check_output_names(batch_t *batch)
+{
+    _batch_output_t *outputs = (_batch_output_t*) malloc(
+        sizeof(_batch_output_t) * batch->inputs_count);
+    if (outputs == NULL) {
+        fprintf(stderr, "Failed to allocate memory for output names.\n");
+        return false;
+    }
+
+    for (int i = 0; i < batch->inputs_count; i++) {
+        _batch_output_filename(batch, batch->inputs[i], outputs[i].filename);
+        outputs[i].index = i;
+    }
+    qsort(outputs, batch->inputs_count, sizeof(_batch_output_t),
+        _batch_compare_outputs);
+
+    bool unique = true;
+    for (int i = 1; i < batch->inputs_count; i++) {
+        if (strcmp(outputs[i - 1].filename, outputs[i].filename) == 0) {
+            fprintf(stderr, "Images %s and %s would be written to the same file %s.\n",
+                batch->inputs[outputs[i - 1].index],
+                batch->inputs[outputs[i].index], outputs[i].filename);
+            unique = false;
+        }
+    }
+
+    free(outputs);
+    return unique;
+}
+
+
+/**
+ * Decoder thread - loads input images
+ */
+static void *_batch_decode(void *arg)
+{
+    batch_t *batch = (batch_t*) arg;
+
+    while (true) {
+        pthread_mutex_lock(&batch->lock);
+        int index = batch->next_input++;
+        pthread_mutex_unlock(&batch->lock);
+
+        if (index >= batch->inputs_count) {
+            break;
+        }
+
+        double start = _batch_time();
+        batch_job_t *job = (batch_job_t*) malloc(sizeof(batch_job_t));
+        img_image_t image = img_load(batch->inputs[index]);
+        bool success = job != NULL && image != NULL;
+        _batch_stage_done(batch, BATCH_DECODE, start, success);
+
+        if (!success) {
+            fprintf(stderr, "Failed to load image %s.\n", batch->inputs[index]);
+            img_destroy(image);
+            free(job);
+            continue;
+        }
+
+        job->index = index;
+        job->image = image;
+        _batch_queue_push(&batch->decoded, job);
+    }
+
+    _batch_queue_producer_done(&batch->decoded);
+    return NULL;
+}
+
+
+/**
+ * Filter worker thread - applies circuit to decoded images
+ */
+static void *_batch_filter(void *arg)
+{
+    batch_t *batch = (batch_t*) arg;
+    batch_job_t *job;
+
+    #ifdef _OPENMP
+        // images are filtered in parallel, not their rows
+        omp_set_num_threads(1);
+    #endif
+
+    while ((job = _batch_queue_pop(&batch->decoded)) != NULL) {
+        double start = _batch_time();
+        img_image_t input = job->image;
+        img_image_t output = img_create(input->width, input->height, input->comp);
+        bool success = output != NULL && output->data != NULL
+            && apply_filter_image(batch->chromosome, input, output) == 0;
+        _batch_stage_done(batch, BATCH_FILTER, start, success);
+
+        img_destroy(input);
+        if (!success) {
+            fprintf(stderr, "Failed to filter image %s.\n",
+                batch->inputs[job->index]);
+            img_destroy(output);
+            free(job);
+            continue;
+        }
+
+        job->image = output;
+        _batch_queue_push(&batch->filtered, job);
+    }
+
+    _batch_queue_producer_done(&batch->filtered);
+    return NULL;
+}
+
+
+/**
+ * Encoder thread - writes filtered images
+ */
+static void *_batch_encode(void *arg)
+{
+    batch_t *batch = (batch_t*) arg;
+    batch_job_t *job;
+
+    while ((job = _batch_queue_pop(&batch->filtered)) != NULL) {
+        char filename[MAX_FILENAME_LENGTH + 1];
+        _batch_output_filename(batch, batch->inputs[job->index], filename);
+
+        double start = _batch_time();
+        FILE *file = fopen(filename, "wb");
+        bool success = file != NULL
+            && img_stream_write_image(file, job->image, batch->format) == 0;
+        if (file != NULL && fclose(file) != 0) {
+            success = false;
+        }
+        _batch_stage_done(batch, BATCH_ENCODE, start, success);
+
+        if (!success) {
+            fprintf(stderr, "Failed to write image %s.\n", filename);
+        }
+
+        img_destroy(job->image);
+        free(job);
+    }
+
+    return NULL;
+}
+
+
+/* inputs *********************************************************************/
+
+
+/**
+ * Appends filename to input list
+ */
+static bool _batch_add_input(char ***inputs, int *count, int *capacity,
+    char const *filename)
+{
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        char **resized = (char**) realloc(*inputs, sizeof(char*) * *capacity);
+        if (resized == NULL) {
+            return false;
+        }
+        *inputs = resized;
+    }
+
+    char *copy = strdup(filename);
+    if (copy == NULL) {
+        return false;
+    }
+    (*inputs)[(*count)++] = copy;
+    return true;
+}
+
+
+/**
+ * Skips hidden directory entries
+ */
+static int _batch_visible(const struct dirent *entry)
+{
+    return entry->d_name[0] != '.';
+}
+
+
+/**
+ * Lists regular files in directory, sorted by name
+ */
+static bool _batch_read_dir(char const *dir, char ***inputs, int *count)
+{
+    struct dirent **entries;
+    int entries_count = scandir(dir, &entries, _batch_visible, alphasort);
+    if (entries_count < 0) {
+        fprintf(stderr, "Failed to read directory %s.\n", dir);
+        return false;
+    }
+
+    int capacity = 0;
+    bool success = true;
+
+    for (int i = 0; i < entries_count; i++) {
+        char filename[MAX_FILENAME_LENGTH + 1];
+        struct stat st;
+        int length = snprintf(filename, sizeof(filename), "%s/%s",
+            dir, entries[i]->d_name);
+
+        if (!success) {
+            // just free remaining entries
+
+        } else if (length >= (int) sizeof(filename)) {
+            fprintf(stderr, "Filename %s is too long.\n", entries[i]->d_name);
+            success = false;
+
+        } else if (stat(filename, &st) == 0 && S_ISREG(st.st_mode)
+            && !_batch_add_input(inputs, count, &capacity, filename))
+        {
+            fprintf(stderr, "Failed to allocate memory for image list.\n");
+            success = false;
+        }
+        free(entries[i]);
+    }
+    free(entries);
+
+    return success;
+}
+
+
+/**
+ * Reads image list, one filename per line. Empty lines and lines starting
+ * with `#` are ignored, relative filenames are relative to the list.
+ */
+static bool _batch_read_list(char const *list, char ***inputs, int *count)
+{
+    FILE *file = fopen(list, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open image list %s.\n", list);
+        return false;
+    }
+
+    char const *slash = strrchr(list, '/');
+    int capacity = 0;
+    bool success = true;
+    char line[MAX_FILENAME_LENGTH + 2];
+
+    while (success && fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+
+        char filename[MAX_FILENAME_LENGTH + 1];
+        int length;
+        if (line[0] == '/' || slash == NULL) {
+            length = snprintf(filename, sizeof(filename), "%s", line);
+        } else {
+            length = snprintf(filename, sizeof(filename), "%.*s/%s",
+                (int) (slash - list), list, line);
+        }
+
+        if (length >= (int) sizeof(filename)) {
+            fprintf(stderr, "Filename %s is too long.\n", line);
+            success = false;
+
+        } else if (!_batch_add_input(inputs, count, &capacity, filename)) {
+            fprintf(stderr, "Failed to allocate memory for image list.\n");
+            success = false;
+        }
+    }
+
+    fclose(file);
+    return success;
+}
+
+
+/* batch **********************************************************************/
+
+
+/**
+ * Starts threads of one stage, failure to start any thread is fatal
+ */
+static void _batch_start_stage(batch_t *batch, pthread_t *threads, int count,
+    void *(*func)(void*))
+{
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&threads[i], NULL, func, batch) != 0) {
+            fprintf(stderr, "Failed to start batch thread.\n");
+            exit(1);
+        }
+    }
+}
+
+
+/**
+ * Prints images processed by each stage and its throughput. Stage throughput
+ * is computed from busy time of its threads, so it tells how fast the stage
+ * would be if it never waited for the others.
+ */
+static void _batch_print_stats(batch_t *batch, double elapsed)
+{
+    long written = batch->stages[BATCH_ENCODE].images;
+
+    fprintf(stderr, "Filtered %ld of %d images in %.2f s (%.1f images/s)\n",
+        written, batch->inputs_count, elapsed, written / elapsed);
+    fprintf(stderr, "%-8s %7s %8s %10s %10s\n",
+        "stage", "threads", "images", "busy [s]", "images/s");
+
+    for (int s = 0; s < BATCH_STAGES; s++) {
+        batch_stage_t *stage = &batch->stages[s];
+        double throughput = (stage->busy > 0)
+            ? stage->images * stage->threads / stage->busy : 0;
+        fprintf(stderr, "%-8s %7d %8ld %10.2f %10.1f\n", BATCH_STAGE_NAMES[s],
+            stage->threads, stage->images, stage->busy, throughput);
+    }
+}
+
+
+/**
+ * Filters all images from directory or image list. Output image has the
+ * name of input one with extension of output format, inputs differing only
+ * in extension are refused. Throughput of stages is printed to stderr at
+ * the end.
+ *
+ * @param  chromosome
+ * @param  input Directory (all files but hidden ones) or file with one
+ *               image filename per line
+ * @param  output_dir
+ * @param  config
+ * @return 0 if all images were filtered
+ */
+int batch_filter_images(ga_chr_t chromosome, char const *input,
+    char const *output_dir, batch_config_t *config)
+{
+    batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.chromosome = chromosome;
+    batch.output_dir = output_dir;
+    batch.format = config->format;
+    batch.stages[BATCH_DECODE].threads = config->decode_threads;
+    batch.stages[BATCH_FILTER].threads = config->filter_threads;
+    batch.stages[BATCH_ENCODE].threads = config->encode_threads;
+
+    struct stat st;
+    bool listed;
+    if (stat(input, &st) == 0 && S_ISDIR(st.st_mode)) {
+        listed = _batch_read_dir(input, &batch.inputs, &batch.inputs_count);
+    } else {
+        listed = _batch_read_list(input, &batch.inputs, &batch.inputs_count);
+    }
+
+    int result = -1;
+    if (!listed) {
+        // error already printed
+
+    } else if (batch.inputs_count == 0) {
+        fprintf(stderr, "No images to filter in %s.\n", input);
+
+    } else if (!_batch_check_output_names(&batch)) {
+        // error already printed
+
+    } else if (create_dir(output_dir) != 0) {
+        fprintf(stderr, "Failed to create output directory %s.\n", output_dir);
+
+    } else if (!_batch_queue_init(&batch.decoded,
+            BATCH_QUEUE_IMAGES * config->filter_threads, config->decode_threads)
+        || !_batch_queue_init(&batch.filtered,
+            BATCH_QUEUE_IMAGES * config->encode_threads, config->filter_threads))
+    {
+        fprintf(stderr, "Failed to allocate memory for image queues.\n");
+
+    } else {
+        pthread_mutex_init(&batch.lock, NULL);
+        pthread_t decoders[config->decode_threads];
+        pthread_t filters[config->filter_threads];
+        pthread_t encoders[config->encode_threads];
+        double start = _batch_time();
+
+        _batch_start_stage(&batch, decoders, config->decode_threads, _batch_decode);
+        _batch_start_stage(&batch, filters, config->filter_threads, _batch_filter);
+        _batch_start_stage(&batch, encoders, config->encode_threads, _batch_encode);
+
+        for (int i = 0; i < config->decode_threads; i++) {
+            pthread_join(decoders[i], NULL);
+        }
+        for (int i = 0; i < config->filter_threads; i++) {
+            pthread_join(filters[i], NULL);
+        }
+        for (int i = 0; i < config->encode_threads; i++) {
+            pthread_join(encoders[i], NULL);
+        }
+
+        _batch_print_stats(&batch, _batch_time() - start);
+        pthread_mutex_destroy(&batch.lock);
+        result = batch.failed ? -1 : 0;
+    }
+
+    if (batch.decoded.jobs) _batch_queue_destroy(&batch.decoded);
+    if (batch.filtered.jobs) _batch_queue_destroy(&batch.filtered);
+    for (int i = 0; i < batch.inputs_count; i++) {
+        free(batch.inputs[i]);
+    }
+    free(batch.inputs);
+    return result;
+}
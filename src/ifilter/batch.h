@@ -0,0 +1,66 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#pragma once
+
+
+#include "../cgp/cgp.h"
+#include "image_stream.h"
+
+
+/**
+ * Filtering of many images by one process
+ *
+ * Images are processed by three stages of threads connected with bounded
+ * queues: decoders load input images, filter workers apply the circuit
+ * (each to whole images, one thread per image) and encoders write output
+ * images to output directory. Chromosome is loaded once and shared by all
+ * workers, slow stages do not make the others hold more than a few images
+ * in memory.
+ */
+
+
+/**
+ * Number of threads of each stage and output format
+ */
+typedef struct {
+    int decode_threads;
+    int filter_threads;
+    int encode_threads;
+    img_format_t format;
+} batch_config_t;
+
+
+/**
+ * Filters all images from directory or image list. Output image has the
+ * name of input one with extension of output format, inputs differing only
+ * in extension are refused. Throughput of stages is printed to stderr at
+ * the end.
+ *
+ * @param  chromosome
+ * @param  input Directory (all files but hidden ones) or file with one
+ *               image filename per line
+ * @param  output_dir
+ * @param  config
+ * @return 0 if all images were filtered
+ */
+int batch_filter_images(ga_chr_t chromosome, char const *input,
+    char const *output_dir, batch_config_t *config);
@@ -22,8 +22,13 @@
 #include "../cgp/cgp_core.h"
 
 
-#define SWAP(A, B) (((A & 0x0F) << 4) | ((B & 0x0F)))
-#define ADD_SAT(A, B) ((A > 0xFF - B) ? 0xFF : A + B)
+#ifdef PIXEL16
+    // swaps bytes instead of nibbles
+    #define SWAP(A, B) (((A & 0xFF) << 8) | ((B & 0xFF)))
+#else
+    #define SWAP(A, B) (((A & 0x0F) << 4) | ((B & 0x0F)))
+#endif
+#define ADD_SAT(A, B) ((A > CGP_VALUE_MAX - B) ? CGP_VALUE_MAX : A + B)
 #define MAX(A, B) ((A > B) ? A : B)
 #define MIN(A, B) ((A < B) ? A : B)
 
@@ -41,9 +46,9 @@ bool cgp_get_node_output(cgp_node_t *n, cgp_value_t A,
     cgp_value_t B, cgp_value_t *Y)
 {
     switch (n->function) {
-        case c255:          *Y = 255;               break;
+        case c255:          *Y = CGP_VALUE_MAX;     break;
         case identity:      *Y = A;                 break;
-        case inversion:     *Y = 255 - A;           break;
+        case inversion:     *Y = CGP_VALUE_MAX - A; break;
         case b_or:          *Y = A | B;             break;
         case b_not1or2:     *Y = ~A | B;            break;
         case b_and:         *Y = A & B;             break;
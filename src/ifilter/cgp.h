@@ -21,14 +21,33 @@
 #pragma once
 
 
+#include <stdint.h>
+
+
 #define CGP_INPUTS 9
 #define CGP_OUTPUTS 1
 #define CGP_FUNC_INPUTS 2
 
 
-typedef unsigned char cgp_value_t;
+#ifdef PIXEL16
+    // only scalar and AVX2 evaluators handle 16-bit values
+    #if defined(SSE2) || defined(AVX512)
+        #error "PIXEL16 build requires SSE2 and AVX512 to be disabled"
+    #endif
+
+    typedef uint16_t cgp_value_t;
+    #define CGP_VALUE_MAX 0xFFFF
+    #define CGP_VALUE_MAX_CODE "65535"
+    // ascii art node is 4 characters wide
+    #define CGP_ASCIIART_CONSTANT_FORMAT "%4x"
+#else
+    typedef unsigned char cgp_value_t;
+    #define CGP_VALUE_MAX 0xFF
+    #define CGP_VALUE_MAX_CODE "255"
+    #define CGP_ASCIIART_CONSTANT_FORMAT "%4u"
+#endif
+
 #define CGP_VALUE_FORMAT "%u"
-#define CGP_ASCIIART_CONSTANT_FORMAT "%4u"
 
 
 /* remember, number of inputs is declared in cgp_config.h */
@@ -95,29 +114,35 @@ static const int CGP_FUNC_ARITY[] = {
 
 
 static const char * const CGP_FUNC_CODE[] = {
-    "255",              // 255
-    "%s",               // a
-    "255 - %s",         // 255 - a
-    "%s | %s",          // a or b
-    "(~%s) | %s",       // (not a) or b
-    "%s & %s",          // a and b
-    "~(%s & %s)",       // not (a and b)
-    "%s ^ %s",          // a xor b
-    "%s >> 1",          // a >> 1
-    "%s >> 2",          // a >> 2
-    "SWAP(%s, %s)",     // a <-> b
-    "%s + %s",          // a + b
-    "ADD_SAT(%s, %s)",  // a +S b
-    "(%s + %s) >> 1",   // (a + b) >> 1
-    "MAX(%s, %s)",      // max(a, b)
-    "MIN(%s, %s)",      // min(a, b)
+    CGP_VALUE_MAX_CODE,             // 255
+    "%s",                           // a
+    CGP_VALUE_MAX_CODE " - %s",     // 255 - a
+    "%s | %s",                      // a or b
+    "(~%s) | %s",                   // (not a) or b
+    "%s & %s",                      // a and b
+    "~(%s & %s)",                   // not (a and b)
+    "%s ^ %s",                      // a xor b
+    "%s >> 1",                      // a >> 1
+    "%s >> 2",                      // a >> 2
+    "SWAP(%s, %s)",                 // a <-> b
+    "%s + %s",                      // a + b
+    "ADD_SAT(%s, %s)",              // a +S b
+    "(%s + %s) >> 1",               // (a + b) >> 1
+    "MAX(%s, %s)",                  // max(a, b)
+    "MIN(%s, %s)",                  // min(a, b)
 };
 
 
 static const char * const CGP_CODE_PROLOG =
+#ifdef PIXEL16
+    "typedef unsigned short cgp_value_t;\n\n"
+    "#define SWAP(A, B) (((A & 0xFF) << 8) | ((B & 0xFF)))\n"
+    "#define ADD_SAT(A, B) ((A > 0xFFFF - B) ? 0xFFFF : A + B)\n"
+#else
     "typedef unsigned char cgp_value_t;\n\n"
     "#define SWAP(A, B) (((A & 0x0F) << 4) | ((B & 0x0F)))\n"
     "#define ADD_SAT(A, B) ((A > 0xFF - B) ? 0xFF : A + B)\n"
+#endif
     "#define MAX(A, B) ((A > B) ? A : B)\n"
     "#define MIN(A, B) ((A < B) ? A : B)\n\n"
 ;
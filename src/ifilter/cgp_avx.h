@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <stdlib.h>
 #include <immintrin.h>
 
 #include "../cgp/cgp_core.h"
@@ -38,3 +39,269 @@
  * @param outputs
  */
 void cgp_get_output_avx(ga_chr_t chromosome, __m256i_aligned inputs[CGP_INPUTS], __m256i_aligned outputs[CGP_OUTPUTS]);
+
+
+#ifdef PIXEL16
+
+
+/**
+ * Calculate output of one node using AVX2 instructions, 16 values of
+ * 16 bits are processed at once. All functions have native 16-bit
+ * instructions, so results are identical to scalar `cgp_get_node_output`.
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m256i cgp_eval_node_avx(cgp_func_t function, __m256i A, __m256i B)
+{
+    // 0xFFFF constant
+    const __m256i FF = _mm256_set1_epi16(0xFFFF);
+
+    __m256i Y;
+    __m256i odd;
+
+    switch (function) {
+        case c255:
+            Y = FF;
+            break;
+
+        case identity:
+            Y = A;
+            break;
+
+        case inversion:
+            Y = _mm256_sub_epi16(FF, A);
+            break;
+
+        case b_or:
+            Y = _mm256_or_si256(A, B);
+            break;
+
+        case b_not1or2:
+            Y = _mm256_xor_si256(FF, A);
+            Y = _mm256_or_si256(Y, B);
+            break;
+
+        case b_and:
+            Y = _mm256_and_si256(A, B);
+            break;
+
+        case b_nand:
+            Y = _mm256_and_si256(A, B);
+            Y = _mm256_xor_si256(FF, Y);
+            break;
+
+        case b_xor:
+            Y = _mm256_xor_si256(A, B);
+            break;
+
+        case rshift1:
+            Y = _mm256_srli_epi16(A, 1);
+            break;
+
+        case rshift2:
+            Y = _mm256_srli_epi16(A, 2);
+            break;
+
+        case swap:
+            // SWAP(A, B) (((A & 0xFF) << 8) | ((B & 0xFF))), shift drops
+            // the high byte of A
+            Y = _mm256_and_si256(B, _mm256_set1_epi16(0x00FF));
+            Y = _mm256_or_si256(Y, _mm256_slli_epi16(A, 8));
+            break;
+
+        case add:
+            Y = _mm256_add_epi16(A, B);
+            break;
+
+        case add_sat:
+            Y = _mm256_adds_epu16(A, B);
+            break;
+
+        case avg:
+            // rounded up average, minus one where A + B is odd
+            odd = _mm256_and_si256(_mm256_xor_si256(A, B), _mm256_set1_epi16(1));
+            Y = _mm256_sub_epi16(_mm256_avg_epu16(A, B), odd);
+            break;
+
+        case max:
+            Y = _mm256_max_epu16(A, B);
+            break;
+
+        case min:
+            Y = _mm256_min_epu16(A, B);
+            break;
+
+        default:
+            abort();
+    }
+    return Y;
+}
+
+
+/**
+ * Calculate output of one node using AVX2 instructions, with results
+ * identical to scalar `cgp_get_node_output` - which all 16-bit functions are
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m256i cgp_eval_node_exact_avx(cgp_func_t function, __m256i A, __m256i B)
+{
+    return cgp_eval_node_avx(function, A, B);
+}
+
+
+#else
+
+
+/**
+ * Calculate output of one node using AVX2 instructions
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m256i cgp_eval_node_avx(cgp_func_t function, __m256i A, __m256i B)
+{
+    // 0xFF constant
+    const __m256i FF = _mm256_set1_epi8(0xFF);
+
+    __m256i Y;
+    __m256i TMP;
+    __m256i mask;
+
+    switch (function) {
+        case c255:
+            Y = FF;
+            break;
+
+        case identity:
+            Y = A;
+            break;
+
+        case inversion:
+            Y = _mm256_sub_epi8(FF, A);
+            break;
+
+        case b_or:
+            Y = _mm256_or_si256(A, B);
+            break;
+
+        case b_not1or2:
+            // we don't have NOT instruction, we need to XOR with FF
+            Y = _mm256_xor_si256(FF, A);
+            Y = _mm256_or_si256(Y, B);
+            break;
+
+        case b_and:
+            Y = _mm256_and_si256(A, B);
+            break;
+
+        case b_nand:
+            Y = _mm256_and_si256(A, B);
+            Y = _mm256_xor_si256(FF, Y);
+            break;
+
+        case b_xor:
+            Y = _mm256_xor_si256(A, B);
+            break;
+
+        case rshift1:
+            // no SR instruction for 8bit data, we need to shift
+            // 16 bits and apply mask
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHR: [ 0 1 2 3 4 5 6 7 | 8 A B C D E F G]
+            // MSK: [ 0 1 2 3 4 5 6 7 | 0 A B C D E F G]
+            mask = _mm256_set1_epi8(0x7F);
+            Y = _mm256_srli_epi16(A, 1);
+            Y = _mm256_and_si256(Y, mask);
+            break;
+
+        case rshift2:
+            // similar to rshift1
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHR: [ 0 0 1 2 3 4 5 6 | 7 8 A B C D E F]
+            // MSK: [ 0 0 1 2 3 4 5 6 | 0 0 A B C D E F]
+            mask = _mm256_set1_epi8(0x3F);
+            Y = _mm256_srli_epi16(A, 2);
+            Y = _mm256_and_si256(Y, mask);
+            break;
+
+        case swap:
+            // SWAP(A, B) (((A & 0x0F) << 4) | ((B & 0x0F)))
+            // Shift A left by 4 bits
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHL: [ 5 6 7 8 A B C D | E F G H 0 0 0 0]
+            // MSK: [ 5 6 7 8 0 0 0 0 | E F G H 0 0 0 0]
+            mask = _mm256_set1_epi8(0xF0);
+            TMP = _mm256_slli_epi16(A, 4);
+            TMP = _mm256_and_si256(TMP, mask);
+
+            // Mask B
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // MSK: [ 0 0 0 0 5 6 7 8 | 0 0 0 0 E F G H]
+            mask = _mm256_set1_epi8(0x0F);
+            Y = _mm256_and_si256(B, mask);
+
+            // Combine
+            Y = _mm256_or_si256(Y, TMP);
+            break;
+
+        case add:
+            Y = _mm256_add_epi8(A, B);
+            break;
+
+        case add_sat:
+            Y = _mm256_adds_epu8(A, B);
+            break;
+
+        case avg:
+            // shift right first, then add, to avoid overflow
+            mask = _mm256_set1_epi8(0x7F);
+            TMP = _mm256_srli_epi16(A, 1);
+            TMP = _mm256_and_si256(TMP, mask);
+
+            Y = _mm256_srli_epi16(B, 1);
+            Y = _mm256_and_si256(Y, mask);
+
+            Y = _mm256_add_epi8(Y, TMP);
+            break;
+
+        case max:
+            Y = _mm256_max_epu8(A, B);
+            break;
+
+        case min:
+            Y = _mm256_min_epu8(A, B);
+            break;
+
+        default:
+            abort();
+    }
+    return Y;
+}
+
+
+/**
+ * Calculate output of one node using AVX2 instructions, with results
+ * identical to scalar `cgp_get_node_output` (see `cgp_eval_node_exact_sse`)
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m256i cgp_eval_node_exact_avx(cgp_func_t function, __m256i A, __m256i B)
+{
+    if (function == avg) {
+        // rounded up average, minus one where A + B is odd
+        __m256i odd = _mm256_and_si256(_mm256_xor_si256(A, B), _mm256_set1_epi8(1));
+        return _mm256_sub_epi8(_mm256_avg_epu8(A, B), odd);
+    }
+    return cgp_eval_node_avx(function, A, B);
+}
+
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#include <stdlib.h>
+#include <assert.h>
+#include <immintrin.h>
+
+#include "cgp_avx512.h"
+
+
+// primary inputs are read directly, copying them to the node value array
+// costs more than the comparison
+#define VALUE(idx) ((idx) < CGP_INPUTS ? inputs[(idx)] : values[(idx)])
+
+#define UCFMT1 "%u"
+#define UCFMT4 UCFMT1 ", " UCFMT1 ", " UCFMT1 ", " UCFMT1
+#define UCFMT16 UCFMT4 ", " UCFMT4 ", " UCFMT4 ", " UCFMT4
+#define UCFMT64 UCFMT16 ", " UCFMT16 ", " UCFMT16 ", " UCFMT16
+
+#define UCVAL1(n) _tmp[n]
+#define UCVAL4(n) UCVAL1(n), UCVAL1(n+1), UCVAL1(n+2), UCVAL1(n+3)
+#define UCVAL16(n) UCVAL4(n), UCVAL4(n+4), UCVAL4(n+8), UCVAL4(n+12)
+#define UCVAL64(n) UCVAL16(n), UCVAL16(n+16), UCVAL16(n+32), UCVAL16(n+48)
+
+#define PRINT_REG(reg) do { \
+    __m512i _tmpval = reg; \
+    unsigned char *_tmp = (unsigned char*) &_tmpval; \
+    printf(UCFMT64 "\n", UCVAL64(0)); \
+} while(0);
+
+
+/**
+ * Calculate output of given chromosome and inputs using AVX-512BW instructions
+ * @param chr
+ * @param inputs
+ * @param outputs
+ */
+void cgp_get_output_avx512(ga_chr_t chromosome,
+    __m512i_aligned inputs[CGP_INPUTS], __m512i_aligned outputs[CGP_OUTPUTS])
+{
+#ifdef AVX512
+    // outputs of all nodes, indexed the same way as node inputs (slots
+    // below CGP_INPUTS are unused, see VALUE); only active nodes are written
+    __m512i_aligned values[CGP_INPUTS + CGP_NODES];
+
+    cgp_genome_t genome = (cgp_genome_t) chromosome->genome;
+
+#ifdef TEST_EVAL_AVX512
+
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        unsigned char *_tmp = (unsigned char*) &inputs[i];
+        printf("I: %2d = " UCFMT64 "\n", i, UCVAL64(0));
+    }
+#endif
+
+    // program holds active nodes only, in evaluation order
+    for (int i = 0; i < genome->program_length; i++) {
+        cgp_instr_t *instr = &(genome->program[i]);
+        register __m512i A = VALUE(instr->inputs[0]);
+        register __m512i B = VALUE(instr->inputs[1]);
+        register __m512i Y = cgp_eval_node_avx512(instr->function, A, B);
+
+
+#ifdef TEST_EVAL_AVX512
+        __m512i _tmpval = Y;
+        unsigned char *_tmp = (unsigned char*) &_tmpval;
+        printf("N: %2d = " UCFMT64 "\n", instr->output, UCVAL64(0));
+
+        bool mismatch = false;
+        for (int i = 1; i < 64; i++) {
+            if (_tmp[i] != _tmp[0]) {
+                fprintf(stderr,
+                    "Value mismatch on index %2d (%u instead of %u)\n",
+                    i, _tmp[i], _tmp[0]);
+                mismatch = true;
+            }
+        }
+        if (mismatch) {
+            abort();
+        }
+#endif
+
+        values[instr->output] = Y;
+    } // end of program
+
+    for (int i = 0; i < CGP_OUTPUTS; i++) {
+        _mm512_store_si512(&outputs[i], VALUE(genome->outputs[i]));
+    }
+
+#ifdef TEST_EVAL_AVX512
+    for (int i = 0; i < CGP_OUTPUTS; i++) {
+        unsigned char *_tmp = (unsigned char*) &outputs[i];
+        printf("O: %2d = " UCFMT64 "\n", i, UCVAL64(0));
+    }
+#endif
+
+
+#endif
+}
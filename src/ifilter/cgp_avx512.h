@@ -0,0 +1,170 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#pragma once
+
+#include <stdlib.h>
+#include <immintrin.h>
+
+#include "../cgp/cgp_core.h"
+
+
+#if defined(_ISOC11_SOURCE)
+    typedef __m512i __m512i_aligned alignas(64);
+#elif __GNUC__ || __IBMC__ || __IBMCPP__ || 0x5110 <= __SUNPRO_C
+    typedef __m512i __m512i_aligned __attribute__ ((aligned (64)));
+#endif
+
+/**
+ * Calculate output of given chromosome and inputs using AVX-512BW instructions
+ * @param chr
+ * @param inputs
+ * @param outputs
+ */
+void cgp_get_output_avx512(ga_chr_t chromosome, __m512i_aligned inputs[CGP_INPUTS], __m512i_aligned outputs[CGP_OUTPUTS]);
+
+
+/**
+ * Calculate output of one node using AVX-512BW instructions
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m512i cgp_eval_node_avx512(cgp_func_t function, __m512i A, __m512i B)
+{
+    // 0xFF constant
+    const __m512i FF = _mm512_set1_epi8(0xFF);
+
+    __m512i Y;
+    __m512i TMP;
+    __m512i mask;
+
+    switch (function) {
+        case c255:
+            Y = FF;
+            break;
+
+        case identity:
+            Y = A;
+            break;
+
+        case inversion:
+            Y = _mm512_sub_epi8(FF, A);
+            break;
+
+        case b_or:
+            Y = _mm512_or_si512(A, B);
+            break;
+
+        case b_not1or2:
+            // ternary logic with truth table of (~A | B), third
+            // operand is not used
+            Y = _mm512_ternarylogic_epi32(A, B, B, 0xCF);
+            break;
+
+        case b_and:
+            Y = _mm512_and_si512(A, B);
+            break;
+
+        case b_nand:
+            // ternary logic with truth table of ~(A & B)
+            Y = _mm512_ternarylogic_epi32(A, B, B, 0x3F);
+            break;
+
+        case b_xor:
+            Y = _mm512_xor_si512(A, B);
+            break;
+
+        case rshift1:
+            // no SR instruction for 8bit data, we need to shift
+            // 16 bits and apply mask
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHR: [ 0 1 2 3 4 5 6 7 | 8 A B C D E F G]
+            // MSK: [ 0 1 2 3 4 5 6 7 | 0 A B C D E F G]
+            mask = _mm512_set1_epi8(0x7F);
+            Y = _mm512_srli_epi16(A, 1);
+            Y = _mm512_and_si512(Y, mask);
+            break;
+
+        case rshift2:
+            // similar to rshift1
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHR: [ 0 0 1 2 3 4 5 6 | 7 8 A B C D E F]
+            // MSK: [ 0 0 1 2 3 4 5 6 | 0 0 A B C D E F]
+            mask = _mm512_set1_epi8(0x3F);
+            Y = _mm512_srli_epi16(A, 2);
+            Y = _mm512_and_si512(Y, mask);
+            break;
+
+        case swap:
+            // SWAP(A, B) (((A & 0x0F) << 4) | ((B & 0x0F)))
+            // Shift A left by 4 bits
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHL: [ 5 6 7 8 A B C D | E F G H 0 0 0 0]
+            // MSK: [ 5 6 7 8 0 0 0 0 | E F G H 0 0 0 0]
+            mask = _mm512_set1_epi8(0xF0);
+            TMP = _mm512_slli_epi16(A, 4);
+            TMP = _mm512_and_si512(TMP, mask);
+
+            // Mask B
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // MSK: [ 0 0 0 0 5 6 7 8 | 0 0 0 0 E F G H]
+            mask = _mm512_set1_epi8(0x0F);
+            Y = _mm512_and_si512(B, mask);
+
+            // Combine
+            Y = _mm512_or_si512(Y, TMP);
+            break;
+
+        case add:
+            Y = _mm512_add_epi8(A, B);
+            break;
+
+        case add_sat:
+            Y = _mm512_adds_epu8(A, B);
+            break;
+
+        case avg:
+            // shift right first, then add, to avoid overflow
+            mask = _mm512_set1_epi8(0x7F);
+            TMP = _mm512_srli_epi16(A, 1);
+            TMP = _mm512_and_si512(TMP, mask);
+
+            Y = _mm512_srli_epi16(B, 1);
+            Y = _mm512_and_si512(Y, mask);
+
+            Y = _mm512_add_epi8(Y, TMP);
+            break;
+
+        case max:
+            Y = _mm512_max_epu8(A, B);
+            break;
+
+        case min:
+            Y = _mm512_min_epu8(A, B);
+            break;
+
+        default:
+            abort();
+    }
+    return Y;
+}
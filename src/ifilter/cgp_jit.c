@@ -0,0 +1,709 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+/* MAP_ANONYMOUS is not part of POSIX */
+#define _DEFAULT_SOURCE
+
+#include <string.h>
+#include <stdlib.h>
+
+// generated code works with 8-bit values only
+#if defined(__x86_64__) && !defined(PIXEL16)
+    #define CGP_JIT_ENABLED
+#endif
+
+#ifdef CGP_JIT_ENABLED
+    #include <sys/mman.h>
+#endif
+
+#include "cgp_jit.h"
+
+
+#ifdef CGP_JIT_ENABLED
+
+
+#define JIT_BUFFER_SIZE 16384
+#define JIT_VECTOR_SIZE 32
+
+/* constants, stored at the beginning of the buffer */
+enum {
+    CONST_FF,
+    CONST_7F,
+    CONST_3F,
+    CONST_F0,
+    CONST_0F,
+    CONST_COUNT
+};
+static const unsigned char CONST_VALUES[CONST_COUNT] = {
+    0xFF, 0x7F, 0x3F, 0xF0, 0x0F
+};
+#define JIT_CODE_START (CONST_COUNT * JIT_VECTOR_SIZE)
+
+/* vector registers - node values are allocated in 0..9, rest is reserved */
+#define VALUE_REGS 10
+#define R_SSE_TMP 10
+#define R_T 11
+#define R_A 12
+#define R_B 13
+#define R_ACC 14
+#define R_ZERO 15
+
+/* general purpose registers */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RSP 4
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R8 8
+
+/* spilled values, one slot per CGP value */
+#define SPILL_SIZE ((CGP_INPUTS + CGP_NODES) * JIT_VECTOR_SIZE)
+
+/* SIMD prefixes, as encoded in VEX pp field */
+#define PP_NONE 0
+#define PP_66 1
+#define PP_F3 2
+
+/* opcodes (after 0F escape) */
+#define OP_MOVDQA 0x6F
+#define OP_MOVDQU_LOAD 0x6F
+#define OP_MOVDQU_STORE 0x7F
+#define OP_PUNPCKLBW 0x60
+#define OP_PUNPCKHBW 0x68
+#define OP_SHIFT_IMM 0x71
+#define OP_PCMPEQB 0x74
+#define OP_PSUBUSB 0xD8
+#define OP_PMINUB 0xDA
+#define OP_PAND 0xDB
+#define OP_PADDUSB 0xDC
+#define OP_PMAXUB 0xDE
+#define OP_POR 0xEB
+#define OP_PXOR 0xEF
+#define OP_PMADDWD 0xF5
+#define OP_PADDB 0xFC
+#define OP_PADDD 0xFE
+
+#define SHIFT_SRL 2
+#define SHIFT_SLL 6
+
+
+/**
+ * Instruction operand - vector register or memory
+ */
+typedef enum {
+    OPND_REG,
+    OPND_BASE_INDEX,
+    OPND_BASE_DISP,
+    OPND_CONST,
+} _opnd_kind_t;
+
+typedef struct {
+    _opnd_kind_t kind;
+    int reg;
+    int base;
+    int index;
+    int32_t disp;
+} _opnd_t;
+
+
+static inline _opnd_t _reg(int reg)
+{
+    return (_opnd_t) { .kind = OPND_REG, .reg = reg };
+}
+
+static inline _opnd_t _mem_bi(int base, int index)
+{
+    return (_opnd_t) { .kind = OPND_BASE_INDEX, .base = base, .index = index };
+}
+
+static inline _opnd_t _mem_bd(int base, int32_t disp)
+{
+    return (_opnd_t) { .kind = OPND_BASE_DISP, .base = base, .disp = disp };
+}
+
+static inline _opnd_t _const(int c)
+{
+    return (_opnd_t) { .kind = OPND_CONST, .disp = c * JIT_VECTOR_SIZE };
+}
+
+
+/* Encoder ********************************************************************/
+
+
+static inline void _emit(cgp_jit_t jit, unsigned char byte)
+{
+    if (jit->length < jit->size) {
+        jit->buffer[jit->length++] = byte;
+    } else {
+        jit->overflow = true;
+    }
+}
+
+
+static inline void _emit32(cgp_jit_t jit, int32_t value)
+{
+    uint32_t v = (uint32_t) value;
+    for (int i = 0; i < 4; i++) {
+        _emit(jit, v & 0xFF);
+        v >>= 8;
+    }
+}
+
+
+static inline void _patch32(cgp_jit_t jit, size_t pos, int32_t value)
+{
+    uint32_t v = (uint32_t) value;
+    for (int i = 0; i < 4 && pos + i < jit->size; i++) {
+        jit->buffer[pos + i] = v & 0xFF;
+        v >>= 8;
+    }
+}
+
+
+/**
+ * Returns REX.X and REX.B bits of r/m operand
+ */
+static inline void _rm_ext(_opnd_t rm, int *x, int *b)
+{
+    *x = 0;
+    *b = 0;
+    switch (rm.kind) {
+        case OPND_REG:
+            *b = rm.reg >> 3;
+            break;
+        case OPND_BASE_INDEX:
+            *x = rm.index >> 3;
+            *b = rm.base >> 3;
+            break;
+        case OPND_BASE_DISP:
+            *b = rm.base >> 3;
+            break;
+        case OPND_CONST:
+            break;
+    }
+}
+
+
+/**
+ * Emits ModR/M byte and following SIB and displacement
+ */
+static void _emit_modrm(cgp_jit_t jit, int reg, _opnd_t rm)
+{
+    reg = (reg & 7) << 3;
+
+    switch (rm.kind) {
+        case OPND_REG:
+            _emit(jit, 0xC0 | reg | (rm.reg & 7));
+            break;
+
+        case OPND_BASE_INDEX:
+            // [rbp + index] cannot be encoded without displacement
+            if ((rm.base & 7) == RBP) {
+                _emit(jit, 0x44 | reg);
+                _emit(jit, ((rm.index & 7) << 3) | (rm.base & 7));
+                _emit(jit, 0);
+            } else {
+                _emit(jit, 0x04 | reg);
+                _emit(jit, ((rm.index & 7) << 3) | (rm.base & 7));
+            }
+            break;
+
+        case OPND_BASE_DISP:
+            _emit(jit, 0x80 | reg | (rm.base & 7));
+            if ((rm.base & 7) == RSP) {
+                _emit(jit, 0x24);
+            }
+            _emit32(jit, rm.disp);
+            break;
+
+        case OPND_CONST:
+            // RIP relative, displacement is counted from instruction end
+            _emit(jit, 0x05 | reg);
+            _emit32(jit, rm.disp - (int32_t) (jit->length + 4));
+            break;
+    }
+}
+
+
+/**
+ * Emits SIMD instruction `op reg, vvvv, rm` in VEX (AVX2) or legacy
+ * (SSE2, `op reg, rm`) encoding
+ */
+static void _emit_simd(cgp_jit_t jit, int pp, unsigned char opcode,
+    int reg, int vvvv, _opnd_t rm)
+{
+    int r = reg >> 3;
+    int x, b;
+    _rm_ext(rm, &x, &b);
+
+    if (jit->isa == cgp_jit_avx2) {
+        _emit(jit, 0xC4);
+        _emit(jit, ((!r) << 7) | ((!x) << 6) | ((!b) << 5) | 0x01);
+        _emit(jit, (((~vvvv) & 0x0F) << 3) | (1 << 2) | pp);
+
+    } else {
+        if (pp == PP_66) _emit(jit, 0x66);
+        if (pp == PP_F3) _emit(jit, 0xF3);
+        if (r || x || b) {
+            _emit(jit, 0x40 | (r << 2) | (x << 1) | b);
+        }
+        _emit(jit, 0x0F);
+    }
+
+    _emit(jit, opcode);
+    _emit_modrm(jit, reg, rm);
+}
+
+
+static inline void _emit_mov(cgp_jit_t jit, int dst, int src)
+{
+    if (dst != src) {
+        _emit_simd(jit, PP_66, OP_MOVDQA, dst, 0, _reg(src));
+    }
+}
+
+
+static inline void _emit_load(cgp_jit_t jit, int dst, _opnd_t mem)
+{
+    _emit_simd(jit, PP_F3, OP_MOVDQU_LOAD, dst, 0, mem);
+}
+
+
+static inline void _emit_store(cgp_jit_t jit, _opnd_t mem, int src)
+{
+    _emit_simd(jit, PP_F3, OP_MOVDQU_STORE, src, 0, mem);
+}
+
+
+/**
+ * Emits `dst = op(src1, src2)`. SSE2 instructions are destructive, so
+ * operands are copied as needed.
+ */
+static void _emit_op(cgp_jit_t jit, unsigned char opcode, int dst, int src1,
+    _opnd_t src2, bool commutative)
+{
+    if (jit->isa == cgp_jit_avx2 || dst == src1) {
+        _emit_simd(jit, PP_66, opcode, dst, src1, src2);
+
+    } else if (src2.kind == OPND_REG && src2.reg == dst) {
+        if (commutative) {
+            _emit_simd(jit, PP_66, opcode, dst, dst, _reg(src1));
+        } else {
+            _emit_mov(jit, R_SSE_TMP, src1);
+            _emit_simd(jit, PP_66, opcode, R_SSE_TMP, R_SSE_TMP, src2);
+            _emit_mov(jit, dst, R_SSE_TMP);
+        }
+
+    } else {
+        _emit_mov(jit, dst, src1);
+        _emit_simd(jit, PP_66, opcode, dst, dst, src2);
+    }
+}
+
+
+/**
+ * Emits `dst = src >> imm` or `dst = src << imm` on 16-bit lanes
+ */
+static void _emit_shift(cgp_jit_t jit, int kind, int dst, int src, int imm)
+{
+    if (jit->isa == cgp_jit_avx2) {
+        _emit_simd(jit, PP_66, OP_SHIFT_IMM, kind, dst, _reg(src));
+    } else {
+        _emit_mov(jit, dst, src);
+        _emit_simd(jit, PP_66, OP_SHIFT_IMM, kind, 0, _reg(dst));
+    }
+    _emit(jit, imm);
+}
+
+
+/* Code generator *************************************************************/
+
+
+/**
+ * Location of value during block evaluation
+ */
+typedef struct {
+    int reg;
+    bool spilled;
+} _loc_t;
+
+
+typedef struct {
+    _loc_t loc[CGP_INPUTS + CGP_NODES];
+    int last_use[CGP_INPUTS + CGP_NODES];
+    int free_regs;
+} _alloc_t;
+
+
+static inline int _alloc_reg(_alloc_t *alloc)
+{
+    for (int r = 0; r < VALUE_REGS; r++) {
+        if (alloc->free_regs & (1 << r)) {
+            alloc->free_regs &= ~(1 << r);
+            return r;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Makes value available in register - primary inputs are loaded from
+ * image planes, spilled values from stack. If no register is free,
+ * `scratch` is used.
+ */
+static int _fetch(cgp_jit_t jit, _alloc_t *alloc, int slot, int scratch)
+{
+    _loc_t *loc = &alloc->loc[slot];
+
+    if (loc->reg >= 0) {
+        return loc->reg;
+    }
+
+    if (loc->spilled) {
+        _emit_load(jit, scratch, _mem_bd(RSP, slot * JIT_VECTOR_SIZE));
+        return scratch;
+    }
+
+    // primary input: mov rax, [rsi + 8 * slot]; movdqu reg, [rax + rdx]
+    int reg = _alloc_reg(alloc);
+    if (reg < 0) {
+        reg = scratch;
+    } else {
+        loc->reg = reg;
+    }
+
+    _emit(jit, 0x48);
+    _emit(jit, 0x8B);
+    _emit(jit, 0x46);
+    _emit(jit, slot * 8);
+    _emit_load(jit, reg, _mem_bi(RAX, RDX));
+    return reg;
+}
+
+
+/**
+ * Emits code of one CGP function, see `cgp_eval_node_avx`
+ */
+static void _emit_function(cgp_jit_t jit, cgp_func_t function,
+    int dst, int a, int b)
+{
+    switch (function) {
+        case c255:
+            _emit_op(jit, OP_PCMPEQB, dst, dst, _reg(dst), true);
+            break;
+
+        case identity:
+            _emit_mov(jit, dst, a);
+            break;
+
+        case inversion:
+            // 255 - a == a xor 255
+            _emit_op(jit, OP_PXOR, dst, a, _const(CONST_FF), true);
+            break;
+
+        case b_or:
+            _emit_op(jit, OP_POR, dst, a, _reg(b), true);
+            break;
+
+        case b_not1or2:
+            _emit_op(jit, OP_PXOR, R_T, a, _const(CONST_FF), true);
+            _emit_op(jit, OP_POR, dst, R_T, _reg(b), true);
+            break;
+
+        case b_and:
+            _emit_op(jit, OP_PAND, dst, a, _reg(b), true);
+            break;
+
+        case b_nand:
+            _emit_op(jit, OP_PAND, R_T, a, _reg(b), true);
+            _emit_op(jit, OP_PXOR, dst, R_T, _const(CONST_FF), true);
+            break;
+
+        case b_xor:
+            _emit_op(jit, OP_PXOR, dst, a, _reg(b), true);
+            break;
+
+        case rshift1:
+            _emit_shift(jit, SHIFT_SRL, R_T, a, 1);
+            _emit_op(jit, OP_PAND, dst, R_T, _const(CONST_7F), true);
+            break;
+
+        case rshift2:
+            _emit_shift(jit, SHIFT_SRL, R_T, a, 2);
+            _emit_op(jit, OP_PAND, dst, R_T, _const(CONST_3F), true);
+            break;
+
+        case swap:
+            _emit_shift(jit, SHIFT_SLL, R_T, a, 4);
+            _emit_op(jit, OP_PAND, R_T, R_T, _const(CONST_F0), true);
+            _emit_op(jit, OP_PAND, R_B, b, _const(CONST_0F), true);
+            _emit_op(jit, OP_POR, dst, R_T, _reg(R_B), true);
+            break;
+
+        case add:
+            _emit_op(jit, OP_PADDB, dst, a, _reg(b), true);
+            break;
+
+        case add_sat:
+            _emit_op(jit, OP_PADDUSB, dst, a, _reg(b), true);
+            break;
+
+        case avg:
+            _emit_shift(jit, SHIFT_SRL, R_T, a, 1);
+            _emit_op(jit, OP_PAND, R_T, R_T, _const(CONST_7F), true);
+            _emit_shift(jit, SHIFT_SRL, R_B, b, 1);
+            _emit_op(jit, OP_PAND, R_B, R_B, _const(CONST_7F), true);
+            _emit_op(jit, OP_PADDB, dst, R_T, _reg(R_B), true);
+            break;
+
+        case max:
+            _emit_op(jit, OP_PMAXUB, dst, a, _reg(b), true);
+            break;
+
+        case min:
+            _emit_op(jit, OP_PMINUB, dst, a, _reg(b), true);
+            break;
+
+        default:
+            abort();
+    }
+}
+
+
+/**
+ * Returns whether code generation is supported on this platform
+ */
+bool cgp_jit_supported()
+{
+    return true;
+}
+
+
+/**
+ * Allocates executable buffer
+ *
+ * @param  isa
+ * @return NULL on failure
+ */
+cgp_jit_t cgp_jit_create(cgp_jit_isa_t isa)
+{
+    cgp_jit_t jit = (cgp_jit_t) malloc(sizeof(struct cgp_jit));
+    if (jit == NULL) {
+        return NULL;
+    }
+
+    void *buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+
+    jit->isa = isa;
+    jit->step = (isa == cgp_jit_avx2) ? 32 : 16;
+    jit->buffer = (unsigned char*) buffer;
+    jit->size = JIT_BUFFER_SIZE;
+    jit->length = 0;
+    jit->overflow = false;
+    jit->kernel = NULL;
+    return jit;
+}
+
+
+/**
+ * Frees executable buffer
+ *
+ * @param jit
+ */
+void cgp_jit_destroy(cgp_jit_t jit)
+{
+    if (jit == NULL) return;
+    munmap(jit->buffer, jit->size);
+    free(jit);
+}
+
+
+/**
+ * Translates active nodes of circuit to machine code. Previous code
+ * in buffer is replaced.
+ *
+ * Generated function is
+ *
+ *     kernel(rdi = original, rsi = noisy, rdx = offset, rcx = blocks,
+ *            r8 = lanes)
+ *
+ * Node values live in vector registers until their last use, if there
+ * is not enough registers, they are spilled to stack.
+ *
+ * @param  jit
+ * @param  genome
+ * @return Whether `jit->kernel` can be called
+ */
+bool cgp_jit_compile(cgp_jit_t jit, cgp_genome_t genome)
+{
+    // buffer is never writable and executable at the same time
+    jit->kernel = NULL;
+    if (mprotect(jit->buffer, jit->size, PROT_READ | PROT_WRITE)) {
+        return false;
+    }
+
+    jit->length = 0;
+    jit->overflow = false;
+
+    for (int c = 0; c < CONST_COUNT; c++) {
+        memset(jit->buffer + c * JIT_VECTOR_SIZE, CONST_VALUES[c],
+            JIT_VECTOR_SIZE);
+    }
+    jit->length = JIT_CODE_START;
+
+    _alloc_t alloc;
+    alloc.free_regs = (1 << VALUE_REGS) - 1;
+    for (int i = 0; i < CGP_INPUTS + CGP_NODES; i++) {
+        alloc.loc[i].reg = -1;
+        alloc.loc[i].spilled = false;
+        alloc.last_use[i] = -1;
+    }
+    for (int k = 0; k < genome->program_length; k++) {
+        cgp_instr_t *instr = &genome->program[k];
+        for (int j = 0; j < CGP_FUNC_ARITY[instr->function]; j++) {
+            alloc.last_use[instr->inputs[j]] = k;
+        }
+    }
+    alloc.last_use[genome->outputs[0]] = genome->program_length;
+
+    // push rbp; mov rbp, rsp; sub rsp, SPILL_SIZE; and rsp, -32
+    _emit(jit, 0x55);
+    _emit(jit, 0x48); _emit(jit, 0x89); _emit(jit, 0xE5);
+    _emit(jit, 0x48); _emit(jit, 0x81); _emit(jit, 0xEC); _emit32(jit, SPILL_SIZE);
+    _emit(jit, 0x48); _emit(jit, 0x83); _emit(jit, 0xE4); _emit(jit, 0xE0);
+
+    _emit_op(jit, OP_PXOR, R_ZERO, R_ZERO, _reg(R_ZERO), true);
+    _emit_op(jit, OP_PXOR, R_ACC, R_ACC, _reg(R_ACC), true);
+
+    // test rcx, rcx; jz end
+    _emit(jit, 0x48); _emit(jit, 0x85); _emit(jit, 0xC9);
+    _emit(jit, 0x0F); _emit(jit, 0x84);
+    size_t jz_pos = jit->length;
+    _emit32(jit, 0);
+
+    size_t loop_start = jit->length;
+
+    for (int k = 0; k < genome->program_length; k++) {
+        cgp_instr_t *instr = &genome->program[k];
+        int arity = CGP_FUNC_ARITY[instr->function];
+        int slot = instr->output;
+
+        int a = R_A;
+        int b = R_B;
+        if (arity > 0) a = _fetch(jit, &alloc, instr->inputs[0], R_A);
+        if (arity > 1) b = _fetch(jit, &alloc, instr->inputs[1], R_B);
+
+        // registers of values used for the last time may hold result
+        for (int j = 0; j < arity; j++) {
+            _loc_t *loc = &alloc.loc[instr->inputs[j]];
+            if (alloc.last_use[instr->inputs[j]] == k && loc->reg >= 0) {
+                alloc.free_regs |= 1 << loc->reg;
+                loc->reg = -1;
+            }
+        }
+
+        int dst = _alloc_reg(&alloc);
+        _emit_function(jit, instr->function, dst >= 0 ? dst : R_A, a, b);
+
+        if (dst >= 0) {
+            alloc.loc[slot].reg = dst;
+        } else {
+            _emit_store(jit, _mem_bd(RSP, slot * JIT_VECTOR_SIZE), R_A);
+            alloc.loc[slot].spilled = true;
+        }
+    }
+
+    // |filtered - original| of unsigned bytes, squared and summed
+    int filtered = _fetch(jit, &alloc, genome->outputs[0], R_A);
+    _emit_load(jit, R_B, _mem_bi(RDI, RDX));
+    _emit_op(jit, OP_PSUBUSB, R_T, filtered, _reg(R_B), false);
+    _emit_op(jit, OP_PSUBUSB, R_B, R_B, _reg(filtered), false);
+    _emit_op(jit, OP_POR, R_T, R_T, _reg(R_B), true);
+    _emit_op(jit, OP_PUNPCKHBW, R_B, R_T, _reg(R_ZERO), false);
+    _emit_op(jit, OP_PUNPCKLBW, R_T, R_T, _reg(R_ZERO), false);
+    _emit_op(jit, OP_PMADDWD, R_T, R_T, _reg(R_T), true);
+    _emit_op(jit, OP_PMADDWD, R_B, R_B, _reg(R_B), true);
+    _emit_op(jit, OP_PADDD, R_ACC, R_ACC, _reg(R_T), true);
+    _emit_op(jit, OP_PADDD, R_ACC, R_ACC, _reg(R_B), true);
+
+    // add rdx, step; dec rcx; jnz loop_start
+    _emit(jit, 0x48); _emit(jit, 0x83); _emit(jit, 0xC2); _emit(jit, jit->step);
+    _emit(jit, 0x48); _emit(jit, 0xFF); _emit(jit, 0xC9);
+    _emit(jit, 0x0F); _emit(jit, 0x85);
+    _emit32(jit, (int32_t) loop_start - (int32_t) (jit->length + 4));
+
+    _patch32(jit, jz_pos, (int32_t) jit->length - (int32_t) (jz_pos + 4));
+
+    // movdqu [r8], acc; mov rsp, rbp; pop rbp; (vzeroupper); ret
+    _emit_store(jit, _mem_bd(R8, 0), R_ACC);
+    _emit(jit, 0x48); _emit(jit, 0x89); _emit(jit, 0xEC);
+    _emit(jit, 0x5D);
+    if (jit->isa == cgp_jit_avx2) {
+        _emit(jit, 0xC5); _emit(jit, 0xF8); _emit(jit, 0x77);
+    }
+    _emit(jit, 0xC3);
+
+    if (mprotect(jit->buffer, jit->size, PROT_READ | PROT_EXEC)) {
+        return false;
+    }
+    if (jit->overflow) {
+        return false;
+    }
+
+    jit->kernel = (cgp_jit_kernel_t) (void*) (jit->buffer + JIT_CODE_START);
+    return true;
+}
+
+
+#else /* CGP_JIT_ENABLED */
+
+
+bool cgp_jit_supported()
+{
+    return false;
+}
+
+
+cgp_jit_t cgp_jit_create(cgp_jit_isa_t isa)
+{
+    return NULL;
+}
+
+
+void cgp_jit_destroy(cgp_jit_t jit)
+{
+}
+
+
+bool cgp_jit_compile(cgp_jit_t jit, cgp_genome_t genome)
+{
+    return false;
+}
+
+
+#endif /* CGP_JIT_ENABLED */
@@ -0,0 +1,104 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../cgp/cgp_core.h"
+#include "image.h"
+
+
+/**
+ * Instruction set used by generated code
+ */
+typedef enum {
+    cgp_jit_sse2,
+    cgp_jit_avx2,
+} cgp_jit_isa_t;
+
+
+/**
+ * Compiled fitness kernel
+ *
+ * Evaluates circuit over `blocks` SIMD blocks starting at `offset` and
+ * stores sums of squared differences to 32-bit lanes (4 for SSE2, 8 for
+ * AVX2). Caller must keep `blocks` low enough for lanes not to overflow.
+ */
+typedef void (*cgp_jit_kernel_t)(
+    img_pixel_t *original,
+    img_pixel_t **noisy,
+    long offset,
+    long blocks,
+    uint32_t *lanes);
+
+
+/**
+ * Executable buffer with code of one circuit
+ */
+struct cgp_jit {
+    cgp_jit_isa_t isa;
+    int step;
+
+    unsigned char *buffer;
+    size_t size;
+    size_t length;
+    bool overflow;
+
+    cgp_jit_kernel_t kernel;
+};
+typedef struct cgp_jit* cgp_jit_t;
+
+
+/**
+ * Returns whether code generation is supported on this platform
+ */
+bool cgp_jit_supported();
+
+
+/**
+ * Allocates executable buffer
+ *
+ * @param  isa
+ * @return NULL on failure
+ */
+cgp_jit_t cgp_jit_create(cgp_jit_isa_t isa);
+
+
+/**
+ * Frees executable buffer
+ *
+ * @param jit
+ */
+void cgp_jit_destroy(cgp_jit_t jit);
+
+
+/**
+ * Translates active nodes of circuit to machine code. Previous code
+ * in buffer is replaced.
+ *
+ * @param  jit
+ * @param  genome
+ * @return Whether `jit->kernel` can be called
+ */
+bool cgp_jit_compile(cgp_jit_t jit, cgp_genome_t genome);
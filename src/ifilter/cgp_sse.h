@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <stdlib.h>
 #include <immintrin.h>
 
 #include "../cgp/cgp_core.h"
@@ -40,3 +41,151 @@
  */
 void cgp_get_output_sse(ga_chr_t chromosome,
     __m128i_aligned inputs[CGP_INPUTS], __m128i_aligned outputs[CGP_OUTPUTS]);
+
+
+/**
+ * Calculate output of one node using SSE2 instructions
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m128i cgp_eval_node_sse(cgp_func_t function, __m128i A, __m128i B)
+{
+    // 0xFF constant
+    const __m128i FF = _mm_set1_epi8(0xFF);
+
+    __m128i Y;
+    __m128i TMP;
+    __m128i mask;
+
+    switch (function) {
+        case c255:
+            Y = FF;
+            break;
+
+        case identity:
+            Y = A;
+            break;
+
+        case inversion:
+            Y = _mm_sub_epi8(FF, A);
+            break;
+
+        case b_or:
+            Y = _mm_or_si128(A, B);
+            break;
+
+        case b_not1or2:
+            // we don't have NOT instruction, we need to XOR with FF
+            Y = _mm_xor_si128(FF, A);
+            Y = _mm_or_si128(Y, B);
+            break;
+
+        case b_and:
+            Y = _mm_and_si128(A, B);
+            break;
+
+        case b_nand:
+            Y = _mm_and_si128(A, B);
+            Y = _mm_xor_si128(FF, Y);
+            break;
+
+        case b_xor:
+            Y = _mm_xor_si128(A, B);
+            break;
+
+        case rshift1:
+            // no SR instruction for 8bit data, we need to shift
+            // 16 bits and apply mask
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHR: [ 0 1 2 3 4 5 6 7 | 8 A B C D E F G]
+            // MSK: [ 0 1 2 3 4 5 6 7 | 0 A B C D E F G]
+            mask = _mm_set1_epi8(0x7F);
+            Y = _mm_srli_epi16(A, 1);
+            Y = _mm_and_si128(Y, mask);
+            break;
+
+        case rshift2:
+            // similar to rshift1
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHR: [ 0 0 1 2 3 4 5 6 | 7 8 A B C D E F]
+            // MSK: [ 0 0 1 2 3 4 5 6 | 0 0 A B C D E F]
+            mask = _mm_set1_epi8(0x3F);
+            Y = _mm_srli_epi16(A, 2);
+            Y = _mm_and_si128(Y, mask);
+            break;
+
+        case swap:
+            // SWAP(A, B) (((A & 0x0F) << 4) | ((B & 0x0F)))
+            // Shift A left by 4 bits
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // SHL: [ 5 6 7 8 A B C D | E F G H 0 0 0 0]
+            // MSK: [ 5 6 7 8 0 0 0 0 | E F G H 0 0 0 0]
+            mask = _mm_set1_epi8(0xF0);
+            TMP = _mm_slli_epi16(A, 4);
+            TMP = _mm_and_si128(TMP, mask);
+
+            // Mask B
+            // IN : [ 1 2 3 4 5 6 7 8 | A B C D E F G H]
+            // MSK: [ 0 0 0 0 5 6 7 8 | 0 0 0 0 E F G H]
+            mask = _mm_set1_epi8(0x0F);
+            Y = _mm_and_si128(B, mask);
+
+            // Combine
+            Y = _mm_or_si128(Y, TMP);
+            break;
+
+        case add:
+            Y = _mm_add_epi8(A, B);
+            break;
+
+        case add_sat:
+            Y = _mm_adds_epu8(A, B);
+            break;
+
+        case avg:
+            // shift right first, then add, to avoid overflow
+            mask = _mm_set1_epi8(0x7F);
+            TMP = _mm_srli_epi16(A, 1);
+            TMP = _mm_and_si128(TMP, mask);
+
+            Y = _mm_srli_epi16(B, 1);
+            Y = _mm_and_si128(Y, mask);
+
+            Y = _mm_add_epi8(Y, TMP);
+            break;
+
+        case max:
+            Y = _mm_max_epu8(A, B);
+            break;
+
+        case min:
+            Y = _mm_min_epu8(A, B);
+            break;
+
+        default:
+            abort();
+    }
+    return Y;
+}
+
+
+/**
+ * Calculate output of one node using SSE2 instructions, with results
+ * identical to scalar `cgp_get_node_output`. `cgp_eval_node_sse` computes
+ * average as (A >> 1) + (B >> 1), which differs when both inputs are odd.
+ * @param function
+ * @param A
+ * @param B
+ * @return
+ */
+static inline __m128i cgp_eval_node_exact_sse(cgp_func_t function, __m128i A, __m128i B)
+{
+    if (function == avg) {
+        // rounded up average, minus one where A + B is odd
+        __m128i odd = _mm_and_si128(_mm_xor_si128(A, B), _mm_set1_epi8(1));
+        return _mm_sub_epi8(_mm_avg_epu8(A, B), odd);
+    }
+    return cgp_eval_node_sse(function, A, B);
+}
@@ -0,0 +1,352 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "datacache.h"
+#include "../utils.h"
+
+
+#define DATACACHE_MAGIC "COCODATA"
+#define DATACACHE_VERSION 1
+
+// planes are aligned for SIMD loads
+#define DATACACHE_ALIGNMENT 64
+
+// FNV-1a
+#define DATACACHE_HASH_BASIS 14695981039346656037ULL
+#define DATACACHE_HASH_PRIME 1099511628211ULL
+
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t images_count;
+    uint64_t key;
+    uint64_t fitness_cases;
+    uint64_t original_offset; // file offset of original pixels
+    uint64_t file_size;
+} datacache_header_t;
+
+
+typedef struct {
+    int32_t width;
+    int32_t height;
+    int32_t comp;
+    int32_t reserved;
+    uint64_t offset; // index of first fitness case
+    uint64_t padded_offset; // file offset of padded noisy image
+} datacache_image_t;
+
+
+static inline uint64_t _datacache_align(uint64_t offset)
+{
+    return (offset + DATACACHE_ALIGNMENT - 1)
+        / DATACACHE_ALIGNMENT * DATACACHE_ALIGNMENT;
+}
+
+
+static inline uint64_t _datacache_hash(uint64_t hash, void const *data,
+    size_t length)
+{
+    unsigned char const *bytes = (unsigned char const*) data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * DATACACHE_HASH_PRIME;
+    }
+    return hash;
+}
+
+
+/**
+ * Returns cache file name
+ */
+static void _datacache_filename(char const *dir, uint64_t key,
+    char filename[MAX_FILENAME_LENGTH + 1])
+{
+    snprintf(filename, MAX_FILENAME_LENGTH + 1, "%s/%016llx.dataset",
+        dir, (unsigned long long) key);
+}
+
+
+/**
+ * Computes cache key of images
+ *
+ * @param  filenames Original and noisy image filenames
+ * @param  count
+ * @param  key
+ * @return Whether all files were read
+ */
+bool datacache_key(char const *filenames[], int count, uint64_t *key)
+{
+    uint32_t version = DATACACHE_VERSION;
+    uint32_t pixel_size = sizeof(img_pixel_t);
+    uint64_t hash = _datacache_hash(DATACACHE_HASH_BASIS, &version, sizeof(version));
+    hash = _datacache_hash(hash, &pixel_size, sizeof(pixel_size));
+    unsigned char buffer[65536];
+
+    for (int i = 0; i < count; i++) {
+        FILE *file = fopen(filenames[i], "rb");
+        if (file == NULL) {
+            return false;
+        }
+
+        uint64_t length = 0;
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            hash = _datacache_hash(hash, buffer, read);
+            length += read;
+        }
+        fclose(file);
+
+        // files are separated by their lengths
+        hash = _datacache_hash(hash, &length, sizeof(length));
+    }
+
+    *key = hash;
+    return true;
+}
+
+
+/**
+ * Checks that cache file header and image table are consistent
+ */
+static bool _datacache_valid(unsigned char *map, size_t size, uint64_t key)
+{
+    datacache_header_t *header = (datacache_header_t*) map;
+    if (size < sizeof(datacache_header_t)
+        || memcmp(header->magic, DATACACHE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != DATACACHE_VERSION
+        || header->key != key
+        || header->file_size != size
+        || header->images_count == 0
+        || sizeof(datacache_header_t) + header->images_count * sizeof(datacache_image_t) > size
+        || header->original_offset
+            + header->fitness_cases * sizeof(img_pixel_t) > size)
+    {
+        return false;
+    }
+
+    datacache_image_t *images = (datacache_image_t*) (header + 1);
+    uint64_t cases = 0;
+
+    for (uint32_t i = 0; i < header->images_count; i++) {
+        datacache_image_t *image = &images[i];
+        if (image->width <= 0 || image->height <= 0
+            || image->offset != cases
+            || image->padded_offset % DATACACHE_ALIGNMENT != 0
+            || image->padded_offset + img_padded_size(image->width, image->height) > size)
+        {
+            return false;
+        }
+        cases += (uint64_t) image->width * image->height;
+    }
+
+    return cases == header->fitness_cases;
+}
+
+
+/**
+ * Maps cached images into input data
+ *
+ * @param  data
+ * @param  dir Cache directory
+ * @param  key
+ * @return Whether valid cache file was found
+ */
+bool datacache_load(input_data_t *data, char const *dir, uint64_t key)
+{
+    char filename[MAX_FILENAME_LENGTH + 1];
+    _datacache_filename(dir, key, filename);
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    if (!_datacache_valid((unsigned char*) map, size, key)) {
+        fprintf(stderr, "Dataset cache %s is invalid, ignoring it.\n", filename);
+        munmap(map, size);
+        return false;
+    }
+
+    datacache_header_t *header = (datacache_header_t*) map;
+    datacache_image_t *images = (datacache_image_t*) (header + 1);
+
+    data->images = (input_image_t*) calloc(header->images_count, sizeof(input_image_t));
+    if (data->images == NULL) {
+        munmap(map, size);
+        return false;
+    }
+
+    data->mapping = map;
+    data->mapping_size = size;
+    data->fitness_cases = header->fitness_cases;
+    data->original = (img_pixel_t*) ((unsigned char*) map + header->original_offset);
+    data->images_count = header->images_count;
+
+    for (int i = 0; i < data->images_count; i++) {
+        input_image_t *image = &data->images[i];
+        image->offset = images[i].offset;
+        image->original.data = data->original + image->offset;
+        image->original.width = images[i].width;
+        image->original.height = images[i].height;
+        image->original.comp = images[i].comp;
+
+        image->noisy_padded = img_padded_view(
+            (img_pixel_t*) ((unsigned char*) map + images[i].padded_offset),
+            images[i].width, images[i].height);
+
+        if (image->noisy_padded == NULL) {
+            for (int j = 0; j < i; j++) {
+                img_padded_destroy(data->images[j].noisy_padded);
+            }
+            free(data->images);
+            data->images = NULL;
+            data->images_count = 0;
+            data->original = NULL;
+            datacache_release(data);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Writes zero bytes up to given file offset
+ */
+static bool _datacache_pad(FILE *file, uint64_t *position, uint64_t offset)
+{
+    static const unsigned char zeros[DATACACHE_ALIGNMENT] = { 0 };
+    size_t length = offset - *position;
+    *position = offset;
+    return fwrite(zeros, 1, length, file) == length;
+}
+
+
+/**
+ * Stores loaded images to cache. File is written under temporary name and
+ * renamed, so other processes never see it incomplete.
+ *
+ * @param  data
+ * @param  dir Cache directory
+ * @param  key
+ * @return Whether cache file was written
+ */
+bool datacache_save(input_data_t *data, char const *dir, uint64_t key)
+{
+    char filename[MAX_FILENAME_LENGTH + 1];
+    char tmp_filename[MAX_FILENAME_LENGTH + 32];
+    _datacache_filename(dir, key, filename);
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.%d.tmp", filename, (int) getpid());
+
+    if (create_dir(dir) != 0) {
+        return false;
+    }
+
+    // compute layout
+    datacache_header_t header;
+    datacache_image_t images[data->images_count];
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATACACHE_MAGIC, sizeof(header.magic));
+    header.version = DATACACHE_VERSION;
+    header.images_count = data->images_count;
+    header.key = key;
+    header.fitness_cases = data->fitness_cases;
+
+    uint64_t offset = sizeof(header) + sizeof(images);
+    header.original_offset = offset = _datacache_align(offset);
+    offset += data->fitness_cases * sizeof(img_pixel_t);
+
+    for (int i = 0; i < data->images_count; i++) {
+        input_image_t *image = &data->images[i];
+        memset(&images[i], 0, sizeof(datacache_image_t));
+        images[i].width = image->original.width;
+        images[i].height = image->original.height;
+        images[i].comp = image->original.comp;
+        images[i].offset = image->offset;
+        images[i].padded_offset = offset = _datacache_align(offset);
+        offset += img_padded_size(images[i].width, images[i].height);
+    }
+    header.file_size = offset;
+
+    // write
+    FILE *file = fopen(tmp_filename, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    uint64_t position = sizeof(header) + sizeof(images);
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(images, sizeof(images), 1, file) == 1
+        && _datacache_pad(file, &position, header.original_offset)
+        && fwrite(data->original, sizeof(img_pixel_t), data->fitness_cases, file) == data->fitness_cases;
+    position += data->fitness_cases * sizeof(img_pixel_t);
+
+    for (int i = 0; success && i < data->images_count; i++) {
+        size_t size = img_padded_size(images[i].width, images[i].height);
+        success = _datacache_pad(file, &position, images[i].padded_offset)
+            && fwrite(img_padded_memory(data->images[i].noisy_padded), 1, size, file) == size;
+        position += size;
+    }
+
+    success = (fclose(file) == 0) && success;
+    success = success && rename(tmp_filename, filename) == 0;
+
+    if (!success) {
+        remove(tmp_filename);
+    }
+    return success;
+}
+
+
+/**
+ * Unmaps cached images
+ *
+ * @param data
+ */
+void datacache_release(input_data_t *data)
+{
+    if (data->mapping != NULL) {
+        munmap(data->mapping, data->mapping_size);
+        data->mapping = NULL;
+    }
+}
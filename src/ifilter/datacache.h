@@ -0,0 +1,81 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../inputdata.h"
+
+
+/**
+ * Cache of decoded and padded input images
+ *
+ * Decoding big images takes most of the startup time of short runs. Images
+ * are stored in a binary file (original pixels of all images followed by
+ * padded noisy images) which is mapped read-only by later runs, so the
+ * processes running at once share it through the page cache.
+ *
+ * Cache file is named after hash of contents of all image files.
+ */
+
+
+/**
+ * Computes cache key of images
+ *
+ * @param  filenames Original and noisy image filenames
+ * @param  count
+ * @param  key
+ * @return Whether all files were read
+ */
+bool datacache_key(char const *filenames[], int count, uint64_t *key);
+
+
+/**
+ * Maps cached images into input data
+ *
+ * @param  data
+ * @param  dir Cache directory
+ * @param  key
+ * @return Whether valid cache file was found
+ */
+bool datacache_load(input_data_t *data, char const *dir, uint64_t key);
+
+
+/**
+ * Stores loaded images to cache. File is written under temporary name and
+ * renamed, so other processes never see it incomplete.
+ *
+ * @param  data
+ * @param  dir Cache directory
+ * @param  key
+ * @return Whether cache file was written
+ */
+bool datacache_save(input_data_t *data, char const *dir, uint64_t key);
+
+
+/**
+ * Unmaps cached images
+ *
+ * @param data
+ */
+void datacache_release(input_data_t *data);
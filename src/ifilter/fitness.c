@@ -18,32 +18,238 @@
  */
 
 
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
 #include "../cpu.h"
 #include "../random.h"
 #include "../fitness.h"
 #include "fitness.h"
 #include "inputdata.h"
+#include "nodecache.h"
+#include "cgp_jit.h"
 
 
 static double _psnr_coeficient;
+static nodecache_t _node_cache;
+static bool _use_jit;
+static double _selection_tolerance;
+static fitness_simd_data_t _image_data;
+
+// errors of circuits stored in CGP archive, one row of all fitness cases
+// per archive slot
+static fitness_error_t *_archive_errors;
 
 
 /* Private functions */
 
 
-bool _fitness_get_diff(ga_chr_t chr, img_window_t *w, int *diff);
+bool _fitness_get_diff(ga_chr_t chr, int index, int *diff);
 double _fitness_get_sqdiffsum_scalar(ga_chr_t chr);
-double _fitness_get_sqdiffsum_simd(ga_chr_t chr, img_pixel_t *original,
-    img_pixel_t *noisy[WINDOW_SIZE], int data_length);
+static fitness_simd_func_t _fitness_get_simd_func();
+static fitness_simd_plan_func_t _fitness_get_simd_plan_func();
+double _fitness_get_sqdiffsum_simd(ga_chr_t chr, fitness_simd_data_t *data);
+void _fitness_get_sqdiffsum_simd_batch(ga_chr_t *chrs, int n,
+    fitness_simd_data_t *data, double budget, double *sums, bool *aborted);
+void _fitness_get_sqdiffsum_cached_batch(ga_chr_t *chrs, int n,
+    ga_chr_t parent, double budget, double *sums, bool *aborted);
 double _fitness_predict_cgp_scalar(ga_chr_t cgp_chr, pred_genome_t predictor);
+static fitness_simd_errors_func_t _fitness_get_simd_errors_func();
+static inline bool _fitness_can_split_evaluation();
 
 static inline double fitness_psnr_coeficient(int pixels_count)
 {
-    return 255 * 255 * (double)pixels_count;
+    return (double) IMG_PIXEL_MAX * IMG_PIXEL_MAX * pixels_count;
+}
+
+
+/**
+ * Splits fitness cases into tiles of about `tile_size` cases. Tile holds
+ * either whole segments, or part of one segment starting at multiple of
+ * `tile_size` (so that SIMD blocks of different tiles never overlap).
+ *
+ * @param  data
+ * @param  tile_size
+ * @param  tiles Output, may be NULL to count tiles only
+ * @return Number of tiles
+ */
+static int _fitness_fill_tiles(fitness_simd_data_t *data, int tile_size,
+    fitness_tile_t *tiles)
+{
+    int count = 0;
+    int s = 0;
+
+    while (s < data->segments_count) {
+        int length = data->segments[s].length;
+
+        if (length >= tile_size) {
+            for (int offset = 0; offset < length; offset += tile_size) {
+                if (tiles) {
+                    tiles[count].segment = s;
+                    tiles[count].offset = offset;
+                    tiles[count].length = length - offset;
+                    if (tiles[count].length > tile_size) {
+                        tiles[count].length = tile_size;
+                    }
+                }
+                count++;
+            }
+            s++;
+
+        } else {
+            int first = s;
+            int cases = 0;
+            while (s < data->segments_count
+                && cases + data->segments[s].length <= tile_size)
+            {
+                cases += data->segments[s].length;
+                s++;
+            }
+            if (tiles) {
+                tiles[count].segment = first;
+                tiles[count].offset = 0;
+                tiles[count].length = cases;
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+/**
+ * Allocates tiles for batch and parallel evaluation
+ *
+ * @param  data
+ * @return Whether memory was allocated
+ */
+static bool _fitness_alloc_tiles(fitness_simd_data_t *data)
+{
+    data->batch_tiles_count = _fitness_fill_tiles(data, FITNESS_BATCH_TILE, NULL);
+    data->parallel_tiles_count = _fitness_fill_tiles(data, FITNESS_PARALLEL_TILE, NULL);
+
+    data->batch_tiles = (fitness_tile_t*) malloc(
+        sizeof(fitness_tile_t) * (data->batch_tiles_count + 1));
+    data->parallel_tiles = (fitness_tile_t*) malloc(
+        sizeof(fitness_tile_t) * (data->parallel_tiles_count + 1));
+
+    if (data->batch_tiles == NULL || data->parallel_tiles == NULL) {
+        return false;
+    }
+
+    _fitness_fill_tiles(data, FITNESS_BATCH_TILE, data->batch_tiles);
+    _fitness_fill_tiles(data, FITNESS_PARALLEL_TILE, data->parallel_tiles);
+    return true;
+}
+
+
+/**
+ * Frees tiles allocated by `_fitness_alloc_tiles`
+ *
+ * @param  data
+ */
+static void _fitness_free_tiles(fitness_simd_data_t *data)
+{
+    free(data->batch_tiles);
+    free(data->parallel_tiles);
+    data->batch_tiles = NULL;
+    data->parallel_tiles = NULL;
+}
+
+
+/**
+ * Prepares fitness cases of all images for SIMD kernels, one segment per
+ * image row. Window inputs are read from padded noisy image at fixed
+ * offsets.
+ *
+ * @param  input
+ * @param  data
+ * @return Whether memory was allocated
+ */
+static bool _fitness_image_simd_data(input_data_t *input,
+    fitness_simd_data_t *data)
+{
+    int rows = 0;
+    for (int i = 0; i < input->images_count; i++) {
+        rows += input->images[i].original.height;
+    }
+
+    data->segments_count = rows;
+    data->cases = input->fitness_cases;
+    data->segments = (fitness_segment_t*) malloc(sizeof(fitness_segment_t) * rows);
+    if (data->segments == NULL) {
+        return false;
+    }
+
+    fitness_segment_t *segment = data->segments;
+    size_t cache_offset = 0;
+
+    for (int i = 0; i < input->images_count; i++) {
+        input_image_t *image = &input->images[i];
+        img_padded_t noisy = image->noisy_padded;
+        int width = image->original.width;
+
+        for (int y = 0; y < image->original.height; y++, segment++) {
+            img_pixel_t *centre = img_padded_pixel(noisy, 0, y);
+
+            segment->start = image->offset + y * width;
+            segment->length = width;
+            segment->original = input->original + segment->start;
+            for (int k = 0; k < WINDOW_SIZE; k++) {
+                segment->inputs[k] = centre + noisy->offsets[k];
+            }
+            segment->cache_offset = cache_offset;
+            cache_offset += nodecache_segment_size(width);
+        }
+    }
+
+    return _fitness_alloc_tiles(data);
+}
+
+
+/**
+ * Prepares fitness cases of predictor for SIMD kernels
+ *
+ * @param  predictor
+ * @param  segment Storage for the only segment
+ * @param  data
+ * @return Whether memory was allocated
+ */
+static bool _fitness_predictor_simd_data(pred_genome_t predictor,
+    fitness_segment_t *segment, fitness_simd_data_t *data)
+{
+    segment->original = predictor->output_simd;
+    for (int i = 0; i < WINDOW_SIZE; i++) {
+        segment->inputs[i] = predictor->inputs_simd[i];
+    }
+    segment->start = 0;
+    segment->length = predictor->used_pixels;
+    segment->cache_offset = 0;
+
+    data->segments_count = 1;
+    data->segments = segment;
+    data->cases = predictor->used_pixels;
+    return _fitness_alloc_tiles(data);
+}
+
+
+/**
+ * Returns errors of circuit stored in archive slot
+ *
+ * @param  slot
+ * @return Row of all fitness cases
+ */
+static inline fitness_error_t *_fitness_archive_errors(int slot)
+{
+    return _archive_errors + (size_t) slot * fitness_input_data->fitness_cases;
 }
 
 
@@ -61,6 +267,63 @@ void _fitness_init(config_t *config, input_data_t *input,
     archive_t cgp_archive, archive_t pred_archive)
 {
     _psnr_coeficient = fitness_psnr_coeficient(input->fitness_cases);
+
+    // new parent is selected from chromosomes better or same as the current
+    // best one, with FITNESS_EPSILON tolerance - which can add up over the
+    // whole population
+    _selection_tolerance = (config->cgp_population_size + 1) * FITNESS_EPSILON;
+
+    _use_jit = config->cgp_jit && cgp_jit_supported();
+
+    if (!_fitness_image_simd_data(input, &_image_data)) {
+        fprintf(stderr, "Failed to allocate memory for fitness cases.\n");
+        exit(1);
+    }
+
+    _node_cache = NULL;
+    // compiled circuits are faster than incremental evaluation
+    if (config->cgp_node_cache > 0 && can_use_simd() && !_use_jit) {
+        fitness_segment_t *last = &_image_data.segments[_image_data.segments_count - 1];
+        size_t plane_size = last->cache_offset + nodecache_segment_size(last->length);
+        size_t limit = (size_t) config->cgp_node_cache * 1024 * 1024;
+        _node_cache = nodecache_create(plane_size, limit);
+
+        if (_node_cache == NULL) {
+            size_t needed = nodecache_memory_size(plane_size);
+            fprintf(stderr, "Node cache needs %zu MiB, it is disabled.\n",
+                (needed + 1024 * 1024 - 1) / (1024 * 1024));
+        }
+    }
+
+    _archive_errors = NULL;
+    if (cgp_archive != NULL) {
+        // padded by one error, AVX2 gathers may read past the last case
+        _archive_errors = (fitness_error_t*) malloc(sizeof(fitness_error_t)
+            * ((size_t) cgp_archive->capacity * input->fitness_cases + 1));
+        if (_archive_errors == NULL) {
+            fprintf(stderr, "Failed to allocate memory for archive errors.\n");
+            exit(1);
+        }
+    }
+}
+
+
+/**
+ * Deinitializes fitness module internals
+ */
+void _fitness_deinit()
+{
+    nodecache_destroy(_node_cache);
+    _node_cache = NULL;
+
+    _fitness_free_tiles(&_image_data);
+    free(_image_data.segments);
+    _image_data.segments = NULL;
+
+    free(_archive_errors);
+    _archive_errors = NULL;
+
+    fitness_jit_deinit();
 }
 
 
@@ -75,8 +338,7 @@ ga_fitness_t fitness_eval_cgp(ga_chr_t chr)
     double sum = 0;
 
     if(can_use_simd()) {
-        sum = _fitness_get_sqdiffsum_simd(chr, fitness_input_data->img_original->data,
-            fitness_input_data->img_noisy_simd, fitness_input_data->fitness_cases);
+        sum = _fitness_get_sqdiffsum_simd(chr, &_image_data);
 
     } else {
         sum = _fitness_get_sqdiffsum_scalar(chr);
@@ -86,6 +348,117 @@ ga_fitness_t fitness_eval_cgp(ga_chr_t chr)
 }
 
 
+/**
+ * Evaluates CGP circuit fitness on single image of training set
+ *
+ * @param  chr
+ * @param  image Image index
+ * @return fitness value
+ */
+ga_fitness_t fitness_eval_cgp_image(ga_chr_t chr, int image)
+{
+    input_image_t *img = &fitness_input_data->images[image];
+    int cases = img->original.width * img->original.height;
+    double sum = 0;
+
+    if (can_use_simd()) {
+        fitness_simd_func_t func = _fitness_get_simd_func();
+        int first = 0;
+        for (int i = 0; i < image; i++) {
+            first += fitness_input_data->images[i].original.height;
+        }
+
+        for (int y = 0; y < img->original.height; y++) {
+            fitness_segment_t *segment = &_image_data.segments[first + y];
+            sum += func(segment->original, segment->inputs, chr,
+                0, segment->length);
+        }
+
+    } else {
+        for (int i = img->offset; i < img->offset + cases; i++) {
+            int diff;
+            if (_fitness_get_diff(chr, i, &diff)) {
+                i = img->offset - 1;
+                sum = 0;
+                continue;
+            }
+            sum += fitness_sqdiff(diff);
+        }
+    }
+
+    fitness_count_cgp_evals(cases, 0, 0);
+    return fitness_psnr_coeficient(cases) / sum;
+}
+
+
+/**
+ * Returns squared differences sum, above which circuit cannot be selected
+ * as new parent (its fitness would be worse than parent's)
+ *
+ * @param  chrs Circuits to evaluate
+ * @param  n
+ * @param  parent
+ * @param  coef PSNR coefficient used for evaluated circuits
+ * @return Budget or INFINITY if evaluation must not be stopped early
+ */
+static double _fitness_sum_budget(ga_chr_t *chrs, int n, ga_chr_t parent,
+    double coef)
+{
+    if (parent == NULL || !parent->has_fitness) {
+        return INFINITY;
+    }
+
+    // parent is being re-evaluated, its fitness is not valid anymore
+    for (int i = 0; i < n; i++) {
+        if (chrs[i] == parent) return INFINITY;
+    }
+
+    double bound = parent->fitness - _selection_tolerance;
+    if (bound <= 0) {
+        return INFINITY;
+    }
+    return coef / bound;
+}
+
+
+/**
+ * Evaluates fitness of multiple CGP circuits at once
+ *
+ * @param  chrs
+ * @param  n
+ * @param  parent If node cache is enabled, offspring are evaluated
+ *                incrementally against this circuit
+ */
+void fitness_eval_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t parent)
+{
+    if (!can_use_simd()) {
+        #pragma omp parallel for
+        for (int i = 0; i < n; i++) {
+            chrs[i]->fitness = fitness_eval_cgp(chrs[i]);
+        }
+        return;
+    }
+
+    double sums[n];
+    bool aborted[n];
+    double budget = _fitness_sum_budget(chrs, n, parent, _psnr_coeficient);
+
+    if (_node_cache != NULL && parent != NULL) {
+        _fitness_get_sqdiffsum_cached_batch(chrs, n, parent, budget, sums,
+            aborted);
+
+    } else {
+        _fitness_get_sqdiffsum_simd_batch(chrs, n, &_image_data, budget, sums,
+            aborted);
+    }
+
+    for (int i = 0; i < n; i++) {
+        chrs[i]->fitness = aborted[i] ? FITNESS_ABORTED
+                                      : _psnr_coeficient / sums[i];
+    }
+}
+
+
 /**
  * Predictes CGP circuit fitness
  *
@@ -102,8 +475,14 @@ ga_fitness_t fitness_predict_cgp(ga_chr_t cgp_chr, ga_chr_t pred_chr)
     double sum = 0;
 
     if (can_use_simd()) {
-        sum = _fitness_get_sqdiffsum_simd(cgp_chr, predictor->output_simd,
-            predictor->inputs_simd, predictor->used_pixels);
+        fitness_segment_t segment;
+        fitness_simd_data_t data;
+        if (!_fitness_predictor_simd_data(predictor, &segment, &data)) {
+            fprintf(stderr, "Failed to allocate memory for fitness cases.\n");
+            exit(1);
+        }
+        sum = _fitness_get_sqdiffsum_simd(cgp_chr, &data);
+        _fitness_free_tiles(&data);
 
     } else {
         sum = _fitness_predict_cgp_scalar(cgp_chr, predictor);
@@ -113,10 +492,160 @@ ga_fitness_t fitness_predict_cgp(ga_chr_t cgp_chr, ga_chr_t pred_chr)
 }
 
 
+/**
+ * Predicts fitness of multiple CGP circuits at once
+ *
+ * @param  chrs
+ * @param  n
+ * @param  pred_chr
+ * @param  parent Evaluation of circuits worse than this one is stopped early
+ */
+void fitness_predict_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t pred_chr,
+    ga_chr_t parent)
+{
+    if (!can_use_simd()) {
+        #pragma omp parallel for
+        for (int i = 0; i < n; i++) {
+            chrs[i]->fitness = fitness_predict_cgp(chrs[i], pred_chr);
+        }
+        return;
+    }
+
+    pred_genome_t predictor = (pred_genome_t) pred_chr->genome;
+    double coef = fitness_psnr_coeficient(predictor->used_pixels);
+    double budget = _fitness_sum_budget(chrs, n, parent, coef);
+
+    fitness_segment_t segment;
+    fitness_simd_data_t data;
+    if (!_fitness_predictor_simd_data(predictor, &segment, &data)) {
+        fprintf(stderr, "Failed to allocate memory for fitness cases.\n");
+        exit(1);
+    }
+
+    double sums[n];
+    bool aborted[n];
+    _fitness_get_sqdiffsum_simd_batch(chrs, n, &data, budget, sums, aborted);
+    _fitness_free_tiles(&data);
+
+    for (int i = 0; i < n; i++) {
+        chrs[i]->fitness = aborted[i] ? FITNESS_ABORTED : coef / sums[i];
+    }
+}
+
+
+/**
+ * Evaluates CGP circuit stored in archive slot and keeps its error (squared
+ * difference) in each fitness case. Rows are split among threads if there
+ * are free ones.
+ *
+ * @param  chr
+ * @param  slot
+ * @return fitness value
+ */
+ga_fitness_t _fitness_eval_archived_cgp(ga_chr_t chr, int slot)
+{
+    fitness_error_t *errors = _fitness_archive_errors(slot);
+    int cases = fitness_input_data->fitness_cases;
+    uint64_t sum = 0;
+
+    if (can_use_simd()) {
+        fitness_simd_errors_func_t func = _fitness_get_simd_errors_func();
+
+        #pragma omp parallel for reduction(+:sum) schedule(static) \
+            if (_fitness_can_split_evaluation())
+        for (int s = 0; s < _image_data.segments_count; s++) {
+            fitness_segment_t *segment = &_image_data.segments[s];
+            fitness_error_t *segment_errors = errors + segment->start;
+            func(segment->original, segment->inputs, chr, 0, segment->length,
+                segment_errors);
+
+            for (int i = 0; i < segment->length; i++) {
+                sum += segment_errors[i];
+            }
+        }
+
+    } else {
+        for (int i = 0; i < cases; i++) {
+            int diff;
+            if (_fitness_get_diff(chr, i, &diff)) {
+                i = -1;
+                sum = 0;
+                continue;
+            }
+            errors[i] = fitness_sqdiff(diff);
+            sum += errors[i];
+        }
+    }
+
+    fitness_count_cgp_evals(cases, 0, 0);
+    return _psnr_coeficient / sum;
+}
+
+
+/**
+ * Predicts fitness of CGP circuit stored in archive slot from its errors,
+ * only cases selected by predictor are summed
+ *
+ * @param  slot
+ * @param  predictor
+ * @return fitness value
+ */
+ga_fitness_t _fitness_predict_archived_cgp(int slot, pred_genome_t predictor)
+{
+    fitness_error_t *errors = _fitness_archive_errors(slot);
+    uint64_t sum;
+
+    #ifdef AVX2
+        if (can_use_intel_core_4th_gen_features()) {
+            // phenotype is sorted, so gathers read errors in memory order
+            sum = _fitness_sum_errors_avx(errors, predictor->pixels,
+                predictor->used_pixels);
+            return _fitness_predict_cgp_by_errors(sum, predictor->used_pixels);
+        }
+    #endif
+
+    sum = fitness_sum_errors(errors, predictor->pixels, predictor->used_pixels);
+    return _fitness_predict_cgp_by_errors(sum, predictor->used_pixels);
+}
+
+
+/**
+ * Copies errors of CGP circuit stored in archive slot in given fitness
+ * cases
+ *
+ * @param  slot
+ * @param  cases
+ * @param  count
+ * @param  errors
+ */
+void _fitness_get_archived_cgp_errors(int slot, pred_gene_t *cases, int count,
+    uint64_t *errors)
+{
+    fitness_error_t *row = _fitness_archive_errors(slot);
+    for (int i = 0; i < count; i++) {
+        errors[i] = row[cases[i]];
+    }
+}
 
 
 /**
- * Fills simd-friendly predictor arrays with correct image data
+ * Predicts CGP circuit fitness from sum of its errors in used fitness cases
+ *
+ * @param  sum
+ * @param  used_pixels
+ * @return fitness value
+ */
+ga_fitness_t _fitness_predict_cgp_by_errors(uint64_t sum, int used_pixels)
+{
+    // PSNR coefficcient is different here (less pixels are used)
+    double coef = fitness_psnr_coeficient(used_pixels);
+    return coef / sum;
+}
+
+
+/**
+ * Fills simd-friendly predictor arrays with correct image data, positions
+ * already holding the right pixel are skipped
  * @param  genome
  */
 void fitness_prepare_predictor_for_simd(pred_genome_t predictor)
@@ -124,11 +653,19 @@ void fitness_prepare_predictor_for_simd(pred_genome_t predictor)
     for (int i = 0; i < predictor->used_pixels; i++) {
         pred_gene_t index = predictor->pixels[i];
         assert(index < fitness_input_data->fitness_cases);
+        if (predictor->simd_pixels[i] == index) {
+            continue;
+        }
 
-        predictor->output_simd[i] = fitness_input_data->img_original->data[index];
+        input_image_t *image;
+        img_pixel_t *centre = input_data_noisy_pixel(fitness_input_data,
+            index, &image);
+
+        predictor->output_simd[i] = fitness_input_data->original[index];
         for (int w = 0; w < WINDOW_SIZE; w++) {
-            predictor->inputs_simd[w][i] = fitness_input_data->img_noisy_simd[w][index];
+            predictor->inputs_simd[w][i] = centre[image->noisy_padded->offsets[w]];
         }
+        predictor->simd_pixels[i] = index;
     }
 }
 
@@ -140,16 +677,24 @@ void fitness_prepare_predictor_for_simd(pred_genome_t predictor)
  * Calculates difference between original and filtered pixel
  *
  * @param  chr
- * @param  w
+ * @param  index Pixel index
  * @param  diff
  * @return Whether CGP function has changed and evaluation should be restarted
  */
-bool _fitness_get_diff(ga_chr_t chr, img_window_t *w, int *diff)
+bool _fitness_get_diff(ga_chr_t chr, int index, int *diff)
 {
-    cgp_value_t *inputs = w->pixels;
+    input_image_t *image;
+    img_pixel_t *centre = input_data_noisy_pixel(fitness_input_data,
+        index, &image);
+
+    cgp_value_t inputs[WINDOW_SIZE];
+    for (int k = 0; k < WINDOW_SIZE; k++) {
+        inputs[k] = centre[image->noisy_padded->offsets[k]];
+    }
+
     cgp_value_t output_pixel;
     bool should_restart = cgp_get_output(chr, inputs, &output_pixel);
-    *diff = output_pixel - img_get_pixel(fitness_input_data->img_original, w->pos_x, w->pos_y);
+    *diff = output_pixel - fitness_input_data->original[index];
     return should_restart;
 }
 
@@ -159,69 +704,423 @@ double _fitness_get_sqdiffsum_scalar(ga_chr_t chr)
     double sum = 0;
     int diff;
     for (int i = 0; i < fitness_input_data->fitness_cases; i++) {
-        img_window_t *w = &fitness_input_data->img_noisy_windows->windows[i];
-        bool should_restart = _fitness_get_diff(chr, w, &diff);
+        bool should_restart = _fitness_get_diff(chr, i, &diff);
         if (should_restart) {
             i = 0;
             continue;
         }
-        sum += diff * diff;
+        sum += fitness_sqdiff(diff);
     }
-    #pragma omp atomic
-        fitness_cgp_evals += fitness_input_data->fitness_cases;
+    fitness_count_cgp_evals(fitness_input_data->fitness_cases, 0, 0);
     return sum;
 }
 
 
-double _fitness_get_sqdiffsum_simd(ga_chr_t chr, img_pixel_t *original, img_pixel_t *noisy[WINDOW_SIZE], int data_length)
+/**
+ * Returns best SIMD fitness kernel supported by CPU
+ */
+static fitness_simd_func_t _fitness_get_simd_func()
 {
-    #ifdef SYMREG
-        return 0;
+    fitness_simd_func_t func = NULL;
+
+    #ifdef SSE2
+        if(can_use_sse2()) {
+            func = _use_jit ? _fitness_get_sqdiffsum_jit_sse
+                            : _fitness_get_sqdiffsum_sse;
+        }
     #endif
 
-    fitness_simd_func_t func = NULL;
-    int block_size = 0;
-    double sum = 0;
+    #ifdef AVX2
+        if(can_use_intel_core_4th_gen_features()) {
+            func = _use_jit ? _fitness_get_sqdiffsum_jit_avx
+                            : _fitness_get_sqdiffsum_avx;
+        }
+    #endif
+
+    #ifdef AVX512
+        // code generator does not emit AVX-512 yet
+        if(can_use_avx512bw() && !_use_jit) {
+            func = _fitness_get_sqdiffsum_avx512;
+        }
+    #endif
+
+    assert(func != NULL);
+    return func;
+}
+
+
+/**
+ * Returns best SIMD incremental fitness kernel supported by CPU
+ */
+static fitness_simd_plan_func_t _fitness_get_simd_plan_func()
+{
+    fitness_simd_plan_func_t func = NULL;
+
+    #ifdef SSE2
+        if(can_use_sse2()) {
+            func = _fitness_get_sqdiffsum_plan_sse;
+        }
+    #endif
+
+    #ifdef AVX2
+        if(can_use_intel_core_4th_gen_features()) {
+            func = _fitness_get_sqdiffsum_plan_avx;
+        }
+    #endif
+
+    #ifdef AVX512
+        if(can_use_avx512bw()) {
+            func = _fitness_get_sqdiffsum_plan_avx512;
+        }
+    #endif
+
+    assert(func != NULL);
+    return func;
+}
+
+
+/**
+ * Returns best SIMD kernel storing errors of single fitness cases
+ */
+static fitness_simd_errors_func_t _fitness_get_simd_errors_func()
+{
+    fitness_simd_errors_func_t func = NULL;
 
     #ifdef SSE2
         if(can_use_sse2()) {
-            func = _fitness_get_sqdiffsum_sse;
-            block_size = FITNESS_SSE2_STEP;
+            func = _fitness_get_errors_sse;
         }
     #endif
 
     #ifdef AVX2
         if(can_use_intel_core_4th_gen_features()) {
-            func = _fitness_get_sqdiffsum_avx;
-            block_size = FITNESS_AVX2_STEP;
+            func = _fitness_get_errors_avx;
+        }
+    #endif
+
+    #ifdef AVX512
+        if(can_use_avx512bw()) {
+            func = _fitness_get_errors_avx512;
         }
     #endif
 
     assert(func != NULL);
+    return func;
+}
+
 
-    int offset = 0;
-    int unaligned_bytes = data_length % block_size;
-    data_length -= unaligned_bytes;
+/**
+ * Calculates squared differences sum over tile of fitness cases, kernel
+ * is called for each segment separately
+ */
+static double _fitness_get_sqdiffsum_tile(fitness_simd_func_t func,
+    ga_chr_t chr, fitness_simd_data_t *data, fitness_tile_t *tile)
+{
+    fitness_segment_t *segment = &data->segments[tile->segment];
+    int offset = tile->offset;
+    int remaining = tile->length;
+    double sum = 0;
 
-    for (; offset < data_length; offset += block_size) {
-        sum += func(original, noisy, chr, offset, block_size);
-        #pragma omp atomic
-            fitness_cgp_evals += block_size;
+    while (remaining > 0) {
+        int count = segment->length - offset;
+        if (count > remaining) count = remaining;
+        sum += func(segment->original, segment->inputs, chr, offset, count);
+        remaining -= count;
+        offset = 0;
+        segment++;
     }
 
-    // fix image data not fitting into register
-    // offset is set correctly here - it points to first pixel after
-    // aligned data (we subtracted no. unaligned bytes before)
-    if (unaligned_bytes > 0) {
-        sum += func(original, noisy, chr, offset, unaligned_bytes);
-        #pragma omp atomic
-            fitness_cgp_evals += unaligned_bytes;
+    return sum;
+}
+
+
+/**
+ * Calculates squared differences sum over tile of fitness cases according
+ * to plan, kernel is called for each segment separately
+ */
+static double _fitness_get_sqdiffsum_plan_tile(fitness_simd_plan_func_t func,
+    nodecache_t cache, nodecache_plan_t *plan, bool store,
+    fitness_simd_data_t *data, fitness_tile_t *tile)
+{
+    fitness_segment_t *segment = &data->segments[tile->segment];
+    int offset = tile->offset;
+    int remaining = tile->length;
+    double sum = 0;
+
+    while (remaining > 0) {
+        int count = segment->length - offset;
+        if (count > remaining) count = remaining;
+
+        img_pixel_t *planes[NODECACHE_SLOTS];
+        nodecache_segment_planes(cache, segment->inputs, segment->cache_offset,
+            planes);
+
+        sum += func(segment->original, planes, plan, store, offset, count);
+        remaining -= count;
+        offset = 0;
+        segment++;
     }
 
     return sum;
 }
 
 
+/**
+ * Returns whether single circuit evaluation should be split among threads
+ */
+static inline bool _fitness_can_split_evaluation()
+{
+    #ifdef _OPENMP
+        // inside parallel region circuits are already evaluated in parallel
+        return !omp_in_parallel() && omp_get_max_threads() > 1;
+    #else
+        return false;
+    #endif
+}
+
+
+/**
+ * Calculates squared differences sum of single circuit
+ *
+ * If there are free threads, image is split into tiles of about
+ * FITNESS_PARALLEL_TILE pixels evaluated in parallel. Tile sums are
+ * added in fixed order, so the result does not depend on number of
+ * threads.
+ *
+ * @param  chr
+ * @param  data
+ * @return Squared differences sum
+ */
+double _fitness_get_sqdiffsum_simd(ga_chr_t chr, fitness_simd_data_t *data)
+{
+    #ifdef SYMREG
+        return 0;
+    #endif
+
+    fitness_simd_func_t func = _fitness_get_simd_func();
+    int tiles = data->parallel_tiles_count;
+    double sum = 0;
+
+    if (tiles < 2 || !_fitness_can_split_evaluation()) {
+        for (int s = 0; s < data->segments_count; s++) {
+            fitness_segment_t *segment = &data->segments[s];
+            sum += func(segment->original, segment->inputs, chr,
+                0, segment->length);
+        }
+
+    } else {
+        double *tile_sums = (double*) malloc(sizeof(double) * tiles);
+
+        #pragma omp parallel for schedule(static)
+        for (int t = 0; t < tiles; t++) {
+            tile_sums[t] = _fitness_get_sqdiffsum_tile(func, chr, data,
+                &data->parallel_tiles[t]);
+        }
+
+        for (int t = 0; t < tiles; t++) {
+            sum += tile_sums[t];
+        }
+        free(tile_sums);
+    }
+
+    fitness_count_cgp_evals(data->cases, 0, 0);
+    return sum;
+}
+
+
+/**
+ * Returns number of circuits which were stopped early
+ *
+ * @param n number of circuits
+ * @param aborted Which circuits were stopped early
+ */
+static long _fitness_count_aborted(int n, bool *aborted)
+{
+    long aborted_count = 0;
+    for (int i = 0; i < n; i++) {
+        if (aborted[i]) aborted_count++;
+    }
+    return aborted_count;
+}
+
+
+/**
+ * Calculates squared differences of multiple circuits at once
+ *
+ * Image is split into tiles of about FITNESS_BATCH_TILE pixels which are
+ * distributed among threads. Each tile is loaded from memory once and
+ * all circuits are evaluated over it while it stays in cache.
+ *
+ * Once the sum of a circuit exceeds budget, the remaining tiles are
+ * skipped for it. Each thread checks its own partial sum only, which
+ * is never greater than the total.
+ *
+ * @param chrs
+ * @param n number of circuits
+ * @param data
+ * @param budget Sum above which circuit evaluation may be stopped
+ * @param sums Output, squared differences sum for each circuit (only
+ *             partial if it exceeded budget)
+ * @param aborted Output, whether circuit evaluation was stopped early
+ */
+void _fitness_get_sqdiffsum_simd_batch(ga_chr_t *chrs, int n,
+    fitness_simd_data_t *data, double budget, double *sums, bool *aborted)
+{
+    fitness_simd_func_t func = _fitness_get_simd_func();
+    int tiles = data->batch_tiles_count;
+
+    for (int i = 0; i < n; i++) {
+        sums[i] = 0;
+        aborted[i] = false;
+    }
+
+    #pragma omp parallel
+    {
+        // partial sums are integers, order of addition does not matter
+        double partial[n];
+        long thread_evaluated = 0;
+        long thread_skipped = 0;
+        for (int i = 0; i < n; i++) {
+            partial[i] = 0;
+        }
+
+        #pragma omp for schedule(static)
+        for (int t = 0; t < tiles; t++) {
+            fitness_tile_t *tile = &data->batch_tiles[t];
+            int length = tile->length;
+
+            for (int i = 0; i < n; i++) {
+                bool stop;
+                #pragma omp atomic read
+                    stop = aborted[i];
+                if (stop) {
+                    thread_skipped += length;
+                    continue;
+                }
+
+                partial[i] += _fitness_get_sqdiffsum_tile(func, chrs[i],
+                    data, tile);
+                thread_evaluated += length;
+
+                if (partial[i] > budget) {
+                    #pragma omp atomic write
+                        aborted[i] = true;
+                }
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            #pragma omp atomic
+                sums[i] += partial[i];
+        }
+        fitness_count_cgp_evals(thread_evaluated, 0, thread_skipped);
+    }
+
+    fitness_count_cgp_evals(0, _fitness_count_aborted(n, aborted), 0);
+}
+
+
+/**
+ * Calculates squared differences of multiple circuits at once, using
+ * cached node outputs of their parent
+ *
+ * If parent differs from cached circuit, its changed nodes are computed
+ * and stored first. Then only nodes changed by mutation are computed for
+ * each circuit, the rest is loaded from cache. Image is processed in
+ * tiles and stopped early the same way as in
+ * `_fitness_get_sqdiffsum_simd_batch`.
+ *
+ * @param chrs
+ * @param n number of circuits
+ * @param parent
+ * @param budget Sum above which circuit evaluation may be stopped
+ * @param sums Output, squared differences sum for each circuit (only
+ *             partial if it exceeded budget)
+ * @param aborted Output, whether circuit evaluation was stopped early
+ */
+void _fitness_get_sqdiffsum_cached_batch(ga_chr_t *chrs, int n,
+    ga_chr_t parent, double budget, double *sums, bool *aborted)
+{
+    fitness_simd_plan_func_t func = _fitness_get_simd_plan_func();
+    nodecache_t cache = _node_cache;
+    fitness_simd_data_t *data = &_image_data;
+    int tiles = data->batch_tiles_count;
+
+    // bring cache up to date with parent
+    cgp_genome_t parent_genome = (cgp_genome_t) parent->genome;
+    nodecache_plan_t parent_plan;
+    nodecache_plan(cache, parent_genome, &parent_plan);
+
+    if (parent_plan.program_length > 0) {
+        #pragma omp parallel for schedule(static)
+        for (int t = 0; t < tiles; t++) {
+            _fitness_get_sqdiffsum_plan_tile(func, cache, &parent_plan, true,
+                data, &data->batch_tiles[t]);
+        }
+    }
+    if (parent_plan.program_length > 0 || !cache->valid) {
+        nodecache_commit(cache, parent_genome);
+    }
+
+    nodecache_plan_t *plans = (nodecache_plan_t*) malloc(
+        sizeof(nodecache_plan_t) * n);
+    for (int i = 0; i < n; i++) {
+        nodecache_plan(cache, (cgp_genome_t) chrs[i]->genome, &plans[i]);
+    }
+
+    for (int i = 0; i < n; i++) {
+        sums[i] = 0;
+        aborted[i] = false;
+    }
+
+    #pragma omp parallel
+    {
+        // partial sums are integers, order of addition does not matter
+        double partial[n];
+        long thread_evaluated = 0;
+        long thread_skipped = 0;
+        for (int i = 0; i < n; i++) {
+            partial[i] = 0;
+        }
+
+        #pragma omp for schedule(static)
+        for (int t = 0; t < tiles; t++) {
+            fitness_tile_t *tile = &data->batch_tiles[t];
+            int length = tile->length;
+
+            for (int i = 0; i < n; i++) {
+                bool stop;
+                #pragma omp atomic read
+                    stop = aborted[i];
+                if (stop) {
+                    thread_skipped += length;
+                    continue;
+                }
+
+                partial[i] += _fitness_get_sqdiffsum_plan_tile(func, cache,
+                    &plans[i], false, data, tile);
+                thread_evaluated += length;
+
+                if (partial[i] > budget) {
+                    #pragma omp atomic write
+                        aborted[i] = true;
+                }
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            #pragma omp atomic
+                sums[i] += partial[i];
+        }
+        fitness_count_cgp_evals(thread_evaluated, 0, thread_skipped);
+    }
+
+    free(plans);
+
+    fitness_count_cgp_evals(0, _fitness_count_aborted(n, aborted), 0);
+}
+
+
 double _fitness_predict_cgp_scalar(ga_chr_t cgp_chr, pred_genome_t predictor)
 {
     double sum = 0;
@@ -231,18 +1130,16 @@ double _fitness_predict_cgp_scalar(ga_chr_t cgp_chr, pred_genome_t predictor)
         // fetch window specified by predictor
         pred_gene_t index = predictor->pixels[i];
         assert(index < fitness_input_data->fitness_cases);
-        img_window_t *w = &fitness_input_data->img_noisy_windows->windows[index];
 
-        bool should_restart = _fitness_get_diff(cgp_chr, w, &diff);
+        bool should_restart = _fitness_get_diff(cgp_chr, index, &diff);
         if (should_restart) {
             i = 0;
             continue;
         }
-        sum += diff * diff;
+        sum += fitness_sqdiff(diff);
     }
 
-    #pragma omp atomic
-        fitness_cgp_evals += predictor->used_pixels;
+    fitness_count_cgp_evals(predictor->used_pixels, 0, 0);
 
     return sum;
 }
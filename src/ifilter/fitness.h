@@ -23,6 +23,57 @@
 
 #include "../ga.h"
 #include "image.h"
+#include "nodecache.h"
+
+
+/**
+ * Squared difference of filtered and original pixel in one fitness case
+ */
+#ifdef PIXEL16
+    typedef uint32_t fitness_error_t;
+#else
+    typedef uint16_t fitness_error_t;
+#endif
+
+
+/**
+ * Row of fitness cases. Inputs of consecutive cases are consecutive in
+ * memory, so SIMD kernels are called for each segment separately.
+ */
+typedef struct {
+    img_pixel_t *original; // first case of segment
+    img_pixel_t *inputs[WINDOW_SIZE]; // first case of segment
+    int start; // index of first fitness case
+    int length;
+    size_t cache_offset; // segment position in node cache planes
+} fitness_segment_t;
+
+
+/**
+ * Part of fitness cases evaluated at once - either several whole
+ * segments, or part of one segment
+ */
+typedef struct {
+    int segment; // first segment
+    int offset; // first case within segment
+    int length; // number of cases
+} fitness_tile_t;
+
+
+/**
+ * Fitness cases prepared for SIMD kernels
+ */
+typedef struct {
+    int segments_count;
+    fitness_segment_t *segments;
+    int cases;
+
+    /* tiles of FITNESS_BATCH_TILE and FITNESS_PARALLEL_TILE cases */
+    int batch_tiles_count;
+    fitness_tile_t *batch_tiles;
+    int parallel_tiles_count;
+    fitness_tile_t *parallel_tiles;
+} fitness_simd_data_t;
 
 
 /**
@@ -33,20 +84,21 @@ typedef double (*fitness_simd_func_t)(
     img_pixel_t *noisy[WINDOW_SIZE],
     ga_chr_t chr,
     int offset,
-    int block_size);
+    int length);
 
 
 /**
  * Calculates difference between original and filtered pixel using SSE2
  * instructions.
  *
- * One call equals 16 CGP evaluations.
+ * Circuit is evaluated for 16 pixels at once, one call equals `length`
+ * CGP evaluations.
  *
  * @param  original_image
  * @param  noisy_image_simd
  * @param  chr
  * @param  offset Where to start in arrays
- * @param  block_size How many pixels to process
+ * @param  length How many pixels to process
  * @return
  */
 double _fitness_get_sqdiffsum_sse(
@@ -54,20 +106,21 @@ double _fitness_get_sqdiffsum_sse(
     img_pixel_t *noisy[WINDOW_SIZE],
     ga_chr_t chr,
     int offset,
-    int block_size);
+    int length);
 
 
 /**
  * Calculates difference between original and filtered pixel using AVX2
  * instructions.
  *
- * One call equals 32 CGP evaluations.
+ * Circuit is evaluated for 32 pixels at once, one call equals `length`
+ * CGP evaluations.
  *
  * @param  original_image
  * @param  noisy_image_simd
  * @param  chr
  * @param  offset Where to start in arrays
- * @param  block_size How many pixels to process
+ * @param  length How many pixels to process
  * @return
  */
 double _fitness_get_sqdiffsum_avx(
@@ -75,12 +128,290 @@ double _fitness_get_sqdiffsum_avx(
     img_pixel_t *noisy[WINDOW_SIZE],
     ga_chr_t chr,
     int offset,
-    int block_size);
+    int length);
+
+
+/**
+ * Calculates difference between original and filtered pixel using AVX-512BW
+ * instructions.
+ *
+ * Circuit is evaluated for 64 pixels at once, one call equals `length`
+ * CGP evaluations.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_avx512(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length);
+
+
+/**
+ * Calculates difference between original and filtered pixel using
+ * circuit compiled to SSE2 machine code. Falls back to
+ * `_fitness_get_sqdiffsum_sse` if code cannot be generated.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_jit_sse(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length);
+
+
+/**
+ * Calculates difference between original and filtered pixel using
+ * circuit compiled to AVX2 machine code. Falls back to
+ * `_fitness_get_sqdiffsum_avx` if code cannot be generated.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_jit_avx(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length);
+
+
+/**
+ * Frees compiled circuits cached by all threads. Must not be called while
+ * any circuit is evaluated.
+ */
+void fitness_jit_deinit();
+
+
+/**
+ * SIMD evaluator of errors in single fitness cases prototype
+ */
+typedef void (*fitness_simd_errors_func_t)(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors);
+
+
+/**
+ * Returns square of difference of filtered and original pixel, square of
+ * 16-bit difference does not fit signed int, but fits unsigned 32 bits
+ *
+ * @param  diff
+ * @return
+ */
+static inline uint32_t fitness_sqdiff(int diff)
+{
+    uint32_t abs_diff = (diff < 0) ? -diff : diff;
+    return abs_diff * abs_diff;
+}
+
+
+/**
+ * Stores squared differences of filtered and original pixels
+ *
+ * @param filtered
+ * @param original
+ * @param count
+ * @param errors
+ */
+static inline void fitness_store_errors(cgp_value_t *filtered,
+    img_pixel_t *original, int count, fitness_error_t *errors)
+{
+    for (int i = 0; i < count; i++) {
+        errors[i] = fitness_sqdiff(filtered[i] - original[i]);
+    }
+}
+
+
+/**
+ * Stores squared difference between original and filtered pixel of each
+ * fitness case using SSE2 instructions. Circuit outputs are identical to
+ * those of `_fitness_get_sqdiffsum_sse`.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @param  errors Indexed the same as original image
+ */
+void _fitness_get_errors_sse(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors);
 
 
 /**
- * For testing purposes only
+ * Stores squared difference between original and filtered pixel of each
+ * fitness case using AVX2 instructions. Circuit outputs are identical to
+ * those of `_fitness_get_sqdiffsum_avx`.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @param  errors Indexed the same as original image
  */
-void fitness_test_init(img_image_t original_image,
-    img_window_array_t noisy_image_windows,
-    img_pixel_t *noisy_image_simd[WINDOW_SIZE]);
+void _fitness_get_errors_avx(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors);
+
+
+/**
+ * Stores squared difference between original and filtered pixel of each
+ * fitness case using AVX-512BW instructions. Circuit outputs are identical
+ * to those of `_fitness_get_sqdiffsum_avx512`.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @param  errors Indexed the same as original image
+ */
+void _fitness_get_errors_avx512(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors);
+
+
+/**
+ * Sums errors in given fitness cases
+ *
+ * @param  errors
+ * @param  cases Indices to errors array
+ * @param  count
+ * @return
+ */
+static inline uint64_t fitness_sum_errors(fitness_error_t *errors,
+    unsigned int *cases, int count)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += errors[cases[i]];
+    }
+    return sum;
+}
+
+
+/**
+ * Sums errors in given fitness cases using AVX2 gathers. Errors array must
+ * be readable one element past the last case.
+ *
+ * @param  errors
+ * @param  cases Indices to errors array
+ * @param  count
+ * @return
+ */
+uint64_t _fitness_sum_errors_avx(fitness_error_t *errors, unsigned int *cases,
+    int count);
+
+
+/**
+ * SIMD incremental fitness evaluator prototype
+ */
+typedef double (*fitness_simd_plan_func_t)(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length);
+
+
+/**
+ * Calculates difference between original and filtered pixel using SSE2
+ * instructions, only nodes listed in plan are computed, others are loaded
+ * from cached planes.
+ *
+ * @param  original_image
+ * @param  planes Value planes of all slots
+ * @param  plan
+ * @param  store Whether to write computed node outputs to planes
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_plan_sse(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length);
+
+
+/**
+ * Calculates difference between original and filtered pixel using AVX2
+ * instructions, only nodes listed in plan are computed, others are loaded
+ * from cached planes.
+ *
+ * @param  original_image
+ * @param  planes Value planes of all slots
+ * @param  plan
+ * @param  store Whether to write computed node outputs to planes
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_plan_avx(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length);
+
+
+/**
+ * Calculates difference between original and filtered pixel using
+ * AVX-512BW instructions, only nodes listed in plan are computed, others
+ * are loaded from cached planes.
+ *
+ * @param  original_image
+ * @param  planes Value planes of all slots
+ * @param  plan
+ * @param  store Whether to write computed node outputs to planes
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_plan_avx512(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length);
+
@@ -18,21 +18,83 @@
  */
 
 
+#include <stdint.h>
+
 #include "../fitness.h"
 #include "cgp_avx.h"
 
 
+/**
+ * Moves 32-bit partial sums to 64-bit accumulator
+ */
+static inline __m256i _flush_avx(__m256i acc64, __m256i acc32)
+{
+    __m256i zero = _mm256_setzero_si256();
+    acc64 = _mm256_add_epi64(acc64, _mm256_unpacklo_epi32(acc32, zero));
+    acc64 = _mm256_add_epi64(acc64, _mm256_unpackhi_epi32(acc32, zero));
+    return acc64;
+}
+
+
+/**
+ * Adds squared differences of filtered and expected pixels to accumulators,
+ * 32-bit partial sums are moved to 64-bit accumulator regularly
+ */
+static inline void _accumulate_avx(__m256i filtered, __m256i expected,
+    __m256i *acc32, __m256i *acc64, int *blocks)
+{
+    __m256i zero = _mm256_setzero_si256();
+
+#ifdef PIXEL16
+    // |a - b| of unsigned words = (a -sat b) | (b -sat a)
+    __m256i absdiff = _mm256_or_si256(_mm256_subs_epu16(filtered, expected),
+        _mm256_subs_epu16(expected, filtered));
+
+    // squares of 16-bit differences do not fit signed madd results, widen
+    // to 32 bits and square even and odd lanes to 64 bits
+    __m256i lo = _mm256_unpacklo_epi16(absdiff, zero);
+    __m256i hi = _mm256_unpackhi_epi16(absdiff, zero);
+    __m256i lo_odd = _mm256_srli_epi64(lo, 32);
+    __m256i hi_odd = _mm256_srli_epi64(hi, 32);
+    *acc64 = _mm256_add_epi64(*acc64, _mm256_mul_epu32(lo, lo));
+    *acc64 = _mm256_add_epi64(*acc64, _mm256_mul_epu32(lo_odd, lo_odd));
+    *acc64 = _mm256_add_epi64(*acc64, _mm256_mul_epu32(hi, hi));
+    *acc64 = _mm256_add_epi64(*acc64, _mm256_mul_epu32(hi_odd, hi_odd));
+    (void) acc32;
+    (void) blocks;
+
+#else
+    // |a - b| of unsigned bytes = (a -sat b) | (b -sat a)
+    __m256i absdiff = _mm256_or_si256(_mm256_subs_epu8(filtered, expected),
+        _mm256_subs_epu8(expected, filtered));
+
+    // widen to 16 bits and square + sum pairs to 32 bits
+    __m256i lo = _mm256_unpacklo_epi8(absdiff, zero);
+    __m256i hi = _mm256_unpackhi_epi8(absdiff, zero);
+    *acc32 = _mm256_add_epi32(*acc32, _mm256_madd_epi16(lo, lo));
+    *acc32 = _mm256_add_epi32(*acc32, _mm256_madd_epi16(hi, hi));
+
+    if (++(*blocks) == FITNESS_SIMD_FLUSH_BLOCKS) {
+        *acc64 = _flush_avx(*acc64, *acc32);
+        *acc32 = zero;
+        *blocks = 0;
+    }
+#endif
+}
+
+
 /**
  * Calculates difference between original and filtered pixel using AVX2
  * instructions.
  *
- * One call equals 16 CGP evaluations.
+ * Circuit is evaluated for 32 pixels (16 in 16-bit build) at once, squared
+ * differences are accumulated in-register and summed once at the end.
  *
  * @param  original_image
  * @param  noisy_image_simd
  * @param  chr
  * @param  offset Where to start in arrays
- * @param  block_size How many pixels to process
+ * @param  length How many pixels to process
  * @return
  */
 double _fitness_get_sqdiffsum_avx(
@@ -40,23 +102,231 @@ double _fitness_get_sqdiffsum_avx(
     img_pixel_t *noisy[WINDOW_SIZE],
     ga_chr_t chr,
     int offset,
-    int block_size)
+    int length)
 {
     __m256i_aligned avx_inputs[CGP_INPUTS];
     __m256i_aligned avx_outputs[CGP_OUTPUTS];
-    unsigned char *outputs_ptr = (unsigned char*) &avx_outputs;
+    cgp_value_t *outputs_ptr = (cgp_value_t*) &avx_outputs;
 
-    for (int i = 0; i < CGP_INPUTS; i++) {
-        avx_inputs[i] = _mm256_load_si256((__m256i*)(&noisy[i][offset]));
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc32 = zero;
+    __m256i acc64 = zero;
+    int blocks = 0;
+
+    int end = offset + length;
+    int aligned_end = end - length % FITNESS_AVX2_STEP;
+
+    for (; offset < aligned_end; offset += FITNESS_AVX2_STEP) {
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            avx_inputs[i] = _mm256_loadu_si256((__m256i*)(&noisy[i][offset]));
+        }
+
+        cgp_get_output_avx(chr, avx_inputs, avx_outputs);
+
+        __m256i expected = _mm256_loadu_si256((__m256i*)(&original[offset]));
+        _accumulate_avx(avx_outputs[0], expected, &acc32, &acc64, &blocks);
     }
 
-    cgp_get_output_avx(chr, avx_inputs, avx_outputs);
+    acc64 = _flush_avx(acc64, acc32);
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, acc64);
+    double sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    // fix image data not fitting into register - original image is
+    // not padded, the rest is compared one by one
+    if (offset < end) {
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            avx_inputs[i] = _mm256_loadu_si256((__m256i*)(&noisy[i][offset]));
+        }
 
-    double sum = 0;
-    for (int i = 0; i < block_size; i++) {
-        int diff = outputs_ptr[i] - original[offset + i];
-        sum += diff * diff;
+        cgp_get_output_avx(chr, avx_inputs, avx_outputs);
+
+        for (int i = 0; i < end - offset; i++) {
+            int diff = outputs_ptr[i] - original[offset + i];
+            sum += fitness_sqdiff(diff);
+        }
     }
+
     return sum;
 }
 
+
+/**
+ * Stores squared difference between original and filtered pixel of each
+ * fitness case using AVX2 instructions. Circuit outputs are identical to
+ * those of `_fitness_get_sqdiffsum_avx`.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @param  errors Indexed the same as original image
+ */
+void _fitness_get_errors_avx(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors)
+{
+    __m256i_aligned avx_inputs[CGP_INPUTS];
+    __m256i_aligned avx_outputs[CGP_OUTPUTS];
+    cgp_value_t *outputs_ptr = (cgp_value_t*) &avx_outputs;
+
+    int end = offset + length;
+
+    for (; offset < end; offset += FITNESS_AVX2_STEP) {
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            avx_inputs[i] = _mm256_loadu_si256((__m256i*)(&noisy[i][offset]));
+        }
+
+        cgp_get_output_avx(chr, avx_inputs, avx_outputs);
+
+        // original image is not padded, last block may be shorter
+        int count = (end - offset < FITNESS_AVX2_STEP)
+            ? end - offset : FITNESS_AVX2_STEP;
+        fitness_store_errors(outputs_ptr, &original[offset], count,
+            &errors[offset]);
+    }
+}
+
+
+/**
+ * Sums errors in given fitness cases using AVX2 gathers. Errors array must
+ * be readable one element past the last case.
+ *
+ * @param  errors
+ * @param  cases Indices to errors array
+ * @param  count
+ * @return
+ */
+uint64_t _fitness_sum_errors_avx(fitness_error_t *errors, unsigned int *cases,
+    int count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc32 = zero;
+    __m256i acc64 = zero;
+#ifndef PIXEL16
+    int blocks = 0;
+#endif
+    int i = 0;
+
+    // eight cases in one gather
+    for (; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_loadu_si256((__m256i*) &cases[i]);
+
+#ifdef PIXEL16
+        // 32-bit errors can overflow any sum, widen them right away
+        __m256i error = _mm256_i32gather_epi32((int*) errors, index, 4);
+        acc64 = _flush_avx(acc64, error);
+#else
+        // 16-bit errors are gathered with their neighbour
+        __m256i error = _mm256_i32gather_epi32((int*) errors, index, 2);
+        acc32 = _mm256_add_epi32(acc32,
+            _mm256_and_si256(error, _mm256_set1_epi32(0xFFFF)));
+
+        if (++blocks == FITNESS_SIMD_FLUSH_BLOCKS) {
+            acc64 = _flush_avx(acc64, acc32);
+            acc32 = zero;
+            blocks = 0;
+        }
+#endif
+    }
+    acc64 = _flush_avx(acc64, acc32);
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, acc64);
+    uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    return sum + fitness_sum_errors(errors, &cases[i], count - i);
+}
+
+
+/**
+ * Evaluates one block of pixels according to plan
+ *
+ * @return Circuit output
+ */
+static inline __m256i _eval_plan_avx(img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan, __m256i_aligned values[NODECACHE_SLOTS],
+    bool store, int offset)
+{
+    for (int i = 0; i < plan->loads_count; i++) {
+        int slot = plan->loads[i];
+        values[slot] = _mm256_loadu_si256((__m256i*)(&planes[slot][offset]));
+    }
+
+    for (int i = 0; i < plan->program_length; i++) {
+        cgp_instr_t *instr = &plan->program[i];
+        __m256i Y = cgp_eval_node_avx(instr->function,
+            values[instr->inputs[0]], values[instr->inputs[1]]);
+        values[instr->output] = Y;
+        if (store) {
+            _mm256_storeu_si256((__m256i*)(&planes[instr->output][offset]), Y);
+        }
+    }
+
+    return values[plan->output];
+}
+
+
+/**
+ * Calculates difference between original and filtered pixel using AVX2
+ * instructions, only nodes listed in plan are computed, others are loaded
+ * from cached planes.
+ *
+ * @param  original_image
+ * @param  planes Value planes of all slots
+ * @param  plan
+ * @param  store Whether to write computed node outputs to planes
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_plan_avx(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length)
+{
+    __m256i_aligned values[NODECACHE_SLOTS];
+
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc32 = zero;
+    __m256i acc64 = zero;
+    int blocks = 0;
+
+    int end = offset + length;
+    int aligned_end = end - length % FITNESS_AVX2_STEP;
+
+    for (; offset < aligned_end; offset += FITNESS_AVX2_STEP) {
+        __m256i filtered = _eval_plan_avx(planes, plan, values, store, offset);
+        __m256i expected = _mm256_loadu_si256((__m256i*)(&original[offset]));
+        _accumulate_avx(filtered, expected, &acc32, &acc64, &blocks);
+    }
+
+    acc64 = _flush_avx(acc64, acc32);
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, acc64);
+    double sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    // both noisy and cached planes are padded, only original is not
+    if (offset < end) {
+        cgp_value_t output[sizeof(__m256i) / sizeof(cgp_value_t)];
+        _mm256_storeu_si256((__m256i*) output,
+            _eval_plan_avx(planes, plan, values, store, offset));
+
+        for (int i = 0; i < end - offset; i++) {
+            int diff = output[i] - original[offset + i];
+            sum += fitness_sqdiff(diff);
+        }
+    }
+
+    return sum;
+}
@@ -0,0 +1,225 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#include <stdint.h>
+
+#include "../fitness.h"
+#include "cgp_avx512.h"
+
+
+/**
+ * Moves 32-bit partial sums to 64-bit accumulator
+ */
+static inline __m512i _flush_avx512(__m512i acc64, __m512i acc32)
+{
+    __m512i zero = _mm512_setzero_si512();
+    acc64 = _mm512_add_epi64(acc64, _mm512_unpacklo_epi32(acc32, zero));
+    acc64 = _mm512_add_epi64(acc64, _mm512_unpackhi_epi32(acc32, zero));
+    return acc64;
+}
+
+
+/**
+ * Calculates difference between original and filtered pixel using AVX-512BW
+ * instructions.
+ *
+ * Circuit is evaluated for 64 pixels at once, squared differences are
+ * accumulated in-register and summed once at the end. Last block is
+ * masked - pixels beyond the end are neither loaded nor counted.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_avx512(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length)
+{
+    __m512i_aligned avx512_inputs[CGP_INPUTS];
+    __m512i_aligned avx512_outputs[CGP_OUTPUTS];
+
+    __m512i zero = _mm512_setzero_si512();
+    __m512i acc32 = zero;
+    __m512i acc64 = zero;
+    int blocks = 0;
+
+    int end = offset + length;
+
+    for (; offset < end; offset += FITNESS_AVX512_STEP) {
+        int remaining = end - offset;
+        __mmask64 mask = (remaining < FITNESS_AVX512_STEP)
+            ? (((uint64_t) 1) << remaining) - 1
+            : ~((uint64_t) 0);
+
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            avx512_inputs[i] = _mm512_maskz_loadu_epi8(mask, &noisy[i][offset]);
+        }
+
+        cgp_get_output_avx512(chr, avx512_inputs, avx512_outputs);
+
+        // absolute difference of unsigned bytes, masked pixels are zero
+        __m512i filtered = avx512_outputs[0];
+        __m512i expected = _mm512_maskz_loadu_epi8(mask, &original[offset]);
+        __m512i absdiff = _mm512_maskz_sub_epi8(mask,
+            _mm512_max_epu8(filtered, expected),
+            _mm512_min_epu8(filtered, expected));
+
+        // widen to 16 bits and square + sum pairs to 32 bits
+        __m512i lo = _mm512_unpacklo_epi8(absdiff, zero);
+        __m512i hi = _mm512_unpackhi_epi8(absdiff, zero);
+        acc32 = _mm512_add_epi32(acc32, _mm512_madd_epi16(lo, lo));
+        acc32 = _mm512_add_epi32(acc32, _mm512_madd_epi16(hi, hi));
+
+        if (++blocks == FITNESS_SIMD_FLUSH_BLOCKS) {
+            acc64 = _flush_avx512(acc64, acc32);
+            acc32 = zero;
+            blocks = 0;
+        }
+    }
+
+    acc64 = _flush_avx512(acc64, acc32);
+    return _mm512_reduce_add_epi64(acc64);
+}
+
+
+/**
+ * Stores squared difference between original and filtered pixel of each
+ * fitness case using AVX-512BW instructions. Circuit outputs are identical
+ * to those of `_fitness_get_sqdiffsum_avx512`.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @param  errors Indexed the same as original image
+ */
+void _fitness_get_errors_avx512(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors)
+{
+    __m512i_aligned avx512_inputs[CGP_INPUTS];
+    __m512i_aligned avx512_outputs[CGP_OUTPUTS];
+    cgp_value_t *outputs_ptr = (cgp_value_t*) &avx512_outputs;
+
+    int end = offset + length;
+
+    for (; offset < end; offset += FITNESS_AVX512_STEP) {
+        int remaining = end - offset;
+        __mmask64 mask = (remaining < FITNESS_AVX512_STEP)
+            ? (((uint64_t) 1) << remaining) - 1
+            : ~((uint64_t) 0);
+
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            avx512_inputs[i] = _mm512_maskz_loadu_epi8(mask, &noisy[i][offset]);
+        }
+
+        cgp_get_output_avx512(chr, avx512_inputs, avx512_outputs);
+
+        int count = (remaining < FITNESS_AVX512_STEP)
+            ? remaining : FITNESS_AVX512_STEP;
+        fitness_store_errors(outputs_ptr, &original[offset], count,
+            &errors[offset]);
+    }
+}
+
+
+/**
+ * Calculates difference between original and filtered pixel using
+ * AVX-512BW instructions, only nodes listed in plan are computed, others
+ * are loaded from cached planes.
+ *
+ * @param  original_image
+ * @param  planes Value planes of all slots
+ * @param  plan
+ * @param  store Whether to write computed node outputs to planes
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_plan_avx512(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length)
+{
+    __m512i_aligned values[NODECACHE_SLOTS];
+
+    __m512i zero = _mm512_setzero_si512();
+    __m512i acc32 = zero;
+    __m512i acc64 = zero;
+    int blocks = 0;
+
+    int end = offset + length;
+
+    for (; offset < end; offset += FITNESS_AVX512_STEP) {
+        int remaining = end - offset;
+        __mmask64 mask = (remaining < FITNESS_AVX512_STEP)
+            ? (((uint64_t) 1) << remaining) - 1
+            : ~((uint64_t) 0);
+
+        for (int i = 0; i < plan->loads_count; i++) {
+            int slot = plan->loads[i];
+            values[slot] = _mm512_maskz_loadu_epi8(mask, &planes[slot][offset]);
+        }
+
+        for (int i = 0; i < plan->program_length; i++) {
+            cgp_instr_t *instr = &plan->program[i];
+            __m512i Y = cgp_eval_node_avx512(instr->function,
+                values[instr->inputs[0]], values[instr->inputs[1]]);
+            values[instr->output] = Y;
+            if (store) {
+                _mm512_mask_storeu_epi8(&planes[instr->output][offset], mask, Y);
+            }
+        }
+
+        __m512i filtered = values[plan->output];
+        __m512i expected = _mm512_maskz_loadu_epi8(mask, &original[offset]);
+        __m512i absdiff = _mm512_maskz_sub_epi8(mask,
+            _mm512_max_epu8(filtered, expected),
+            _mm512_min_epu8(filtered, expected));
+
+        __m512i lo = _mm512_unpacklo_epi8(absdiff, zero);
+        __m512i hi = _mm512_unpackhi_epi8(absdiff, zero);
+        acc32 = _mm512_add_epi32(acc32, _mm512_madd_epi16(lo, lo));
+        acc32 = _mm512_add_epi32(acc32, _mm512_madd_epi16(hi, hi));
+
+        if (++blocks == FITNESS_SIMD_FLUSH_BLOCKS) {
+            acc64 = _flush_avx512(acc64, acc32);
+            acc32 = zero;
+            blocks = 0;
+        }
+    }
+
+    acc64 = _flush_avx512(acc64, acc32);
+    return _mm512_reduce_add_epi64(acc64);
+}
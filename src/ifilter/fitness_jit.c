@@ -0,0 +1,244 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../fitness.h"
+#include "cgp_jit.h"
+
+
+// compiled circuits kept by each thread, indexed by phenotype hash
+#define FITNESS_JIT_CACHE_SIZE 16
+
+
+typedef struct {
+    bool valid;
+    struct cgp_genome genome;
+    cgp_jit_t jit;
+} _jit_cache_entry_t;
+
+
+typedef struct _jit_cache {
+    _jit_cache_entry_t entries[FITNESS_JIT_CACHE_SIZE];
+    struct _jit_cache *next;
+} _jit_cache_t;
+
+
+// caches of all threads, so that they can be freed from one of them
+static _jit_cache_t *_jit_caches = NULL;
+
+// incremented when caches are freed, so threads know their one is gone
+static int _jit_generation = 0;
+
+static _Thread_local _jit_cache_t *_jit_cache = NULL;
+static _Thread_local int _jit_cache_generation = 0;
+
+
+/**
+ * Returns cache of calling thread, allocates it if necessary
+ *
+ * @return NULL if memory cannot be allocated
+ */
+static _jit_cache_t *_fitness_jit_get_cache()
+{
+    int generation;
+    #pragma omp atomic read
+    generation = _jit_generation;
+
+    if (_jit_cache != NULL && _jit_cache_generation == generation) {
+        return _jit_cache;
+    }
+
+    _jit_cache = (_jit_cache_t*) calloc(1, sizeof(_jit_cache_t));
+    _jit_cache_generation = generation;
+    if (_jit_cache == NULL) {
+        return NULL;
+    }
+
+    #pragma omp critical (FITNESS_JIT_CACHES)
+    {
+        _jit_cache->next = _jit_caches;
+        _jit_caches = _jit_cache;
+    }
+    return _jit_cache;
+}
+
+
+/**
+ * Frees compiled circuits cached by all threads. Must not be called while
+ * any circuit is evaluated.
+ */
+void fitness_jit_deinit()
+{
+    #pragma omp critical (FITNESS_JIT_CACHES)
+    {
+        while (_jit_caches != NULL) {
+            _jit_cache_t *cache = _jit_caches;
+            _jit_caches = cache->next;
+
+            for (int i = 0; i < FITNESS_JIT_CACHE_SIZE; i++) {
+                cgp_jit_destroy(cache->entries[i].jit);
+            }
+            free(cache);
+        }
+
+        #pragma omp atomic update
+        _jit_generation++;
+    }
+
+    _jit_cache = NULL;
+}
+
+
+/**
+ * Returns compiled code of given circuit, compiles it if it is not
+ * in the cache of calling thread
+ *
+ * @param  chr
+ * @param  isa
+ * @return NULL if code cannot be generated
+ */
+static cgp_jit_t _fitness_jit_get(ga_chr_t chr, cgp_jit_isa_t isa)
+{
+    cgp_genome_t genome = (cgp_genome_t) chr->genome;
+
+    _jit_cache_t *cache = _fitness_jit_get_cache();
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    _jit_cache_entry_t *entry =
+        &cache->entries[genome->phenotype_hash % FITNESS_JIT_CACHE_SIZE];
+
+    if (entry->valid && entry->jit->isa == isa
+        && cgp_same_phenotype(&entry->genome, genome)) {
+        return entry->jit;
+    }
+
+    if (entry->jit != NULL && entry->jit->isa != isa) {
+        cgp_jit_destroy(entry->jit);
+        entry->jit = NULL;
+    }
+    if (entry->jit == NULL) {
+        entry->jit = cgp_jit_create(isa);
+        if (entry->jit == NULL) {
+            entry->valid = false;
+            return NULL;
+        }
+    }
+
+    entry->valid = cgp_jit_compile(entry->jit, genome);
+    if (!entry->valid) {
+        return NULL;
+    }
+
+    cgp_copy_genome(&entry->genome, genome);
+    return entry->jit;
+}
+
+
+/**
+ * Runs compiled code over whole blocks, rest is left to interpreted
+ * kernel
+ */
+static double _fitness_jit_run(cgp_jit_t jit, fitness_simd_func_t tail_func,
+    img_pixel_t *original, img_pixel_t *noisy[WINDOW_SIZE], ga_chr_t chr,
+    int offset, int length)
+{
+    uint32_t lanes[8];
+    int lanes_count = jit->step / 4;
+    uint64_t sum = 0;
+
+    long blocks = length / jit->step;
+    while (blocks > 0) {
+        long chunk = blocks;
+        if (chunk > FITNESS_SIMD_FLUSH_BLOCKS) chunk = FITNESS_SIMD_FLUSH_BLOCKS;
+
+        jit->kernel(original, noisy, offset, chunk, lanes);
+        for (int i = 0; i < lanes_count; i++) {
+            sum += lanes[i];
+        }
+
+        offset += chunk * jit->step;
+        length -= chunk * jit->step;
+        blocks -= chunk;
+    }
+
+    double result = sum;
+    if (length > 0) {
+        result += tail_func(original, noisy, chr, offset, length);
+    }
+    return result;
+}
+
+
+/**
+ * Calculates difference between original and filtered pixel using
+ * circuit compiled to SSE2 machine code.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_jit_sse(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length)
+{
+    cgp_jit_t jit = _fitness_jit_get(chr, cgp_jit_sse2);
+    if (jit == NULL) {
+        return _fitness_get_sqdiffsum_sse(original, noisy, chr, offset, length);
+    }
+    return _fitness_jit_run(jit, _fitness_get_sqdiffsum_sse,
+        original, noisy, chr, offset, length);
+}
+
+
+/**
+ * Calculates difference between original and filtered pixel using
+ * circuit compiled to AVX2 machine code.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_jit_avx(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length)
+{
+    cgp_jit_t jit = _fitness_jit_get(chr, cgp_jit_avx2);
+    if (jit == NULL) {
+        return _fitness_get_sqdiffsum_avx(original, noisy, chr, offset, length);
+    }
+    return _fitness_jit_run(jit, _fitness_get_sqdiffsum_avx,
+        original, noisy, chr, offset, length);
+}
@@ -18,21 +18,36 @@
  */
 
 
+#include <stdint.h>
+
 #include "../fitness.h"
 #include "cgp_sse.h"
 
 
+/**
+ * Moves 32-bit partial sums to 64-bit accumulator
+ */
+static inline __m128i _flush_sse(__m128i acc64, __m128i acc32)
+{
+    __m128i zero = _mm_setzero_si128();
+    acc64 = _mm_add_epi64(acc64, _mm_unpacklo_epi32(acc32, zero));
+    acc64 = _mm_add_epi64(acc64, _mm_unpackhi_epi32(acc32, zero));
+    return acc64;
+}
+
+
 /**
  * Calculates difference between original and filtered pixel using SSE2
  * instructions.
  *
- * One call equals 16 CGP evaluations.
+ * Circuit is evaluated for 16 pixels at once, squared differences are
+ * accumulated in-register and summed once at the end.
  *
  * @param  original_image
  * @param  noisy_image_simd
  * @param  chr
  * @param  offset Where to start in arrays
- * @param  block_size How many pixels to process
+ * @param  length How many pixels to process
  * @return
  */
 double _fitness_get_sqdiffsum_sse(
@@ -40,23 +55,207 @@ double _fitness_get_sqdiffsum_sse(
     img_pixel_t *noisy[WINDOW_SIZE],
     ga_chr_t chr,
     int offset,
-    int block_size)
+    int length)
 {
     __m128i_aligned sse_inputs[CGP_INPUTS];
     __m128i_aligned sse_outputs[CGP_OUTPUTS];
     unsigned char *outputs_ptr = (unsigned char*) &sse_outputs;
 
-    for (int i = 0; i < CGP_INPUTS; i++) {
-        sse_inputs[i] = _mm_load_si128((__m128i*)(&noisy[i][offset]));
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc32 = zero;
+    __m128i acc64 = zero;
+    int blocks = 0;
+
+    int end = offset + length;
+    int aligned_end = end - length % FITNESS_SSE2_STEP;
+
+    for (; offset < aligned_end; offset += FITNESS_SSE2_STEP) {
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            sse_inputs[i] = _mm_loadu_si128((__m128i*)(&noisy[i][offset]));
+        }
+
+        cgp_get_output_sse(chr, sse_inputs, sse_outputs);
+
+        // |a - b| of unsigned bytes = (a -sat b) | (b -sat a)
+        __m128i filtered = sse_outputs[0];
+        __m128i expected = _mm_loadu_si128((__m128i*)(&original[offset]));
+        __m128i absdiff = _mm_or_si128(_mm_subs_epu8(filtered, expected),
+            _mm_subs_epu8(expected, filtered));
+
+        // widen to 16 bits and square + sum pairs to 32 bits
+        __m128i lo = _mm_unpacklo_epi8(absdiff, zero);
+        __m128i hi = _mm_unpackhi_epi8(absdiff, zero);
+        acc32 = _mm_add_epi32(acc32, _mm_madd_epi16(lo, lo));
+        acc32 = _mm_add_epi32(acc32, _mm_madd_epi16(hi, hi));
+
+        if (++blocks == FITNESS_SIMD_FLUSH_BLOCKS) {
+            acc64 = _flush_sse(acc64, acc32);
+            acc32 = zero;
+            blocks = 0;
+        }
     }
 
-    cgp_get_output_sse(chr, sse_inputs, sse_outputs);
+    acc64 = _flush_sse(acc64, acc32);
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*) lanes, acc64);
+    double sum = lanes[0] + lanes[1];
+
+    // fix image data not fitting into register - original image is
+    // not padded, the rest is compared one by one
+    if (offset < end) {
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            sse_inputs[i] = _mm_loadu_si128((__m128i*)(&noisy[i][offset]));
+        }
 
-    double sum = 0;
-    for (int i = 0; i < block_size; i++) {
-        int diff = outputs_ptr[i] - original[offset + i];
-        sum += diff * diff;
+        cgp_get_output_sse(chr, sse_inputs, sse_outputs);
+
+        for (int i = 0; i < end - offset; i++) {
+            int diff = outputs_ptr[i] - original[offset + i];
+            sum += diff * diff;
+        }
     }
+
     return sum;
 }
 
+
+/**
+ * Stores squared difference between original and filtered pixel of each
+ * fitness case using SSE2 instructions. Circuit outputs are identical to
+ * those of `_fitness_get_sqdiffsum_sse`.
+ *
+ * @param  original_image
+ * @param  noisy_image_simd
+ * @param  chr
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @param  errors Indexed the same as original image
+ */
+void _fitness_get_errors_sse(
+    img_pixel_t *original,
+    img_pixel_t *noisy[WINDOW_SIZE],
+    ga_chr_t chr,
+    int offset,
+    int length,
+    fitness_error_t *errors)
+{
+    __m128i_aligned sse_inputs[CGP_INPUTS];
+    __m128i_aligned sse_outputs[CGP_OUTPUTS];
+    cgp_value_t *outputs_ptr = (cgp_value_t*) &sse_outputs;
+
+    int end = offset + length;
+
+    for (; offset < end; offset += FITNESS_SSE2_STEP) {
+        for (int i = 0; i < CGP_INPUTS; i++) {
+            sse_inputs[i] = _mm_loadu_si128((__m128i*)(&noisy[i][offset]));
+        }
+
+        cgp_get_output_sse(chr, sse_inputs, sse_outputs);
+
+        // original image is not padded, last block may be shorter
+        int count = (end - offset < FITNESS_SSE2_STEP)
+            ? end - offset : FITNESS_SSE2_STEP;
+        fitness_store_errors(outputs_ptr, &original[offset], count,
+            &errors[offset]);
+    }
+}
+
+
+/**
+ * Evaluates one block of 16 pixels according to plan
+ *
+ * @return Circuit output
+ */
+static inline __m128i _eval_plan_sse(img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan, __m128i_aligned values[NODECACHE_SLOTS],
+    bool store, int offset)
+{
+    for (int i = 0; i < plan->loads_count; i++) {
+        int slot = plan->loads[i];
+        values[slot] = _mm_loadu_si128((__m128i*)(&planes[slot][offset]));
+    }
+
+    for (int i = 0; i < plan->program_length; i++) {
+        cgp_instr_t *instr = &plan->program[i];
+        __m128i Y = cgp_eval_node_sse(instr->function,
+            values[instr->inputs[0]], values[instr->inputs[1]]);
+        values[instr->output] = Y;
+        if (store) {
+            _mm_storeu_si128((__m128i*)(&planes[instr->output][offset]), Y);
+        }
+    }
+
+    return values[plan->output];
+}
+
+
+/**
+ * Calculates difference between original and filtered pixel using SSE2
+ * instructions, only nodes listed in plan are computed, others are loaded
+ * from cached planes.
+ *
+ * @param  original_image
+ * @param  planes Value planes of all slots
+ * @param  plan
+ * @param  store Whether to write computed node outputs to planes
+ * @param  offset Where to start in arrays
+ * @param  length How many pixels to process
+ * @return
+ */
+double _fitness_get_sqdiffsum_plan_sse(
+    img_pixel_t *original,
+    img_pixel_t *planes[NODECACHE_SLOTS],
+    nodecache_plan_t *plan,
+    bool store,
+    int offset,
+    int length)
+{
+    __m128i_aligned values[NODECACHE_SLOTS];
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc32 = zero;
+    __m128i acc64 = zero;
+    int blocks = 0;
+
+    int end = offset + length;
+    int aligned_end = end - length % FITNESS_SSE2_STEP;
+
+    for (; offset < aligned_end; offset += FITNESS_SSE2_STEP) {
+        __m128i filtered = _eval_plan_sse(planes, plan, values, store, offset);
+        __m128i expected = _mm_loadu_si128((__m128i*)(&original[offset]));
+        __m128i absdiff = _mm_or_si128(_mm_subs_epu8(filtered, expected),
+            _mm_subs_epu8(expected, filtered));
+
+        __m128i lo = _mm_unpacklo_epi8(absdiff, zero);
+        __m128i hi = _mm_unpackhi_epi8(absdiff, zero);
+        acc32 = _mm_add_epi32(acc32, _mm_madd_epi16(lo, lo));
+        acc32 = _mm_add_epi32(acc32, _mm_madd_epi16(hi, hi));
+
+        if (++blocks == FITNESS_SIMD_FLUSH_BLOCKS) {
+            acc64 = _flush_sse(acc64, acc32);
+            acc32 = zero;
+            blocks = 0;
+        }
+    }
+
+    acc64 = _flush_sse(acc64, acc32);
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*) lanes, acc64);
+    double sum = lanes[0] + lanes[1];
+
+    // both noisy and cached planes are padded, only original is not
+    if (offset < end) {
+        __m128i_aligned output;
+        unsigned char *output_ptr = (unsigned char*) &output;
+        output = _eval_plan_sse(planes, plan, values, store, offset);
+
+        for (int i = 0; i < end - offset; i++) {
+            int diff = output_ptr[i] - original[offset + i];
+            sum += diff * diff;
+        }
+    }
+
+    return sum;
+}
@@ -19,11 +19,14 @@
 
 
 #include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../cpu.h"
 #include "image.h"
+#include "image_stream.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -52,6 +55,9 @@
 
 const int COMP = 1;
 
+// widest SIMD register, may be loaded at the last pixel of padded image
+#define PADDED_TAIL_PIXELS 64
+
 
 /**
  * Create new image - image data are not initialized!
@@ -72,31 +78,113 @@ img_image_t img_create(int width, int height, int comp) {
 
 
 /**
- * Loads image from file
+ * Converts 8-bit samples decoded by stb_image to pixels, input array is
+ * either reused or freed
+ * @param  data
+ * @param  count Number of samples
+ * @return NULL on failure
+ */
+static img_pixel_t *_img_from_8bit(unsigned char *data, size_t count)
+{
+#ifdef PIXEL16
+    img_pixel_t *pixels = NULL;
+    if (data != NULL) {
+        pixels = (img_pixel_t*) malloc(sizeof(img_pixel_t) * count);
+    }
+    if (pixels != NULL) {
+        // 0xFF maps to 0xFFFF
+        for (size_t i = 0; i < count; i++) {
+            pixels[i] = data[i] * (IMG_PIXEL_MAX / 0xFF);
+        }
+    }
+    free(data);
+    return pixels;
+#else
+    (void) count;
+    return data;
+#endif
+}
+
+
+/**
+ * Returns image data as 8-bit samples for stb_image_write, 16-bit pixels
+ * are reduced to their high byte
+ * @param  img
+ * @return NULL on failure, img->data or array to be freed by caller
+ */
+static unsigned char *_img_to_8bit(img_image_t img)
+{
+#ifdef PIXEL16
+    size_t count = (size_t) img->width * img->height * img->comp;
+    unsigned char *data = (unsigned char*) malloc(count);
+    if (data != NULL) {
+        for (size_t i = 0; i < count; i++) {
+            data[i] = img->data[i] >> 8;
+        }
+    }
+    return data;
+#else
+    return img->data;
+#endif
+}
+
+
+/**
+ * Loads binary PGM image
+ * @param  file
+ * @return NULL on failure
+ */
+static img_image_t _img_load_pgm(FILE *file)
+{
+    img_stream_t stream = img_stream_open_pgm(file);
+    if (stream == NULL) return NULL;
+
+    img_image_t img = img_create(stream->width, stream->height, COMP);
+    if (img == NULL || img->data == NULL) {
+        fprintf(stderr, "img_load: cannot malloc\n");
+        img_destroy(img);
+        img_stream_destroy(stream);
+        return NULL;
+    }
+
+    for (int y = 0; y < img->height; y++) {
+        if (img_stream_read_row(stream, &img->data[img_pixel_index(img, 0, y)])) {
+            fprintf(stderr, "Failed to read PGM image data.\n");
+            img_destroy(img);
+            img = NULL;
+            break;
+        }
+    }
+
+    img_stream_destroy(stream);
+    return img;
+}
+
+
+/**
+ * Loads image from file. Binary PGM images are read with their full
+ * sample depth, other formats are decoded by stb_image as 8-bit.
  * @param  filename
  * @return
  */
 img_image_t img_load(char const *filename) {
-    img_image_t img = (img_image_t) malloc(sizeof(struct img_image));
-    if (img == NULL) {
-        fprintf(stderr, "img_load: cannot malloc");
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "img_load: cannot open %s\n", filename);
         return NULL;
     }
 
-    img->data = stbi_load(filename, &(img->width), &(img->height), &(img->comp), COMP);
-    if (img->data == NULL) {
-        fprintf(stderr, "%s", stbi__g_failure_reason);
-        free(img);
-        return NULL;
-    }
+    bool is_pgm = fgetc(file) == 'P' && fgetc(file) == '5';
+    rewind(file);
 
-    img->comp = COMP;
+    img_image_t img = is_pgm ? _img_load_pgm(file) : img_load_stream(file);
+    fclose(file);
     return img;
 }
 
 
 /**
- * Loads image from stream
+ * Loads image from stream, it is decoded by stb_image as 8-bit
  * @param  filename
  * @return
  */
@@ -104,13 +192,19 @@ img_image_t img_load_stream(FILE *file) {
     img_image_t img = (img_image_t) malloc(sizeof(struct img_image));
     if (img == NULL) return NULL;
 
-    img->data = stbi_load_from_file(file, &(img->width), &(img->height), &(img->comp), COMP);
-    if (img->data == NULL) {
+    unsigned char *data = stbi_load_from_file(file, &(img->width), &(img->height), &(img->comp), COMP);
+    if (data == NULL) {
         printf("%s", stbi__g_failure_reason);
         free(img);
         return NULL;
     }
 
+    img->data = _img_from_8bit(data, (size_t) img->width * img->height * COMP);
+    if (img->data == NULL) {
+        free(img);
+        return NULL;
+    }
+
     img->comp = COMP;
     return img;
 }
@@ -132,33 +226,48 @@ void img_copy(img_image_t dest, img_image_t src)
 
 
 /**
- * Store image to BMP file
+ * Store image to BMP file, 16-bit pixels are reduced to 8 bits
  * @param  img
  * @return 0 on failure, non-zero on success
  */
 int img_save_bmp(img_image_t img, char const *filename) {
-    return stbi_write_bmp(filename, img->width, img->height, img->comp, img->data);
+    unsigned char *data = _img_to_8bit(img);
+    if (data == NULL) return 0;
+
+    int result = stbi_write_bmp(filename, img->width, img->height, img->comp, data);
+    if (data != (unsigned char*) img->data) free(data);
+    return result;
 }
 
 
 /**
- * Store image to PNG file
+ * Store image to PNG file, 16-bit pixels are reduced to 8 bits
  * @param  img
  * @return 0 on failure, non-zero on success
  */
 int img_save_png(img_image_t img, char const *filename) {
-    return stbi_write_png(filename, img->width, img->height, img->comp, img->data, 0);
+    unsigned char *data = _img_to_8bit(img);
+    if (data == NULL) return 0;
+
+    int result = stbi_write_png(filename, img->width, img->height, img->comp, data, 0);
+    if (data != (unsigned char*) img->data) free(data);
+    return result;
 }
 
 
 /**
- * Store image in PNG format to memory
+ * Store image in PNG format to memory, 16-bit pixels are reduced to 8 bits
  * @param  img
  * @param  len Will be filled with number of bytes returned
  * @return NULL on failure, array of bytes on success
  */
 unsigned char *img_save_png_to_mem(img_image_t img, int *len) {
-    return stbi_write_png_to_mem(img->data, 0, img->width, img->height, img->comp, len);
+    unsigned char *data = _img_to_8bit(img);
+    if (data == NULL) return NULL;
+
+    unsigned char *png = stbi_write_png_to_mem(data, 0, img->width, img->height, img->comp, len);
+    if (data != (unsigned char*) img->data) free(data);
+    return png;
 }
 
 
@@ -173,130 +282,130 @@ void img_destroy(img_image_t img) {
 
 
 /**
- * Clears all data associated with image windows from memory
+ * Clears all data associated with padded image from memory
  * @param img
  */
-void img_windows_destroy(img_window_array_t arr) {
-    if (arr != NULL) free(arr->windows);
-    free(arr);
+void img_padded_destroy(img_padded_t img) {
+    if (img != NULL) free(img->buffer);
+    free(img);
 }
 
 
 /**
- * Clears all data associated with image windows from memory
- * @param img
+ * Returns size of memory holding padded image of given dimensions
+ * @param  width
+ * @param  height
+ * @return size in bytes
+ */
+size_t img_padded_size(int width, int height)
+{
+    return sizeof(img_pixel_t) * ((size_t) (width + 2) * (height + 2) + PADDED_TAIL_PIXELS);
+}
+
+
+/**
+ * Creates padded image over existing memory (e.g. mapped file) of
+ * `img_padded_size` bytes, which is not freed with the image
+ * @param  memory
+ * @param  width
+ * @param  height
+ * @return NULL on failure
  */
-void img_windows_simd_destroy(img_pixel_t *windows[WINDOW_SIZE]) {
-    if (windows != NULL) {
-        for (int i = 0; i < WINDOW_SIZE; i++) {
-            free(windows[i]);
+img_padded_t img_padded_view(img_pixel_t *memory, int width, int height)
+{
+    img_padded_t padded = (img_padded_t) malloc(sizeof(struct img_padded));
+    if (padded == NULL) return NULL;
+
+    int stride = width + 2;
+
+    padded->buffer = NULL;
+    padded->data = memory + stride + 1;
+    padded->width = width;
+    padded->height = height;
+    padded->stride = stride;
+
+    // neighbours row by row, from the top left one
+    int i = 0;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            padded->offsets[i++] = dy * stride + dx;
         }
     }
-}
 
+    return padded;
+}
 
 
 /**
- * Returns index of neighbour with given offset
- * @param  baseX
- * @param  baseY
- * @param  image width
- * @param  image height
- * @param  offX
- * @param  offY
+ * Returns memory of padded image (including border), `img_padded_size`
+ * bytes long
+ * @param  img
  * @return
  */
-static inline int get_neighbour_index(int baseX, int baseY, int width, int height, int offX, int offY) {
-    int x = baseX + offX;
-    int y = baseY + offY;
-    if (x < 0) x = 0;
-    if (y < 0) y = 0;
-    if (x >= width) x = width - 1;
-    if (y >= height) y = height - 1;
-    return (y * width) + x;
+img_pixel_t *img_padded_memory(img_padded_t img)
+{
+    return img->data - img->stride - 1;
 }
 
 
 /**
- * Splits image into windows
- * @param  filename
- * @return
+ * Creates padded copy of image with clamped border, memory after the last
+ * row is padded so that whole SIMD register can be loaded at any pixel
+ * @param  img
+ * @return NULL on failure
  */
-img_window_array_t img_split_windows(img_image_t img) {
-    int size = img->width * img->height;
-    img_window_t *windows = (img_window_t*) malloc(sizeof(img_window_t) * size);
-    if (windows == NULL) return NULL;
-
-    img_window_array_t arr = (img_window_array_t) malloc(sizeof(struct img_window_array));
-    if (arr == NULL) {
-        free(windows);
+img_padded_t img_pad(img_image_t img)
+{
+    int width = img->width;
+    int height = img->height;
+
+    img_pixel_t *memory = (img_pixel_t*) simd_alloc(img_padded_size(width, height));
+    if (memory == NULL) return NULL;
+
+    img_padded_t padded = img_padded_view(memory, width, height);
+    if (padded == NULL) {
+        free(memory);
         return NULL;
     }
-
-    arr->size = size;
-    arr->windows = windows;
-
-    for (int x = 0; x < img->width; x++) {
-        for (int y = 0; y < img->height; y++) {
-            int index = img_pixel_index(img, x, y);
-            windows[index].pos_x = x;
-            windows[index].pos_y = y;
-            windows[index].pixels[0] = img->data[get_neighbour_index(x, y, img->width, img->height, -1, -1)];
-            windows[index].pixels[1] = img->data[get_neighbour_index(x, y, img->width, img->height,  0, -1)];
-            windows[index].pixels[2] = img->data[get_neighbour_index(x, y, img->width, img->height, +1, -1)];
-            windows[index].pixels[3] = img->data[get_neighbour_index(x, y, img->width, img->height, -1,  0)];
-            windows[index].pixels[4] = img->data[get_neighbour_index(x, y, img->width, img->height,  0,  0)];
-            windows[index].pixels[5] = img->data[get_neighbour_index(x, y, img->width, img->height, +1,  0)];
-            windows[index].pixels[6] = img->data[get_neighbour_index(x, y, img->width, img->height, -1, +1)];
-            windows[index].pixels[7] = img->data[get_neighbour_index(x, y, img->width, img->height,  0, +1)];
-            windows[index].pixels[8] = img->data[get_neighbour_index(x, y, img->width, img->height, +1, +1)];
-        }
+    padded->buffer = memory;
+
+    // rows with clamped left and right border
+    for (int y = 0; y < height; y++) {
+        img_pixel_t *row = img_padded_pixel(padded, 0, y);
+        memcpy(row, &img->data[img_pixel_index(img, 0, y)], sizeof(img_pixel_t) * width);
+        row[-1] = row[0];
+        row[width] = row[width - 1];
     }
 
-    return arr;
+    // top and bottom border rows are copies of first and last row
+    int stride = padded->stride;
+    memcpy(memory, memory + stride, sizeof(img_pixel_t) * stride);
+    memcpy(memory + (size_t) stride * (height + 1),
+        memory + (size_t) stride * height, sizeof(img_pixel_t) * stride);
+
+    memset(memory + (size_t) stride * (height + 2), 0,
+        sizeof(img_pixel_t) * PADDED_TAIL_PIXELS);
+
+    return padded;
 }
 
 
 /**
- * Splits image into windows, suitably for SIMD processing
- * @param  filename
- * @return 0 on success
+ * Creates unpadded copy of padded image
+ * @param  img
+ * @return NULL on failure
  */
-int img_split_windows_simd(img_image_t img, img_pixel_t *out[WINDOW_SIZE])
+img_image_t img_unpad(img_padded_t img)
 {
-    // align length to 256bits
-    int size = img->width * img->height;
-    int padding = SIMD_PADDING_BYTES - (size % SIMD_PADDING_BYTES);
-
-    for (int i = 0; i < WINDOW_SIZE; i++) {
-        out[i] = (img_pixel_t*) simd_alloc(sizeof(img_pixel_t) * (size + padding));
-        if (out[i] == NULL) {
-            // TODO: dealloc
-            return -1;
-        }
-    }
+    img_image_t unpadded = img_create(img->width, img->height, COMP);
+    if (unpadded == NULL) return NULL;
 
-    for (int x = 0; x < img->width; x++) {
-        for (int y = 0; y < img->height; y++) {
-            int index = img_pixel_index(img, x, y);
-            out[0][index] = img->data[get_neighbour_index(x, y, img->width, img->height, -1, -1)];
-            out[1][index] = img->data[get_neighbour_index(x, y, img->width, img->height,  0, -1)];
-            out[2][index] = img->data[get_neighbour_index(x, y, img->width, img->height, +1, -1)];
-            out[3][index] = img->data[get_neighbour_index(x, y, img->width, img->height, -1,  0)];
-            out[4][index] = img->data[get_neighbour_index(x, y, img->width, img->height,  0,  0)];
-            out[5][index] = img->data[get_neighbour_index(x, y, img->width, img->height, +1,  0)];
-            out[6][index] = img->data[get_neighbour_index(x, y, img->width, img->height, -1, +1)];
-            out[7][index] = img->data[get_neighbour_index(x, y, img->width, img->height,  0, +1)];
-            out[8][index] = img->data[get_neighbour_index(x, y, img->width, img->height, +1, +1)];
-        }
+    for (int y = 0; y < img->height; y++) {
+        memcpy(&unpadded->data[img_pixel_index(unpadded, 0, y)],
+            img_padded_pixel(img, 0, y), sizeof(img_pixel_t) * img->width);
     }
 
-    // set padding bits to zero
-    for (int i = 0; i < 9; i++) {
-        memset(&(out[i][size]), 0, sizeof(img_pixel_t) * padding);
-    }
-
-    return 0;
+    return unpadded;
 }
 
 
@@ -314,15 +423,15 @@ double img_psnr(img_image_t original, img_image_t filtered)
     assert(original->height == filtered->height);
     assert(original->comp == filtered->comp);
 
-    double coef = 255.0 * 255.0 * original->width * original->height;
-    double sum = 0;
+    int width = original->width;
+    int height = original->height;
+    uint64_t sum = 0;
 
-    for (int x = 0; x < original->width; x++) {
-        for (int y = 0; y < original->height; y++) {
-            double diff = img_get_pixel(filtered, x, y) - img_get_pixel(original, x, y);
-            sum += diff * diff;
-        }
+    #pragma omp parallel for reduction(+:sum) schedule(static)
+    for (int y = 0; y < height; y++) {
+        sum += img_row_sqdiff(&original->data[img_pixel_index(original, 0, y)],
+            &filtered->data[img_pixel_index(filtered, 0, y)], width);
     }
 
-    return 10 * log10(coef / sum);
+    return img_psnr_from_sqdiff(sum, (double) width * height);
 }
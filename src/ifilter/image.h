@@ -22,12 +22,20 @@
 
 
 #include <stdio.h>
+#include <stdint.h>
+#include <math.h>
 
 
 #define WINDOW_SIZE 9
 #define WINDOW_CENTER 4
 
-typedef unsigned char img_pixel_t;
+#ifdef PIXEL16
+    typedef uint16_t img_pixel_t;
+    #define IMG_PIXEL_MAX 0xFFFF
+#else
+    typedef unsigned char img_pixel_t;
+    #define IMG_PIXEL_MAX 0xFF
+#endif
 
 
 struct img_image {
@@ -39,18 +47,21 @@ struct img_image {
 typedef struct img_image* img_image_t;
 
 
-typedef struct {
-    int pos_x;
-    int pos_y;
-    img_pixel_t pixels[WINDOW_SIZE];
-} img_window_t;
-
-
-typedef struct img_window_array {
-    int size;
-    img_window_t *windows;
-} _img_window_array;
-typedef struct img_window_array* img_window_array_t;
+/**
+ * Image surrounded by one-pixel border of clamped pixels, rows are
+ * `stride` pixels apart. Neighbours of any pixel are at fixed offsets
+ * from it, so window of consecutive pixels in a row can be loaded as
+ * shifted vectors.
+ */
+struct img_padded {
+    img_pixel_t *buffer; // owned memory, NULL if image is a view
+    img_pixel_t *data; // pixel (0, 0)
+    int width;
+    int height;
+    int stride;
+    int offsets[WINDOW_SIZE]; // window neighbours relative to centre
+};
+typedef struct img_padded* img_padded_t;
 
 
 /**
@@ -62,7 +73,8 @@ img_image_t img_create(int width, int height, int comp);
 
 
 /**
- * Loads image from file
+ * Loads image from file. Binary PGM images are read with their full
+ * sample depth, other formats are decoded by stb_image as 8-bit.
  * @param  filename
  * @return
  */
@@ -79,7 +91,7 @@ void img_copy(img_image_t dest, img_image_t src);
 
 
 /**
- * Loads image from stream
+ * Loads image from stream, it is decoded by stb_image as 8-bit
  * @param  filename
  * @return
  */
@@ -87,22 +99,53 @@ img_image_t img_load_stream(FILE *file);
 
 
 /**
- * Splits image into windows
- * @param  filename
- * @return
+ * Creates padded copy of image with clamped border, memory after the last
+ * row is padded so that whole SIMD register can be loaded at any pixel
+ * @param  img
+ * @return NULL on failure
+ */
+img_padded_t img_pad(img_image_t img);
+
+
+/**
+ * Returns size of memory holding padded image of given dimensions
+ * @param  width
+ * @param  height
+ * @return size in bytes
  */
-img_window_array_t img_split_windows(img_image_t img);
+size_t img_padded_size(int width, int height);
 
 
 /**
- * Splits image into windows, suitably for SIMD processing
+ * Creates padded image over existing memory (e.g. mapped file) of
+ * `img_padded_size` bytes, which is not freed with the image
+ * @param  memory
+ * @param  width
+ * @param  height
+ * @return NULL on failure
+ */
+img_padded_t img_padded_view(img_pixel_t *memory, int width, int height);
+
+
+/**
+ * Returns memory of padded image (including border), `img_padded_size`
+ * bytes long
+ * @param  img
  * @return
  */
-int img_split_windows_simd(img_image_t img, img_pixel_t *out[WINDOW_SIZE]);
+img_pixel_t *img_padded_memory(img_padded_t img);
 
 
 /**
- * Store image to BMP file
+ * Creates unpadded copy of padded image
+ * @param  img
+ * @return NULL on failure
+ */
+img_image_t img_unpad(img_padded_t img);
+
+
+/**
+ * Store image to BMP file, 16-bit pixels are reduced to 8 bits
  * @param  img
  * @return 0 on failure, non-zero on success
  */
@@ -110,7 +153,7 @@ int img_save_bmp(img_image_t img, char const *filename);
 
 
 /**
- * Store image to PNG file
+ * Store image to PNG file, 16-bit pixels are reduced to 8 bits
  * @param  img
  * @return 0 on failure, non-zero on success
  */
@@ -118,7 +161,7 @@ int img_save_png(img_image_t img, char const *filename);
 
 
 /**
- * Store image in PNG format to memory
+ * Store image in PNG format to memory, 16-bit pixels are reduced to 8 bits
  * @param  img
  * @param  len Will be filled with number of bytes returned
  * @return NULL on failure, array of bytes on success
@@ -134,17 +177,10 @@ void img_destroy(img_image_t img);
 
 
 /**
- * Clears all data associated with image windows from memory
+ * Clears all data associated with padded image from memory
  * @param img
  */
-void img_windows_destroy(img_window_array_t arr);
-
-
-/**
- * Clears all data associated with image windows from memory
- * @param img
- */
-void img_windows_simd_destroy(img_pixel_t *windows[WINDOW_SIZE]);
+void img_padded_destroy(img_padded_t img);
 
 
 /**
@@ -158,6 +194,34 @@ void img_windows_simd_destroy(img_pixel_t *windows[WINDOW_SIZE]);
 double img_psnr(img_image_t original, img_image_t filtered);
 
 
+/**
+ * Returns sum of squared differences of two rows of pixels
+ * @param  a
+ * @param  b
+ * @param  width
+ */
+static inline uint64_t img_row_sqdiff(img_pixel_t *a, img_pixel_t *b, int width) {
+    uint64_t sum = 0;
+    // square of 16-bit difference still fits unsigned 32 bits
+    #pragma omp simd reduction(+:sum)
+    for (int x = 0; x < width; x++) {
+        uint32_t diff = (a[x] > b[x]) ? a[x] - b[x] : b[x] - a[x];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+
+/**
+ * Calculates PSNR from sum of squared differences
+ * @param  sum
+ * @param  pixels Number of compared pixels
+ */
+static inline double img_psnr_from_sqdiff(uint64_t sum, double pixels) {
+    return 10 * log10((double) IMG_PIXEL_MAX * IMG_PIXEL_MAX * pixels / sum);
+}
+
+
 /**
  * Returns 1-D index in data array of given pixel
  * @param img
@@ -183,3 +247,25 @@ static inline img_pixel_t img_get_pixel(img_image_t img, int x, int y) {
 static inline void img_set_pixel(img_image_t img, int x, int y, img_pixel_t value) {
     img->data[img_pixel_index(img, x, y)] = value;
 }
+
+
+/**
+ * Returns pointer to given pixel of padded image
+ * @param img
+ */
+static inline img_pixel_t *img_padded_pixel(img_padded_t img, int x, int y) {
+    return &img->data[(y * img->stride) + x];
+}
+
+
+/**
+ * Fills window of given pixel of padded image, neighbours go row by row
+ * from the top left one
+ * @param img
+ */
+static inline void img_padded_window(img_padded_t img, int x, int y, img_pixel_t window[WINDOW_SIZE]) {
+    img_pixel_t *centre = img_padded_pixel(img, x, y);
+    for (int i = 0; i < WINDOW_SIZE; i++) {
+        window[i] = centre[img->offsets[i]];
+    }
+}
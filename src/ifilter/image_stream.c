@@ -0,0 +1,609 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "image_stream.h"
+#include "image.h"
+
+
+// larger values are stored as two bytes per sample
+static const int PGM_MAXVAL_8BIT = 255;
+static const int PGM_MAXVAL_16BIT = 65535;
+
+// PNG scanlines are written in IDAT chunks of about this size
+#define PNG_CHUNK_BYTES (256 * 1024)
+
+// largest deflate stored block
+#define PNG_STORED_BLOCK 65535
+
+static const unsigned char PNG_SIGNATURE[] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+};
+
+// zlib header - deflate, 32K window, no compression
+static const unsigned char PNG_ZLIB_HEADER[] = { 0x78, 0x01 };
+
+static const char * const IMG_FORMAT_NAMES[] = {
+    "png",
+    "fastpng",
+    "pgm",
+    "raw",
+};
+
+static const char * const IMG_FORMAT_EXTENSIONS[] = {
+    ".png",
+    ".png",
+    ".pgm",
+    ".raw",
+};
+
+
+/**
+ * Reads one number from PGM header, skipping whitespace and comments
+ * @param  file
+ * @param  value
+ * @return 0 on success
+ */
+static int _pgm_read_header_int(FILE *file, int *value)
+{
+    int c = fgetc(file);
+    while (c != EOF && (isspace(c) || c == '#')) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') c = fgetc(file);
+        }
+        c = fgetc(file);
+    }
+
+    if (!isdigit(c)) return -1;
+
+    long number = 0;
+    while (isdigit(c)) {
+        number = number * 10 + (c - '0');
+        if (number > 0x7FFFFFFF) return -1;
+        c = fgetc(file);
+    }
+
+    // exactly one whitespace character follows the number
+    if (c == EOF || !isspace(c)) return -1;
+
+    *value = number;
+    return 0;
+}
+
+
+/**
+ * Returns number of bytes of one sample in file
+ */
+static inline int _pgm_sample_size(img_stream_t stream)
+{
+    return (stream->maxval > PGM_MAXVAL_8BIT) ? 2 : 1;
+}
+
+
+/**
+ * Allocates row buffer in file format, unless pixels can be read and
+ * written directly
+ * @param  stream
+ * @return 0 on success
+ */
+static int _pgm_alloc_raw(img_stream_t stream)
+{
+    stream->raw = NULL;
+    if (stream->maxval == IMG_PIXEL_MAX
+        && _pgm_sample_size(stream) == 1 && sizeof(img_pixel_t) == 1)
+    {
+        return 0;
+    }
+
+    stream->raw = (unsigned char*) malloc(
+        (size_t) stream->width * _pgm_sample_size(stream));
+    return (stream->raw == NULL) ? -1 : 0;
+}
+
+
+/**
+ * Opens binary PGM (P5) image for reading row by row, reads its header.
+ * Samples are rescaled to full pixel range if maximum value in file
+ * differs from IMG_PIXEL_MAX.
+ * @param  file
+ * @return NULL on failure
+ */
+img_stream_t img_stream_open_pgm(FILE *file)
+{
+    img_stream_t stream = (img_stream_t) malloc(sizeof(struct img_stream));
+    if (stream == NULL) {
+        fprintf(stderr, "img_stream_open_pgm: cannot malloc\n");
+        return NULL;
+    }
+
+    stream->file = file;
+    stream->rows = 0;
+    stream->format = IMG_FORMAT_PGM;
+    stream->chunk = NULL;
+
+    if (fgetc(file) != 'P' || fgetc(file) != '5') {
+        fprintf(stderr, "Only binary PGM (P5) images can be streamed.\n");
+        free(stream);
+        return NULL;
+    }
+
+    if (_pgm_read_header_int(file, &stream->width)
+        || _pgm_read_header_int(file, &stream->height)
+        || _pgm_read_header_int(file, &stream->maxval)
+        || stream->width <= 0 || stream->height <= 0)
+    {
+        fprintf(stderr, "Invalid PGM header.\n");
+        free(stream);
+        return NULL;
+    }
+
+    if (stream->maxval <= 0 || stream->maxval > PGM_MAXVAL_16BIT) {
+        fprintf(stderr, "Only 8-bit and 16-bit PGM images are supported.\n");
+        free(stream);
+        return NULL;
+    }
+
+    if (_pgm_alloc_raw(stream)) {
+        fprintf(stderr, "img_stream_open_pgm: cannot malloc\n");
+        free(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+/* PNG ************************************************************************/
+
+
+/**
+ * Updates CRC-32 used by PNG chunks, processes half a byte at a time
+ */
+static uint32_t _png_crc(uint32_t crc, unsigned char const *data, size_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+
+/**
+ * Updates Adler-32 checksum of zlib stream
+ */
+static uint32_t _png_adler(uint32_t adler, unsigned char const *data, size_t length)
+{
+    // largest number of bytes before sums have to be reduced
+    static const size_t NMAX = 5552;
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    while (length > 0) {
+        size_t block = (length < NMAX) ? length : NMAX;
+        length -= block;
+        for (size_t i = 0; i < block; i++) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+
+static inline void _png_put_u32(unsigned char out[4], uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+
+/**
+ * Writes part of chunk data, updating its CRC
+ * @return 0 on success
+ */
+static int _png_write(img_stream_t stream, unsigned char const *data,
+    size_t length, uint32_t *crc)
+{
+    *crc = _png_crc(*crc, data, length);
+    return fwrite(data, 1, length, stream->file) == length ? 0 : -1;
+}
+
+
+/**
+ * Writes chunk header, CRC covers chunk type and data
+ * @return 0 on success
+ */
+static int _png_begin_chunk(img_stream_t stream, char const type[4],
+    size_t length, uint32_t *crc)
+{
+    unsigned char header[4];
+    _png_put_u32(header, length);
+    *crc = 0;
+    if (fwrite(header, 1, 4, stream->file) != 4) return -1;
+    return _png_write(stream, (unsigned char const*) type, 4, crc);
+}
+
+
+static int _png_end_chunk(img_stream_t stream, uint32_t crc)
+{
+    unsigned char footer[4];
+    _png_put_u32(footer, crc);
+    return fwrite(footer, 1, 4, stream->file) == 4 ? 0 : -1;
+}
+
+
+/**
+ * Writes signature and IHDR chunk of 8-bit grayscale image
+ * @return 0 on success
+ */
+static int _png_write_header(img_stream_t stream)
+{
+    unsigned char ihdr[13];
+    _png_put_u32(ihdr, stream->width);
+    _png_put_u32(ihdr + 4, stream->height);
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = 0; // grayscale
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering, all rows use none
+    ihdr[12] = 0; // not interlaced
+
+    uint32_t crc;
+    int failed = fwrite(PNG_SIGNATURE, 1, sizeof(PNG_SIGNATURE), stream->file)
+        != sizeof(PNG_SIGNATURE);
+    failed = failed || _png_begin_chunk(stream, "IHDR", sizeof(ihdr), &crc)
+        || _png_write(stream, ihdr, sizeof(ihdr), &crc)
+        || _png_end_chunk(stream, crc);
+    return failed ? -1 : 0;
+}
+
+
+/**
+ * Writes buffered scanlines as IDAT chunk of stored deflate blocks. First
+ * chunk starts zlib stream, the last one ends it and is followed by IEND.
+ * @return 0 on success
+ */
+static int _png_write_idat(img_stream_t stream, bool last)
+{
+    size_t length = stream->chunk_length;
+    size_t blocks = (length + PNG_STORED_BLOCK - 1) / PNG_STORED_BLOCK;
+    // chunk holds all scanlines written so far
+    bool first = (size_t) (stream->rows + 1) * (stream->width + 1) == length;
+    size_t chunk_size = (first ? sizeof(PNG_ZLIB_HEADER) : 0)
+        + 5 * blocks + length + (last ? 4 : 0);
+
+    stream->adler = _png_adler(stream->adler, stream->chunk, length);
+
+    uint32_t crc;
+    if (_png_begin_chunk(stream, "IDAT", chunk_size, &crc)) return -1;
+    if (first && _png_write(stream, PNG_ZLIB_HEADER, sizeof(PNG_ZLIB_HEADER), &crc)) {
+        return -1;
+    }
+
+    for (size_t offset = 0; offset < length; offset += PNG_STORED_BLOCK) {
+        size_t block = length - offset;
+        if (block > PNG_STORED_BLOCK) block = PNG_STORED_BLOCK;
+
+        // final flag, stored block type, little-endian length and its complement
+        unsigned char header[5] = {
+            last && offset + block == length,
+            block & 0xFF, block >> 8,
+            ~block & 0xFF, (~block >> 8) & 0xFF,
+        };
+        if (_png_write(stream, header, sizeof(header), &crc)
+            || _png_write(stream, stream->chunk + offset, block, &crc))
+        {
+            return -1;
+        }
+    }
+
+    if (last) {
+        unsigned char adler[4];
+        _png_put_u32(adler, stream->adler);
+        if (_png_write(stream, adler, sizeof(adler), &crc)) return -1;
+    }
+
+    if (_png_end_chunk(stream, crc)) return -1;
+    stream->chunk_length = 0;
+
+    if (last) {
+        if (_png_begin_chunk(stream, "IEND", 0, &crc)
+            || _png_end_chunk(stream, crc))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Buffers one scanline, buffered scanlines are written when there is no
+ * space for another one or when the image is complete
+ * @return 0 on success
+ */
+static int _png_write_row(img_stream_t stream, img_pixel_t *row)
+{
+    unsigned char *scanline = stream->chunk + stream->chunk_length;
+    scanline[0] = 0; // filter type none
+    for (int x = 0; x < stream->width; x++) {
+        // 16-bit pixels are reduced to their high byte, as in img_save_png
+        scanline[x + 1] = row[x] >> (8 * (sizeof(img_pixel_t) - 1));
+    }
+    stream->chunk_length += stream->width + 1;
+
+    bool last = stream->rows == stream->height - 1;
+    if (last || stream->chunk_length + stream->width + 1 > stream->chunk_capacity) {
+        return _png_write_idat(stream, last);
+    }
+    return 0;
+}
+
+
+/* writing ********************************************************************/
+
+
+/**
+ * Starts writing binary PGM (P5) image row by row, writes its header,
+ * maximum sample value is IMG_PIXEL_MAX
+ * @param  file
+ * @param  width
+ * @param  height
+ * @return NULL on failure
+ */
+img_stream_t img_stream_create_pgm(FILE *file, int width, int height)
+{
+    return img_stream_create(file, width, height, IMG_FORMAT_PGM);
+}
+
+
+/**
+ * Starts writing image row by row in given format, writes its header.
+ * PNG image is finished when its last row is written.
+ * @param  file
+ * @param  width
+ * @param  height
+ * @param  format Any but IMG_FORMAT_PNG
+ * @return NULL on failure
+ */
+img_stream_t img_stream_create(FILE *file, int width, int height,
+    img_format_t format)
+{
+    if (format == IMG_FORMAT_PNG) {
+        fprintf(stderr, "Compressed PNG image cannot be written row by row.\n");
+        return NULL;
+    }
+
+    img_stream_t stream = (img_stream_t) malloc(sizeof(struct img_stream));
+    if (stream == NULL) {
+        fprintf(stderr, "img_stream_create: cannot malloc\n");
+        return NULL;
+    }
+
+    stream->file = file;
+    stream->width = width;
+    stream->height = height;
+    stream->rows = 0;
+    stream->maxval = IMG_PIXEL_MAX;
+    stream->format = format;
+    stream->chunk = NULL;
+    stream->chunk_length = 0;
+    stream->adler = 1;
+
+    if (format == IMG_FORMAT_FASTPNG) {
+        // whole scanlines, at least one
+        size_t scanline = (size_t) width + 1;
+        size_t scanlines = PNG_CHUNK_BYTES / scanline;
+        stream->raw = NULL;
+        stream->chunk_capacity = scanline * (scanlines ? scanlines : 1);
+        stream->chunk = (unsigned char*) malloc(stream->chunk_capacity);
+        if (stream->chunk == NULL) {
+            fprintf(stderr, "img_stream_create: cannot malloc\n");
+            free(stream);
+            return NULL;
+        }
+
+    } else if (_pgm_alloc_raw(stream)) {
+        fprintf(stderr, "img_stream_create: cannot malloc\n");
+        free(stream);
+        return NULL;
+    }
+
+    int failed = 0;
+    if (format == IMG_FORMAT_FASTPNG) {
+        failed = _png_write_header(stream);
+    } else if (format == IMG_FORMAT_PGM) {
+        failed = fprintf(file, "P5\n%d %d\n%d\n", width, height, stream->maxval) < 0;
+    }
+
+    if (failed) {
+        img_stream_destroy(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+/**
+ * Writes whole image in given format
+ * @param  file
+ * @param  img
+ * @param  format
+ * @return 0 on success
+ */
+int img_stream_write_image(FILE *file, img_image_t img, img_format_t format)
+{
+    if (format == IMG_FORMAT_PNG) {
+        int len;
+        unsigned char *png = img_save_png_to_mem(img, &len);
+        if (png == NULL) return -1;
+
+        size_t written = fwrite(png, 1, len, file);
+        free(png);
+        return written == (size_t) len ? 0 : -1;
+    }
+
+    img_stream_t stream = img_stream_create(file, img->width, img->height, format);
+    if (stream == NULL) return -1;
+
+    int result = 0;
+    for (int y = 0; y < img->height && result == 0; y++) {
+        result = img_stream_write_row(stream, &img->data[img_pixel_index(img, 0, y)]);
+    }
+
+    img_stream_destroy(stream);
+    return result;
+}
+
+
+/**
+ * Parses output format name: `png`, `fastpng`, `pgm` or `raw`
+ * @param  name
+ * @param  format
+ * @return 0 on success
+ */
+int img_parse_format(char const *name, img_format_t *format)
+{
+    int count = sizeof(IMG_FORMAT_NAMES) / sizeof(IMG_FORMAT_NAMES[0]);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, IMG_FORMAT_NAMES[i]) == 0) {
+            *format = (img_format_t) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Returns filename extension of format, including the dot
+ * @param  format
+ * @return
+ */
+char const *img_format_extension(img_format_t format)
+{
+    return IMG_FORMAT_EXTENSIONS[format];
+}
+
+
+/**
+ * Reads next image row
+ * @param  stream
+ * @param  row Buffer of stream->width pixels
+ * @return 0 on success
+ */
+int img_stream_read_row(img_stream_t stream, img_pixel_t *row)
+{
+    if (stream->rows >= stream->height) return -1;
+
+    if (stream->raw == NULL) {
+        size_t read = fread(row, sizeof(img_pixel_t), stream->width, stream->file);
+        if (read != (size_t) stream->width) return -1;
+
+    } else {
+        int sample_size = _pgm_sample_size(stream);
+        size_t read = fread(stream->raw, sample_size, stream->width, stream->file);
+        if (read != (size_t) stream->width) return -1;
+
+        long maxval = stream->maxval;
+        for (int x = 0; x < stream->width; x++) {
+            // 16-bit samples are big-endian
+            long value = (sample_size == 1) ? stream->raw[x]
+                : (stream->raw[2 * x] << 8) | stream->raw[2 * x + 1];
+            if (value > maxval) value = maxval;
+            if (maxval != IMG_PIXEL_MAX) {
+                value = (value * IMG_PIXEL_MAX + maxval / 2) / maxval;
+            }
+            row[x] = value;
+        }
+    }
+
+    stream->rows++;
+    return 0;
+}
+
+
+/**
+ * Writes next image row
+ * @param  stream
+ * @param  row Buffer of stream->width pixels
+ * @return 0 on success
+ */
+int img_stream_write_row(img_stream_t stream, img_pixel_t *row)
+{
+    if (stream->rows >= stream->height) return -1;
+
+    if (stream->format == IMG_FORMAT_FASTPNG) {
+        if (_png_write_row(stream, row)) return -1;
+        stream->rows++;
+        return 0;
+    }
+
+    size_t written;
+    if (stream->raw == NULL) {
+        written = fwrite(row, sizeof(img_pixel_t), stream->width, stream->file);
+
+    } else {
+        // only 16-bit pixels are not written directly
+        for (int x = 0; x < stream->width; x++) {
+            stream->raw[2 * x] = row[x] >> 8;
+            stream->raw[2 * x + 1] = row[x] & 0xFF;
+        }
+        written = fwrite(stream->raw, 2, stream->width, stream->file);
+    }
+    if (written != (size_t) stream->width) return -1;
+
+    stream->rows++;
+    return 0;
+}
+
+
+/**
+ * Clears stream from memory, underlying file is not closed
+ * @param stream
+ */
+void img_stream_destroy(img_stream_t stream)
+{
+    if (stream != NULL) {
+        free(stream->raw);
+        free(stream->chunk);
+    }
+    free(stream);
+}
@@ -0,0 +1,147 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#pragma once
+
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "image.h"
+
+
+/**
+ * Output image formats
+ */
+typedef enum {
+    IMG_FORMAT_PNG, // compressed by stb_image_write, needs whole image
+    IMG_FORMAT_FASTPNG, // uncompressed deflate blocks, no row filters
+    IMG_FORMAT_PGM, // binary PGM (P5)
+    IMG_FORMAT_RAW, // PGM samples without header
+} img_format_t;
+
+
+/**
+ * Image read or written row by row, only the header is kept in memory
+ */
+struct img_stream {
+    FILE *file;
+    int width;
+    int height;
+    int rows; // number of rows read or written so far
+    int maxval; // maximum sample value in file
+    unsigned char *raw; // row in file format, NULL if same as pixels
+    img_format_t format; // of written image
+
+    // PNG scanlines not written yet, they are written in chunks
+    unsigned char *chunk;
+    size_t chunk_length;
+    size_t chunk_capacity;
+    uint32_t adler; // checksum of all scanlines
+};
+typedef struct img_stream* img_stream_t;
+
+
+/**
+ * Opens binary PGM (P5) image for reading row by row, reads its header.
+ * Samples are rescaled to full pixel range if maximum value in file
+ * differs from IMG_PIXEL_MAX.
+ * @param  file
+ * @return NULL on failure
+ */
+img_stream_t img_stream_open_pgm(FILE *file);
+
+
+/**
+ * Starts writing binary PGM (P5) image row by row, writes its header,
+ * maximum sample value is IMG_PIXEL_MAX
+ * @param  file
+ * @param  width
+ * @param  height
+ * @return NULL on failure
+ */
+img_stream_t img_stream_create_pgm(FILE *file, int width, int height);
+
+
+/**
+ * Starts writing image row by row in given format, writes its header.
+ * PNG image is finished when its last row is written.
+ * @param  file
+ * @param  width
+ * @param  height
+ * @param  format Any but IMG_FORMAT_PNG
+ * @return NULL on failure
+ */
+img_stream_t img_stream_create(FILE *file, int width, int height,
+    img_format_t format);
+
+
+/**
+ * Writes whole image in given format
+ * @param  file
+ * @param  img
+ * @param  format
+ * @return 0 on success
+ */
+int img_stream_write_image(FILE *file, img_image_t img, img_format_t format);
+
+
+/**
+ * Parses output format name: `png`, `fastpng`, `pgm` or `raw`
+ * @param  name
+ * @param  format
+ * @return 0 on success
+ */
+int img_parse_format(char const *name, img_format_t *format);
+
+
+/**
+ * Returns filename extension of format, including the dot
+ * @param  format
+ * @return
+ */
+char const *img_format_extension(img_format_t format);
+
+
+/**
+ * Reads next image row
+ * @param  stream
+ * @param  row Buffer of stream->width pixels
+ * @return 0 on success
+ */
+int img_stream_read_row(img_stream_t stream, img_pixel_t *row);
+
+
+/**
+ * Writes next image row
+ * @param  stream
+ * @param  row Buffer of stream->width pixels
+ * @return 0 on success
+ */
+int img_stream_write_row(img_stream_t stream, img_pixel_t *row);
+
+
+/**
+ * Clears stream from memory, underlying file is not closed
+ * @param stream
+ */
+void img_stream_destroy(img_stream_t stream);
+
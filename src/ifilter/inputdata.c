@@ -18,43 +18,295 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "../cpu.h"
 #include "../inputdata.h"
+#include "../utils.h"
+#include "datacache.h"
 
 
-bool input_data_load(input_data_t *data, config_t *config)
+/**
+ * Filenames of one pair of original and noisy image
+ */
+typedef struct {
+    char original[MAX_FILENAME_LENGTH + 1];
+    char noisy[MAX_FILENAME_LENGTH + 1];
+} input_files_t;
+
+
+/**
+ * Loads one pair of original and noisy image
+ *
+ * @param  image
+ * @param  files
+ * @param  loaded Output, loaded original image
+ * @return Whether both images were loaded
+ */
+static bool _input_data_load_pair(input_image_t *image, input_files_t *files,
+    img_image_t *loaded)
 {
-    if ((data->img_original = img_load(config->input_image)) == NULL) {
-        fprintf(stderr, "Failed to load original image or no filename given.\n");
+    if ((*loaded = img_load(files->original)) == NULL) {
+        fprintf(stderr, "Failed to load original image '%s'.\n", files->original);
         return false;
     }
 
-    if ((data->img_noisy = img_load(config->noisy_image)) == NULL) {
-        fprintf(stderr, "Failed to load noisy image or no filename given.\n");
+    img_image_t noisy = img_load(files->noisy);
+    if (noisy == NULL) {
+        fprintf(stderr, "Failed to load noisy image '%s'.\n", files->noisy);
         return false;
     }
 
-    assert(data->img_original->width == data->img_noisy->width);
-    assert(data->img_original->height == data->img_noisy->height);
-    assert(data->img_original->comp == data->img_noisy->comp);
+    if ((*loaded)->width != noisy->width || (*loaded)->height != noisy->height) {
+        fprintf(stderr, "Images %s and %s have different size.\n",
+            files->original, files->noisy);
+        img_destroy(noisy);
+        return false;
+    }
+    assert((*loaded)->comp == noisy->comp);
 
-    data->img_noisy_windows = img_split_windows(data->img_noisy);
+    image->noisy_padded = img_pad(noisy);
+    img_destroy(noisy);
 
-    if (can_use_simd()) {
-        img_split_windows_simd(data->img_noisy, data->img_noisy_simd);
+    if (image->noisy_padded == NULL) {
+        fprintf(stderr, "Failed to allocate memory for noisy image.\n");
+        return false;
     }
 
-    data->fitness_cases = data->img_original->width * data->img_original->height;
+    image->original = **loaded;
+    image->original.data = NULL;
     return true;
 }
 
 
+/**
+ * Resolves filename from image list - relative paths are relative to
+ * the list itself
+ *
+ * @param  list List filename
+ * @param  filename
+ * @param  out
+ */
+static void _input_data_resolve_path(char const *list, char const *filename,
+    char out[MAX_FILENAME_LENGTH + 1])
+{
+    char const *slash = strrchr(list, '/');
+
+    if (filename[0] == '/' || slash == NULL) {
+        snprintf(out, MAX_FILENAME_LENGTH + 1, "%s", filename);
+    } else {
+        snprintf(out, MAX_FILENAME_LENGTH + 1, "%.*s/%s",
+            (int) (slash - list), list, filename);
+    }
+}
+
+
+/**
+ * Reads image pairs listed in file, each line contains original and noisy
+ * image filename separated by whitespace. Empty lines and lines starting
+ * with `#` are ignored.
+ *
+ * @param  list List filename
+ * @param  files Output, filenames (allocated)
+ * @param  count Output, number of pairs
+ * @return Whether list was read
+ */
+static bool _input_data_read_list(char const *list, input_files_t **files,
+    int *count)
+{
+    FILE *file = fopen(list, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open image list %s.\n", list);
+        return false;
+    }
+
+    int capacity = 0;
+    int line_number = 0;
+    char line[2 * MAX_FILENAME_LENGTH + 4];
+    bool success = true;
+
+    while (success && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+
+        char *original = strtok(line, " \t\r\n");
+        if (original == NULL || original[0] == '#') {
+            continue;
+        }
+
+        char *noisy = strtok(NULL, " \t\r\n");
+        if (noisy == NULL || strtok(NULL, " \t\r\n") != NULL) {
+            fprintf(stderr, "Invalid line %d in image list %s.\n",
+                line_number, list);
+            success = false;
+            break;
+        }
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            input_files_t *resized = (input_files_t*) realloc(*files,
+                sizeof(input_files_t) * capacity);
+            if (resized == NULL) {
+                fprintf(stderr, "Failed to allocate memory for image list.\n");
+                success = false;
+                break;
+            }
+            *files = resized;
+        }
+
+        input_files_t *pair = &(*files)[(*count)++];
+        _input_data_resolve_path(list, original, pair->original);
+        _input_data_resolve_path(list, noisy, pair->noisy);
+    }
+
+    fclose(file);
+
+    if (success && *count == 0) {
+        fprintf(stderr, "Image list %s is empty.\n", list);
+        success = false;
+    }
+    return success;
+}
+
+
+/**
+ * Decodes images and concatenates original images into one array of
+ * fitness cases
+ *
+ * @param  data
+ * @param  files
+ * @param  count
+ * @return Whether all images were loaded
+ */
+static bool _input_data_decode(input_data_t *data, input_files_t *files,
+    int count)
+{
+    data->images = (input_image_t*) calloc(count, sizeof(input_image_t));
+    img_image_t *loaded = (img_image_t*) calloc(count, sizeof(img_image_t));
+    bool success = data->images != NULL && loaded != NULL;
+
+    for (int i = 0; success && i < count; i++) {
+        data->images_count = i + 1;
+        success = _input_data_load_pair(&data->images[i], &files[i], &loaded[i]);
+    }
+
+    if (success) {
+        size_t cases = 0;
+        for (int i = 0; i < count; i++) {
+            data->images[i].offset = cases;
+            cases += (size_t) loaded[i]->width * loaded[i]->height;
+        }
+
+        data->fitness_cases = cases;
+        data->original = (img_pixel_t*) malloc(sizeof(img_pixel_t) * cases);
+        if (data->original == NULL) {
+            fprintf(stderr, "Failed to allocate memory for original images.\n");
+            success = false;
+        }
+    }
+
+    for (int i = 0; success && i < count; i++) {
+        input_image_t *image = &data->images[i];
+        image->original.data = data->original + image->offset;
+        memcpy(image->original.data, loaded[i]->data,
+            sizeof(img_pixel_t) * loaded[i]->width * loaded[i]->height);
+    }
+
+    if (loaded != NULL) {
+        for (int i = 0; i < count; i++) {
+            img_destroy(loaded[i]);
+        }
+        free(loaded);
+    }
+    return success;
+}
+
+
+/**
+ * Computes dataset cache key of images
+ *
+ * @param  files
+ * @param  count
+ * @param  key
+ * @return Whether all files were read
+ */
+static bool _input_data_cache_key(input_files_t *files, int count,
+    uint64_t *key)
+{
+    char const *filenames[2 * count];
+    for (int i = 0; i < count; i++) {
+        filenames[2 * i] = files[i].original;
+        filenames[2 * i + 1] = files[i].noisy;
+    }
+    return datacache_key(filenames, 2 * count, key);
+}
+
+
+bool input_data_load(input_data_t *data, config_t *config)
+{
+    input_files_t *files = NULL;
+    int count = 0;
+    bool success;
+
+    data->images_count = 0;
+    data->images = NULL;
+    data->original = NULL;
+    data->mapping = NULL;
+    data->mapping_size = 0;
+
+    if (config->images_list[0] != '\0') {
+        success = _input_data_read_list(config->images_list, &files, &count);
+
+    } else {
+        files = (input_files_t*) malloc(sizeof(input_files_t));
+        success = files != NULL;
+
+        if (success) {
+            count = 1;
+            snprintf(files->original, MAX_FILENAME_LENGTH + 1, "%s", config->input_image);
+            snprintf(files->noisy, MAX_FILENAME_LENGTH + 1, "%s", config->noisy_image);
+        }
+    }
+
+    if (!success) {
+        free(files);
+        return false;
+    }
+
+    // preprocessed images are shared by all runs with the same input files
+    char const *cache_dir = config->dataset_cache;
+    uint64_t key = 0;
+    bool use_cache = cache_dir[0] != '\0'
+        && _input_data_cache_key(files, count, &key);
+
+    if (use_cache && datacache_load(data, cache_dir, key)) {
+        free(files);
+        return true;
+    }
+
+    success = _input_data_decode(data, files, count);
+
+    if (success && use_cache && !datacache_save(data, cache_dir, key)) {
+        fprintf(stderr, "Failed to write dataset cache to %s.\n", cache_dir);
+    }
+
+    free(files);
+    return success;
+}
+
+
 
 void input_data_destroy(input_data_t *data)
 {
-    img_destroy(data->img_original);
-    img_destroy(data->img_noisy);
+    for (int i = 0; i < data->images_count; i++) {
+        img_padded_destroy(data->images[i].noisy_padded);
+    }
+    free(data->images);
+
+    if (data->mapping != NULL) {
+        datacache_release(data);
+    } else {
+        free(data->original);
+    }
 }
 
 
@@ -62,23 +314,28 @@ void input_data_destroy(input_data_t *data)
  * Filters noisy image using given filter. Caller is responsible for freeing
  * the filtered image
  *
+ * @param  data
+ * @param  image Image index
  * @param  chr
  * @return filtered image
  */
-img_image_t input_data_filter(input_data_t *data, ga_chr_t chr)
+img_image_t input_data_filter(input_data_t *data, int image, ga_chr_t chr)
 {
+    input_image_t *img = &data->images[image];
     img_image_t filtered = img_create(
-        data->img_original->width,
-        data->img_original->height,
-        data->img_original->comp);
+        img->original.width,
+        img->original.height,
+        img->original.comp);
 
     if (filtered) {
-        for (int i = 0; i < data->fitness_cases; i++) {
-            img_window_t *w = &data->img_noisy_windows->windows[i];
-            cgp_value_t *inputs = w->pixels;
-            cgp_value_t output_pixel;
-            cgp_get_output(chr, inputs, &output_pixel);
-            img_set_pixel(filtered, w->pos_x, w->pos_y, output_pixel);
+        for (int y = 0; y < filtered->height; y++) {
+            for (int x = 0; x < filtered->width; x++) {
+                cgp_value_t inputs[WINDOW_SIZE];
+                cgp_value_t output_pixel;
+                img_padded_window(img->noisy_padded, x, y, inputs);
+                cgp_get_output(chr, inputs, &output_pixel);
+                img_set_pixel(filtered, x, y, output_pixel);
+            }
         }
     }
 
@@ -24,21 +24,82 @@
 #include "image.h"
 
 
+/**
+ * One training pair of original and noisy image
+ */
+typedef struct {
+    struct img_image original; // pixels are stored in `input_data.original`
+    img_padded_t noisy_padded;
+    int offset; // index of first fitness case
+} input_image_t;
+
+
 struct _input_data {
     unsigned int fitness_cases;
-    img_image_t img_original;
-    img_image_t img_noisy;
 
-    img_window_array_t img_noisy_windows;
-    img_pixel_t *img_noisy_simd[WINDOW_SIZE];
+    /* fitness cases of all images follow each other */
+    int images_count;
+    input_image_t *images;
+    img_pixel_t *original;
+
+    /* dataset cache file, images point into it if it is mapped */
+    void *mapping;
+    size_t mapping_size;
 };
 
 
+/**
+ * Returns image holding given fitness case
+ *
+ * @param  data
+ * @param  index Fitness case index
+ * @return image index
+ */
+static inline int input_data_find_image(input_data_t *data, int index)
+{
+    int low = 0;
+    int high = data->images_count - 1;
+
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (data->images[mid].offset <= index) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+
+/**
+ * Returns noisy pixel of given fitness case, its neighbours are at
+ * `noisy_padded->offsets` from it
+ *
+ * @param  data
+ * @param  index Fitness case index
+ * @param  image Output, image index
+ * @return pixel in padded noisy image
+ */
+static inline img_pixel_t *input_data_noisy_pixel(input_data_t *data,
+    int index, input_image_t **image)
+{
+    input_image_t *img = &data->images[input_data_find_image(data, index)];
+    int position = index - img->offset;
+    *image = img;
+    return img_padded_pixel(img->noisy_padded,
+        position % img->original.width, position / img->original.width);
+}
+
+
 /**
  * Filters noisy image using given filter. Caller is responsible for freeing
  * the filtered image
  *
+ * @param  data
+ * @param  image Image index
  * @param  chr
  * @return filtered image
  */
-img_image_t input_data_filter(input_data_t *data, ga_chr_t chr);
+img_image_t input_data_filter(input_data_t *data, int image, ga_chr_t chr);
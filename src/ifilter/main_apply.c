@@ -21,15 +21,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <math.h>
 #include <getopt.h>
 
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
 #include "image.h"
+#include "image_stream.h"
+#include "apply.h"
+#include "batch.h"
+#include "video.h"
 #include "../cgp/cgp.h"
 
 
-static const int SSE2_STEP = 16;
-
-
 const char* help =
     "Colearning in Coevolutionary Algorithms\n"
     "Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>\n"
@@ -50,7 +56,18 @@ const char* help =
     "To apply filter:\n"
     "    ./coco_apply --chromosome filter.chr --input noisy.png --output clean.png\n"
     "\n"
-    "Various input formats are supported. Output image will always be in PNG file format.\n"
+    "Various input formats are supported. Output image is PNG unless --format is given.\n"
+    "\n"
+    "To filter images larger than memory, use binary PGM images in streaming mode:\n"
+    "    ./coco_apply --stream --chromosome filter.chr --input noisy.pgm --output clean.pgm\n"
+    "\n"
+    "To filter many images at once (input is a directory or a file listing images):\n"
+    "    ./coco_apply --batch --chromosome filter.chr --input noisy/ --output clean/\n"
+    "\n"
+    "To filter luma plane of Y4M video piped between ffmpeg processes:\n"
+    "    ffmpeg -i noisy.mp4 -f yuv4mpegpipe - \\\n"
+    "        | ./coco_apply --video --chromosome filter.chr \\\n"
+    "        | ffmpeg -f yuv4mpegpipe -i - clean.mp4\n"
     "\n"
     "Command line options:\n"
     "    --help, -h\n"
@@ -67,8 +84,182 @@ const char* help =
     "Optional:\n"
     "    --calc-psnr FILE, -p FILE\n"
     "          Print PSNR with reference image and print it to stderr\n"
+    "    --score-only\n"
+    "          Only print PSNR with reference image, filtered image is compared\n"
+    "          row by row and never stored nor written (no output file needed)\n"
     "    --print-ascii, -a\n"
-    "          Prints loaded chromosome as ASCII-art to stderr\n";
+    "          Prints loaded chromosome as ASCII-art to stderr\n"
+    "    --threads NUM, -t NUM\n"
+    "          Number of threads filtering the image (all CPUs by default)\n"
+    "    --stream, -s\n"
+    "          Read input (and reference) image and write output image row by row,\n"
+    "          keeping only three rows in memory. Input images are binary PGM (P5),\n"
+    "          output is binary PGM unless --format is given\n"
+    "    --format png|fastpng|pgm|raw, -f png|fastpng|pgm|raw\n"
+    "          Output image format. PNG is compressed (slow), fast PNG is not\n"
+    "          compressed, raw are PGM samples without header. All but PNG are\n"
+    "          written in chunks of rows as they are encoded\n"
+    "    --batch, -b\n"
+    "          Filter all images in input directory (or listed in input file, one\n"
+    "          per line) and write them to output directory. Images are\n"
+    "          decoded, filtered and encoded by separate threads, --threads sets\n"
+    "          number of filtering threads\n"
+    "    --decode-threads NUM\n"
+    "          Number of threads decoding images in batch mode (all CPUs by default)\n"
+    "    --encode-threads NUM\n"
+    "          Number of threads encoding images in batch mode (all CPUs by default)\n"
+    "    --video, -v\n"
+    "          Read Y4M video and write it with luma plane filtered, chroma planes\n"
+    "          are copied. Frames are read, filtered and written by separate\n"
+    "          threads, --threads sets number of threads filtering one frame\n"
+    "    --video-size WIDTHxHEIGHT\n"
+    "          Read raw planar YUV video of given frame size instead of Y4M\n"
+    "    --video-chroma 420|422|444|mono\n"
+    "          Chroma subsampling of raw planar YUV video (420 by default)\n";
+
+
+#define OPT_DECODE_THREADS 1000
+#define OPT_ENCODE_THREADS 1001
+#define OPT_SCORE_ONLY 1002
+#define OPT_VIDEO_SIZE 1003
+#define OPT_VIDEO_CHROMA 1004
+
+
+/******************************************************************************/
+
+
+/**
+ * Filters image rows read from input stream and writes them to output
+ * stream. Only three input rows are kept in memory.
+ *
+ * @param  chromosome
+ * @param  in
+ * @param  out Output stream, or NULL to only calculate PSNR
+ * @param  ref Reference image stream, or NULL
+ * @param  psnr Filled with PSNR if reference is given
+ * @return 0 on success
+ */
+static int filter_rows(ga_chr_t chromosome, img_stream_t in, img_stream_t out,
+    img_stream_t ref, double *psnr)
+{
+    int width = in->width;
+    int height = in->height;
+
+    // three padded input rows, output row and reference row
+    int size = apply_row_size(width);
+    img_pixel_t *buffer = (img_pixel_t*) calloc(3 * size + 2 * width, sizeof(img_pixel_t));
+    if (!buffer) {
+        fprintf(stderr, "Failed to allocate memory for image rows\n");
+        return -1;
+    }
+
+    // row y is kept in rows[y % 3]
+    img_pixel_t *rows[3] = { buffer, buffer + size, buffer + 2 * size };
+    img_pixel_t *output_row = buffer + 3 * size;
+    img_pixel_t *reference_row = output_row + width;
+    apply_row_func_t func = apply_get_row_func();
+    const char *error = NULL;
+    uint64_t sum = 0;
+
+    if (img_stream_read_row(in, rows[0] + 1)) {
+        error = "Failed to read input image.";
+    }
+    apply_pad_row(rows[0], width);
+
+    for (int y = 0; y < height && !error; y++) {
+        int y_above = (y > 0) ? y - 1 : 0;
+        int y_below = (y < height - 1) ? y + 1 : height - 1;
+
+        // next row replaces the one which is not needed anymore
+        if (y_below > y) {
+            if (img_stream_read_row(in, rows[y_below % 3] + 1)) {
+                error = "Failed to read input image.";
+                break;
+            }
+            apply_pad_row(rows[y_below % 3], width);
+        }
+
+        img_pixel_t *neighbours[3] = {
+            rows[y_above % 3], rows[y % 3], rows[y_below % 3]
+        };
+        func(chromosome, neighbours, width, output_row);
+
+        if (out && img_stream_write_row(out, output_row)) {
+            error = "Failed to write output image.";
+            break;
+        }
+
+        if (ref) {
+            if (img_stream_read_row(ref, reference_row)) {
+                error = "Failed to read reference image.";
+                break;
+            }
+            sum += img_row_sqdiff(output_row, reference_row, width);
+        }
+    }
+
+    free(buffer);
+
+    if (error) {
+        fprintf(stderr, "%s\n", error);
+        return -1;
+    }
+
+    if (ref) {
+        *psnr = img_psnr_from_sqdiff(sum, (double) width * height);
+    }
+    return 0;
+}
+
+
+/**
+ * Filters binary PGM image row by row, output rows are written as soon
+ * as they are filtered
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  output Output file, or NULL to only calculate PSNR
+ * @param  format Output image format
+ * @param  reference Reference PGM image to calculate PSNR with, or NULL
+ * @param  psnr Filled with PSNR if reference is given
+ * @return 0 on success
+ */
+static int filter_stream(ga_chr_t chromosome, FILE *input, FILE *output,
+    img_format_t format, FILE *reference, double *psnr)
+{
+    img_stream_t in = img_stream_open_pgm(input);
+    if (!in) {
+        fprintf(stderr, "Failed to load input image or no file given.\n");
+        return -1;
+    }
+
+    img_stream_t ref = NULL;
+    if (reference) {
+        ref = img_stream_open_pgm(reference);
+        if (!ref || ref->width != in->width || ref->height != in->height) {
+            fprintf(stderr, "Failed to load reference image or its size does not match.\n");
+            img_stream_destroy(in);
+            img_stream_destroy(ref);
+            return -1;
+        }
+    }
+
+    int result = -1;
+    img_stream_t out = NULL;
+    if (output) {
+        out = img_stream_create(output, in->width, in->height, format);
+    }
+    if (output && !out) {
+        fprintf(stderr, "Failed to write output image.\n");
+    } else {
+        result = filter_rows(chromosome, in, out, ref, psnr);
+    }
+
+    img_stream_destroy(in);
+    img_stream_destroy(out);
+    img_stream_destroy(ref);
+    return result;
+}
 
 
 /******************************************************************************/
@@ -84,15 +275,24 @@ int main(int argc, char *argv[])
         {"output", required_argument, 0, 'o'},
         {"calc-psnr", required_argument, 0, 'p'},
         {"print-ascii", no_argument, 0, 'a'},
+        {"stream", no_argument, 0, 's'},
+        {"threads", required_argument, 0, 't'},
+        {"batch", no_argument, 0, 'b'},
+        {"decode-threads", required_argument, 0, OPT_DECODE_THREADS},
+        {"encode-threads", required_argument, 0, OPT_ENCODE_THREADS},
+        {"score-only", no_argument, 0, OPT_SCORE_ONLY},
+        {"format", required_argument, 0, 'f'},
+        {"video", no_argument, 0, 'v'},
+        {"video-size", required_argument, 0, OPT_VIDEO_SIZE},
+        {"video-chroma", required_argument, 0, OPT_VIDEO_CHROMA},
 
         {0, 0, 0, 0}
     };
 
-    static const char *short_options = "hc:i:o:p:a";
+    static const char *short_options = "hc:i:o:p:ast:bvf:";
 
     img_image_t input_image = NULL;
     img_image_t reference_image = NULL;
-    img_window_array_t input_image_windows = NULL;
     img_image_t output_image = NULL;
     FILE *output_image_file = NULL;
     ga_chr_t chromosome = ga_alloc_chr(cgp_alloc_genome);
@@ -106,9 +306,30 @@ int main(int argc, char *argv[])
         Parse command line
      */
 
-    bool input_file_given = false;
-    bool output_file_given = false;
+    char *input_filename = NULL;
+    char *output_filename = NULL;
+    char *reference_filename = NULL;
     bool print_ascii_art = false;
+    bool stream_mode = false;
+    bool batch_mode = false;
+    bool score_only = false;
+    bool video_mode = false;
+    bool video_raw = false;
+    video_format_t video_format = { .chroma = VIDEO_CHROMA_420 };
+    img_format_t output_format = IMG_FORMAT_PNG;
+    bool output_format_given = false;
+    int threads;
+
+    #ifdef _OPENMP
+        int cpus = omp_get_num_procs();
+    #else
+        int cpus = 1;
+    #endif
+    batch_config_t batch_config = {
+        .decode_threads = cpus,
+        .filter_threads = cpus,
+        .encode_threads = cpus,
+    };
 
     while (1) {
         FILE *chromosome_file;
@@ -122,13 +343,11 @@ int main(int argc, char *argv[])
                 return 1;
 
             case 'i':
-                input_image = img_load(optarg);
-                input_file_given = true;
+                input_filename = optarg;
                 break;
 
             case 'o':
-                output_image_file = fopen(optarg, "wb");
-                output_file_given = true;
+                output_filename = optarg;
                 break;
 
             case 'c':
@@ -148,11 +367,72 @@ int main(int argc, char *argv[])
                 break;
 
             case 'p':
-                reference_image = img_load(optarg);
-                if (!reference_image) {
-                    fprintf(stderr, "Failed to load reference image.\n");
+                reference_filename = optarg;
+                break;
+
+            case 's':
+                stream_mode = true;
+                break;
+
+            case 't':
+                threads = atoi(optarg);
+                if (threads < 1) {
+                    fprintf(stderr, "Invalid number of threads.\n");
                     return 1;
                 }
+                #ifdef _OPENMP
+                    omp_set_num_threads(threads);
+                #endif
+                batch_config.filter_threads = threads;
+                break;
+
+            case 'b':
+                batch_mode = true;
+                break;
+
+            case OPT_SCORE_ONLY:
+                score_only = true;
+                break;
+
+            case 'f':
+                if (img_parse_format(optarg, &output_format)) {
+                    fprintf(stderr, "Invalid output format.\n");
+                    return 1;
+                }
+                output_format_given = true;
+                break;
+
+            case 'v':
+                video_mode = true;
+                break;
+
+            case OPT_VIDEO_SIZE:
+                if (video_parse_size(optarg, &video_format)) {
+                    fprintf(stderr, "Invalid video frame size.\n");
+                    return 1;
+                }
+                video_raw = true;
+                break;
+
+            case OPT_VIDEO_CHROMA:
+                if (video_parse_chroma(optarg, &video_format)) {
+                    fprintf(stderr, "Invalid video chroma subsampling.\n");
+                    return 1;
+                }
+                break;
+
+            case OPT_DECODE_THREADS:
+            case OPT_ENCODE_THREADS:
+                threads = atoi(optarg);
+                if (threads < 1) {
+                    fprintf(stderr, "Invalid number of threads.\n");
+                    return 1;
+                }
+                if (c == OPT_DECODE_THREADS) {
+                    batch_config.decode_threads = threads;
+                } else {
+                    batch_config.encode_threads = threads;
+                }
                 break;
 
             default:
@@ -161,14 +441,174 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (!input_file_given) {
-        input_image = img_load_stream(stdin);
+    if (batch_mode) {
+        /*
+            Filter all images from directory or list
+         */
+
+        if (!chromosome_loaded) {
+            fprintf(stderr, "Failed to load chromosome or no file given.\n");
+            return 1;
+        }
+
+        if (!input_filename || !output_filename) {
+            fprintf(stderr, "Input and output directory are required in batch mode.\n");
+            return 1;
+        }
+
+        if (reference_filename || score_only) {
+            fprintf(stderr, "PSNR cannot be calculated in batch mode.\n");
+            return 1;
+        }
+
+        if (print_ascii_art) {
+            cgp_dump_chr(chromosome, stderr, asciiart_active);
+        }
+
+        batch_config.format = output_format;
+        int result = batch_filter_images(chromosome, input_filename,
+            output_filename, &batch_config);
+        ga_destroy_chr(chromosome, cgp_free_genome);
+        return result ? 1 : 0;
     }
 
-    if (!output_file_given) {
+    if (video_mode || video_raw) {
+        /*
+            Filter video frames
+         */
+
+        if (!chromosome_loaded) {
+            fprintf(stderr, "Failed to load chromosome or no file given.\n");
+            return 1;
+        }
+
+        if (reference_filename || score_only) {
+            fprintf(stderr, "PSNR cannot be calculated in video mode.\n");
+            return 1;
+        }
+
+        if (output_format_given) {
+            fprintf(stderr, "Output format cannot be selected in video mode.\n");
+            return 1;
+        }
+
+        if (print_ascii_art) {
+            cgp_dump_chr(chromosome, stderr, asciiart_active);
+        }
+
+        FILE *input_file = stdin;
+        if (input_filename) {
+            input_file = fopen(input_filename, "rb");
+            if (!input_file) {
+                fprintf(stderr, "Failed to open input video.\n");
+                return 1;
+            }
+        }
+
+        FILE *output_file = stdout;
+        if (output_filename) {
+            output_file = fopen(output_filename, "wb");
+            if (!output_file) {
+                fprintf(stderr, "Failed to open output video for writing.\n");
+                return 1;
+            }
+        }
+
+        int result = video_filter_stream(chromosome, input_file, output_file,
+            video_raw ? &video_format : NULL);
+
+        if (input_file != stdin) fclose(input_file);
+        if (output_file != stdout) fclose(output_file);
+        ga_destroy_chr(chromosome, cgp_free_genome);
+        return result ? 1 : 0;
+    }
+
+    if (score_only && !reference_filename) {
+        fprintf(stderr, "Reference image is required to calculate score.\n");
+        return 1;
+    }
+
+    if (score_only) {
+        output_image_file = NULL;
+    } else if (output_filename) {
+        output_image_file = fopen(output_filename, "wb");
+    } else {
         output_image_file = stdout;
     }
 
+    if (stream_mode) {
+        /*
+            Filter image row by row
+         */
+
+        if (!output_image_file && !score_only) {
+            fprintf(stderr, "Failed to open output image file for writing.\n");
+            return 1;
+        }
+
+        if (!chromosome_loaded) {
+            fprintf(stderr, "Failed to load chromosome or no file given.\n");
+            return 1;
+        }
+
+        if (!output_format_given) {
+            output_format = IMG_FORMAT_PGM;
+        } else if (output_format == IMG_FORMAT_PNG) {
+            fprintf(stderr, "Compressed PNG cannot be written in stream mode, use fastpng.\n");
+            return 1;
+        }
+
+        if (print_ascii_art) {
+            cgp_dump_chr(chromosome, stderr, asciiart_active);
+        }
+
+        FILE *input_file = stdin;
+        if (input_filename) {
+            input_file = fopen(input_filename, "rb");
+            if (!input_file) {
+                fprintf(stderr, "Failed to load input image or no file given.\n");
+                return 1;
+            }
+        }
+
+        FILE *reference_file = NULL;
+        if (reference_filename) {
+            reference_file = fopen(reference_filename, "rb");
+            if (!reference_file) {
+                fprintf(stderr, "Failed to load reference image.\n");
+                return 1;
+            }
+        }
+
+        double psnr = 0;
+        int result = filter_stream(chromosome, input_file, output_image_file,
+            output_format, reference_file, &psnr);
+
+        if (result == 0 && reference_file) {
+            fprintf(stderr, "%g\n", psnr);
+        }
+
+        if (input_file != stdin) fclose(input_file);
+        if (reference_file) fclose(reference_file);
+        if (output_image_file) fclose(output_image_file);
+        ga_destroy_chr(chromosome, cgp_free_genome);
+        return result ? 1 : 0;
+    }
+
+    if (input_filename) {
+        input_image = img_load(input_filename);
+    } else {
+        input_image = img_load_stream(stdin);
+    }
+
+    if (reference_filename) {
+        reference_image = img_load(reference_filename);
+        if (!reference_image) {
+            fprintf(stderr, "Failed to load reference image.\n");
+            return 1;
+        }
+    }
+
     /*
         Check args
      */
@@ -177,19 +617,14 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    input_image_windows = img_split_windows(input_image);
-    if (!input_image_windows) {
-        fprintf(stderr, "Failed to preprocess input image.\n");
+    if (reference_image && (reference_image->width != input_image->width
+        || reference_image->height != input_image->height))
+    {
+        fprintf(stderr, "Reference image size does not match.\n");
         return 1;
     }
 
-    output_image = img_create(input_image->width, input_image->height, input_image->comp);
-    if (!output_image) {
-        fprintf(stderr, "Failed to allocate memory for output image\n");
-        return 1;
-    }
-
-    if (!output_image_file) {
+    if (!output_image_file && !score_only) {
         fprintf(stderr, "Failed to open output image file for writing.\n");
         return 1;
     }
@@ -207,18 +642,38 @@ int main(int argc, char *argv[])
         cgp_dump_chr(chromosome, stderr, asciiart_active);
     }
 
+    /*
+        Filter image and compare it with reference row by row
+     */
+
+    if (score_only) {
+        double psnr;
+        int result = apply_psnr_image(chromosome, input_image, reference_image, &psnr);
+        if (result) {
+            fprintf(stderr, "Failed to allocate memory for image rows\n");
+        } else {
+            fprintf(stderr, "%g\n", psnr);
+        }
+
+        ga_destroy_chr(chromosome, cgp_free_genome);
+        img_destroy(input_image);
+        img_destroy(reference_image);
+        return result ? 1 : 0;
+    }
+
     /*
         Filter image
     */
 
-    for (int i = 0; i < input_image_windows->size; i++) {
-        img_window_t *w = &input_image_windows->windows[i];
-
-        cgp_value_t *inputs = w->pixels;
-        cgp_value_t output_pixel;
-        cgp_get_output(chromosome, inputs, &output_pixel);
+    output_image = img_create(input_image->width, input_image->height, input_image->comp);
+    if (!output_image) {
+        fprintf(stderr, "Failed to allocate memory for output image\n");
+        return 1;
+    }
 
-        img_set_pixel(output_image, w->pos_x, w->pos_y, output_pixel);
+    if (apply_filter_image(chromosome, input_image, output_image)) {
+        fprintf(stderr, "Failed to allocate memory for image rows\n");
+        return 1;
     }
 
     /*
@@ -231,18 +686,19 @@ int main(int argc, char *argv[])
     }
 
     /*
-        Write PNG
+        Write output image
      */
 
-    int len;
-    unsigned char *png = img_save_png_to_mem(output_image, &len);
-    fwrite(png, sizeof(unsigned char), len, output_image_file);
+    int result = img_stream_write_image(output_image_file, output_image,
+        output_format);
+    if (result) {
+        fprintf(stderr, "Failed to write output image.\n");
+    }
     fclose(output_image_file);
-    free(png);
 
     ga_destroy_chr(chromosome, cgp_free_genome);
     img_destroy(output_image);
     img_destroy(input_image);
     img_destroy(reference_image);
-    img_windows_destroy(input_image_windows);
+    return result ? 1 : 0;
 }
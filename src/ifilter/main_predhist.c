@@ -328,7 +328,7 @@ int main(int argc, char *argv[])
         printf("\n");
 
         if (render) {
-            char shade = (histogram[i] / (double)max_count) * 255;
+            img_pixel_t shade = (histogram[i] / (double)max_count) * IMG_PIXEL_MAX;
             output_image->data[i] = shade;
         }
     }
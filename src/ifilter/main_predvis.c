@@ -237,9 +237,9 @@ int main(int argc, char *argv[])
             if (!list_only) {
                 if (count == 1) {
                     index = index * 3;
-                    output_image->data[index] = red;
-                    output_image->data[index + 1] = green;
-                    output_image->data[index + 2] = blue;
+                    output_image->data[index] = red * (IMG_PIXEL_MAX / 0xFF);
+                    output_image->data[index + 1] = green * (IMG_PIXEL_MAX / 0xFF);
+                    output_image->data[index + 2] = blue * (IMG_PIXEL_MAX / 0xFF);
                 } else {
                     fprintf(stderr, "Invalid log file.\n");
                     return 1;
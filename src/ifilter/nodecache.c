@@ -0,0 +1,162 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nodecache.h"
+
+
+/**
+ * Returns memory needed to cache node outputs
+ *
+ * @param  plane_size Size of node plane in pixels
+ * @return size in bytes
+ */
+size_t nodecache_memory_size(size_t plane_size)
+{
+    return sizeof(img_pixel_t) * plane_size * CGP_NODES;
+}
+
+
+/**
+ * Allocates node output cache
+ *
+ * @param  plane_size Size of node plane in pixels (sum of segment sizes)
+ * @param  memory_limit Maximum size of node planes (in bytes)
+ * @return Cache or NULL if it would not fit into limit
+ */
+nodecache_t nodecache_create(size_t plane_size, size_t memory_limit)
+{
+    if (nodecache_memory_size(plane_size) > memory_limit) {
+        return NULL;
+    }
+
+    nodecache_t cache = (nodecache_t) malloc(sizeof(struct nodecache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->plane_size = plane_size;
+    cache->valid = false;
+
+    for (int i = 0; i < CGP_NODES; i++) {
+        void *ptr = NULL;
+        if (posix_memalign(&ptr, NODECACHE_ALIGNMENT,
+            sizeof(img_pixel_t) * plane_size)) {
+            for (int j = 0; j < i; j++) {
+                free(cache->nodes[j]);
+            }
+            free(cache);
+            return NULL;
+        }
+        memset(ptr, 0, sizeof(img_pixel_t) * plane_size);
+        cache->nodes[i] = (img_pixel_t*) ptr;
+    }
+
+    return cache;
+}
+
+
+/**
+ * Frees node output cache
+ *
+ * @param cache
+ */
+void nodecache_destroy(nodecache_t cache)
+{
+    if (cache == NULL) return;
+
+    for (int i = 0; i < CGP_NODES; i++) {
+        free(cache->nodes[i]);
+    }
+    free(cache);
+}
+
+
+/**
+ * Creates plan for evaluating given circuit using cached planes. Node
+ * has to be computed if cached circuit does not have it active, if it
+ * has different function or inputs or if any of its inputs has to be
+ * computed.
+ *
+ * @param cache
+ * @param genome
+ * @param plan
+ */
+void nodecache_plan(nodecache_t cache, cgp_genome_t genome,
+    nodecache_plan_t *plan)
+{
+    bool dirty[NODECACHE_SLOTS] = { false };
+    bool loaded[NODECACHE_SLOTS] = { false };
+
+    plan->loads_count = 0;
+    plan->program_length = 0;
+
+    for (int i = 0; i < genome->program_length; i++) {
+        cgp_instr_t *instr = &genome->program[i];
+        cgp_node_t *cached = &cache->genome.nodes[instr->output - CGP_INPUTS];
+        int arity = CGP_FUNC_ARITY[instr->function];
+
+        bool is_dirty = !cache->valid
+            || !cached->is_active
+            || cached->function != instr->function;
+
+        for (int k = 0; k < arity; k++) {
+            is_dirty = is_dirty
+                || cached->inputs[k] != instr->inputs[k]
+                || dirty[instr->inputs[k]];
+        }
+
+        if (!is_dirty) continue;
+        dirty[instr->output] = true;
+
+        for (int k = 0; k < arity; k++) {
+            int slot = instr->inputs[k];
+            if (!dirty[slot] && !loaded[slot]) {
+                loaded[slot] = true;
+                plan->loads[plan->loads_count++] = slot;
+            }
+        }
+
+        plan->program[plan->program_length++] = *instr;
+    }
+
+    // output connected to primary input or clean node is loaded
+    plan->output = genome->outputs[0];
+    if (!dirty[plan->output] && !loaded[plan->output]) {
+        loaded[plan->output] = true;
+        plan->loads[plan->loads_count++] = plan->output;
+    }
+}
+
+
+/**
+ * Marks planes as holding node outputs of given circuit. Must be called
+ * after its plan has been executed with storing enabled over all pixels.
+ *
+ * @param cache
+ * @param genome
+ */
+void nodecache_commit(nodecache_t cache, cgp_genome_t genome)
+{
+    cgp_copy_genome(&cache->genome, genome);
+    cache->valid = true;
+}
@@ -0,0 +1,162 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../cgp/cgp_core.h"
+#include "image.h"
+
+
+// total number of value slots - primary inputs followed by nodes
+#define NODECACHE_SLOTS (CGP_INPUTS + CGP_NODES)
+
+// segments of node planes are padded so that whole AVX-512 register fits
+// at their end
+#define NODECACHE_ALIGNMENT 64
+
+
+/**
+ * Cache of node output planes
+ *
+ * Holds output of each active node of one circuit (usually parent of
+ * current population) for every pixel. Offspring differ from it only
+ * in a few nodes, so only those have to be computed, the rest is loaded.
+ *
+ * Pixels are split into segments (image rows). Each segment of node plane
+ * is padded (see `nodecache_segment_size`), so that SIMD stores at its end
+ * do not overwrite the next one.
+ */
+struct nodecache {
+    size_t plane_size;
+
+    /* cached outputs of each node */
+    img_pixel_t *nodes[CGP_NODES];
+
+    /* circuit whose node outputs are stored in planes */
+    bool valid;
+    struct cgp_genome genome;
+};
+typedef struct nodecache* nodecache_t;
+
+
+/**
+ * Incremental evaluation plan of one circuit against cache contents
+ */
+typedef struct {
+    /* slots which are loaded from cache planes */
+    int loads_count;
+    int loads[NODECACHE_SLOTS];
+
+    /* nodes which have to be computed, in evaluation order */
+    int program_length;
+    cgp_instr_t program[CGP_NODES];
+
+    /* slot with circuit primary output */
+    int output;
+} nodecache_plan_t;
+
+
+/**
+ * Allocates node output cache
+ *
+ * @param  plane_size Size of node plane in pixels (sum of segment sizes)
+ * @param  memory_limit Maximum size of node planes (in bytes)
+ * @return Cache or NULL if it would not fit into limit
+ */
+nodecache_t nodecache_create(size_t plane_size, size_t memory_limit);
+
+
+/**
+ * Frees node output cache
+ *
+ * @param cache
+ */
+void nodecache_destroy(nodecache_t cache);
+
+
+/**
+ * Creates plan for evaluating given circuit using cached planes. Node
+ * has to be computed if cached circuit does not have it active, if it
+ * has different function or inputs or if any of its inputs has to be
+ * computed.
+ *
+ * @param cache
+ * @param genome
+ * @param plan
+ */
+void nodecache_plan(nodecache_t cache, cgp_genome_t genome,
+    nodecache_plan_t *plan);
+
+
+/**
+ * Marks planes as holding node outputs of given circuit. Must be called
+ * after its plan has been executed with storing enabled over all pixels.
+ *
+ * @param cache
+ * @param genome
+ */
+void nodecache_commit(nodecache_t cache, cgp_genome_t genome);
+
+
+/**
+ * Returns memory needed to cache node outputs
+ *
+ * @param  plane_size Size of node plane in pixels
+ * @return size in bytes
+ */
+size_t nodecache_memory_size(size_t plane_size);
+
+
+/**
+ * Returns space taken by segment of given length in node planes
+ *
+ * @param  length
+ * @return size in pixels
+ */
+static inline size_t nodecache_segment_size(int length)
+{
+    return ((size_t) length + NODECACHE_ALIGNMENT - 1)
+        / NODECACHE_ALIGNMENT * NODECACHE_ALIGNMENT;
+}
+
+
+/**
+ * Returns value planes of all slots of one segment
+ *
+ * @param cache
+ * @param inputs Primary input planes of segment
+ * @param offset Segment position in node planes
+ * @param planes
+ */
+static inline void nodecache_segment_planes(nodecache_t cache,
+    img_pixel_t *inputs[CGP_INPUTS], size_t offset,
+    img_pixel_t *planes[NODECACHE_SLOTS])
+{
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        planes[i] = inputs[i];
+    }
+    for (int i = 0; i < CGP_NODES; i++) {
+        planes[CGP_INPUTS + i] = cache->nodes[i] + offset;
+    }
+}
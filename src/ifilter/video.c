@@ -0,0 +1,517 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "video.h"
+#include "image.h"
+#include "apply.h"
+
+
+// frames being read, filtered and written at the same time
+#define VIDEO_FRAME_BUFFERS 3
+
+// longest Y4M stream or frame header line, including newline
+#define VIDEO_HEADER_LENGTH 1024
+
+
+static const char Y4M_MAGIC[] = "YUV4MPEG2 ";
+static const char Y4M_FRAME[] = "FRAME";
+
+
+/**
+ * Frame buffer
+ */
+typedef struct {
+    unsigned char *data; // frame as stored in stream, luma plane first
+    char header[VIDEO_HEADER_LENGTH]; // Y4M frame header line
+    struct img_image luma; // input luma plane, points to data in 8-bit builds
+    struct img_image filtered; // output luma plane
+} video_frame_t;
+
+
+typedef struct {
+    ga_chr_t chromosome;
+    FILE *input;
+    FILE *output;
+    bool y4m;
+    video_format_t format;
+    size_t luma_size; // samples
+    size_t frame_size; // bytes
+    video_frame_t frames[VIDEO_FRAME_BUFFERS];
+
+    pthread_mutex_t lock; // guards fields below
+    pthread_cond_t changed;
+    long read; // frames read so far, frame N is in frames[N % BUFFERS]
+    long filtered;
+    long written;
+    bool read_done; // end of input or read error
+    bool filter_done;
+    bool read_error;
+    bool failed; // filtering or writing failed, all threads stop
+} video_t;
+
+
+/* format *********************************************************************/
+
+
+/**
+ * Parses frame size given as `WIDTHxHEIGHT`
+ *
+ * @param  str
+ * @param  format Width and height are filled
+ * @return 0 on success
+ */
+int video_parse_size(char const *str, video_format_t *format)
+{
+    char rest;
+    if (sscanf(str, "%dx%d%c", &format->width, &format->height, &rest) != 2
+        || format->width <= 0 || format->height <= 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Parses chroma subsampling given as `420`, `422`, `444` or `mono`
+ *
+ * @param  str
+ * @param  format Chroma is filled
+ * @return 0 on success
+ */
+int video_parse_chroma(char const *str, video_format_t *format)
+{
+    // all 4:2:0 variants differ only in chroma siting
+    if (strcmp(str, "420") == 0 || strcmp(str, "420jpeg") == 0
+        || strcmp(str, "420paldv") == 0 || strcmp(str, "420mpeg2") == 0)
+    {
+        format->chroma = VIDEO_CHROMA_420;
+    } else if (strcmp(str, "422") == 0) {
+        format->chroma = VIDEO_CHROMA_422;
+    } else if (strcmp(str, "444") == 0) {
+        format->chroma = VIDEO_CHROMA_444;
+    } else if (strcmp(str, "mono") == 0) {
+        format->chroma = VIDEO_CHROMA_MONO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Returns number of bytes of both chroma planes of one frame
+ */
+static size_t _video_chroma_size(video_format_t *format)
+{
+    size_t half_width = (format->width + 1) / 2;
+    size_t half_height = (format->height + 1) / 2;
+
+    switch (format->chroma) {
+        case VIDEO_CHROMA_420:
+            return 2 * half_width * half_height;
+        case VIDEO_CHROMA_422:
+            return 2 * half_width * format->height;
+        case VIDEO_CHROMA_444:
+            return 2 * (size_t) format->width * format->height;
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * Reads one header line, including the newline
+ *
+ * @return 0 on success
+ */
+static int _video_read_line(FILE *file, char line[VIDEO_HEADER_LENGTH])
+{
+    if (fgets(line, VIDEO_HEADER_LENGTH, file) == NULL) {
+        return -1;
+    }
+    size_t length = strlen(line);
+    return (length > 0 && line[length - 1] == '\n') ? 0 : -1;
+}
+
+
+/**
+ * Reads Y4M stream header and copies it to output
+ *
+ * @return 0 on success
+ */
+static int _video_read_y4m_header(video_t *video)
+{
+    char line[VIDEO_HEADER_LENGTH];
+    if (_video_read_line(video->input, line)
+        || strncmp(line, Y4M_MAGIC, strlen(Y4M_MAGIC)) != 0)
+    {
+        fprintf(stderr, "Invalid Y4M stream header.\n");
+        return -1;
+    }
+
+    // default colour space
+    video->format.width = 0;
+    video->format.height = 0;
+    video->format.chroma = VIDEO_CHROMA_420;
+
+    char params[VIDEO_HEADER_LENGTH];
+    strcpy(params, line + strlen(Y4M_MAGIC));
+
+    char *saveptr;
+    for (char *param = strtok_r(params, " \n", &saveptr); param != NULL;
+        param = strtok_r(NULL, " \n", &saveptr))
+    {
+        if (param[0] == 'W') {
+            video->format.width = atoi(param + 1);
+        } else if (param[0] == 'H') {
+            video->format.height = atoi(param + 1);
+        } else if (param[0] == 'C') {
+            if (video_parse_chroma(param + 1, &video->format)) {
+                fprintf(stderr, "Unsupported Y4M colour space %s, only 8-bit "
+                    "4:2:0, 4:2:2, 4:4:4 and mono are supported.\n", param + 1);
+                return -1;
+            }
+        }
+    }
+
+    if (video->format.width <= 0 || video->format.height <= 0) {
+        fprintf(stderr, "Invalid Y4M frame size.\n");
+        return -1;
+    }
+
+    if (fputs(line, video->output) == EOF) {
+        fprintf(stderr, "Failed to write output video.\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+/* frames *********************************************************************/
+
+
+static void _video_frames_free(video_t *video)
+{
+    for (int i = 0; i < VIDEO_FRAME_BUFFERS; i++) {
+        video_frame_t *frame = &video->frames[i];
+        #ifdef PIXEL16
+            free(frame->luma.data);
+        #endif
+        free(frame->data);
+        free(frame->filtered.data);
+    }
+}
+
+
+/**
+ * Allocates frame buffers
+ *
+ * @return 0 on success
+ */
+static int _video_frames_alloc(video_t *video)
+{
+    int width = video->format.width;
+    int height = video->format.height;
+    int result = 0;
+
+    for (int i = 0; i < VIDEO_FRAME_BUFFERS; i++) {
+        video_frame_t *frame = &video->frames[i];
+        struct img_image plane = { NULL, width, height, 1 };
+        frame->luma = plane;
+        frame->filtered = plane;
+
+        frame->data = (unsigned char*) malloc(video->frame_size);
+        frame->filtered.data = (img_pixel_t*) malloc(
+            sizeof(img_pixel_t) * video->luma_size);
+        #ifdef PIXEL16
+            frame->luma.data = (img_pixel_t*) malloc(
+                sizeof(img_pixel_t) * video->luma_size);
+        #else
+            frame->luma.data = frame->data;
+        #endif
+
+        if (!frame->data || !frame->luma.data || !frame->filtered.data) {
+            result = -1;
+        }
+    }
+
+    if (result) {
+        _video_frames_free(video);
+    }
+    return result;
+}
+
+
+/**
+ * Reads next frame
+ *
+ * @return 0 on success, 1 at the end of stream, -1 on failure
+ */
+static int _video_read_frame(video_t *video, video_frame_t *frame)
+{
+    int c = fgetc(video->input);
+    if (c == EOF) {
+        return 1;
+    }
+    ungetc(c, video->input);
+
+    if (video->y4m) {
+        if (_video_read_line(video->input, frame->header)
+            || strncmp(frame->header, Y4M_FRAME, strlen(Y4M_FRAME)) != 0)
+        {
+            fprintf(stderr, "Invalid Y4M frame header.\n");
+            return -1;
+        }
+    }
+
+    if (fread(frame->data, 1, video->frame_size, video->input)
+        != video->frame_size)
+    {
+        fprintf(stderr, "Incomplete video frame.\n");
+        return -1;
+    }
+
+    #ifdef PIXEL16
+        // 0xFF maps to 0xFFFF
+        for (size_t i = 0; i < video->luma_size; i++) {
+            frame->luma.data[i] = frame->data[i] * (IMG_PIXEL_MAX / 0xFF);
+        }
+    #endif
+
+    return 0;
+}
+
+
+/**
+ * Writes filtered frame
+ *
+ * @return 0 on success
+ */
+static int _video_write_frame(video_t *video, video_frame_t *frame)
+{
+    #ifdef PIXEL16
+        // input luma is not needed anymore, filtered one replaces it
+        for (size_t i = 0; i < video->luma_size; i++) {
+            frame->data[i] = frame->filtered.data[i] >> 8;
+        }
+        unsigned char *luma = frame->data;
+    #else
+        unsigned char *luma = frame->filtered.data;
+    #endif
+
+    size_t chroma_size = video->frame_size - video->luma_size;
+    bool failed = (video->y4m && fputs(frame->header, video->output) == EOF)
+        || fwrite(luma, 1, video->luma_size, video->output) != video->luma_size
+        || fwrite(frame->data + video->luma_size, 1, chroma_size, video->output) != chroma_size
+        // frames are passed downstream as soon as they are ready
+        || fflush(video->output) != 0;
+
+    if (failed) {
+        fprintf(stderr, "Failed to write output video.\n");
+    }
+    return failed ? -1 : 0;
+}
+
+
+/* threads ********************************************************************/
+
+
+/**
+ * Reader thread - fills free frame buffers
+ */
+static void *_video_reader(void *arg)
+{
+    video_t *video = (video_t*) arg;
+
+    while (true) {
+        pthread_mutex_lock(&video->lock);
+        while (!video->failed
+            && video->read - video->written == VIDEO_FRAME_BUFFERS)
+        {
+            pthread_cond_wait(&video->changed, &video->lock);
+        }
+        bool stop = video->failed;
+        video_frame_t *frame = &video->frames[video->read % VIDEO_FRAME_BUFFERS];
+        pthread_mutex_unlock(&video->lock);
+
+        int result = stop ? 1 : _video_read_frame(video, frame);
+
+        pthread_mutex_lock(&video->lock);
+        if (result == 0) {
+            video->read++;
+        } else {
+            video->read_done = true;
+            video->read_error = result < 0;
+        }
+        pthread_cond_broadcast(&video->changed);
+        pthread_mutex_unlock(&video->lock);
+
+        if (result != 0) break;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Writer thread - writes filtered frames in order
+ */
+static void *_video_writer(void *arg)
+{
+    video_t *video = (video_t*) arg;
+
+    while (true) {
+        pthread_mutex_lock(&video->lock);
+        while (!video->failed && video->written == video->filtered
+            && !video->filter_done)
+        {
+            pthread_cond_wait(&video->changed, &video->lock);
+        }
+        bool stop = video->failed || video->written == video->filtered;
+        video_frame_t *frame = &video->frames[video->written % VIDEO_FRAME_BUFFERS];
+        pthread_mutex_unlock(&video->lock);
+
+        if (stop) break;
+
+        int result = _video_write_frame(video, frame);
+
+        pthread_mutex_lock(&video->lock);
+        if (result == 0) {
+            video->written++;
+        } else {
+            video->failed = true;
+        }
+        pthread_cond_broadcast(&video->changed);
+        pthread_mutex_unlock(&video->lock);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Filters frames as they are read, rows of each frame are split among
+ * OpenMP threads
+ */
+static void _video_filter(video_t *video)
+{
+    while (true) {
+        pthread_mutex_lock(&video->lock);
+        while (!video->failed && video->filtered == video->read
+            && !video->read_done)
+        {
+            pthread_cond_wait(&video->changed, &video->lock);
+        }
+        bool stop = video->failed || video->filtered == video->read;
+        video_frame_t *frame = &video->frames[video->filtered % VIDEO_FRAME_BUFFERS];
+        pthread_mutex_unlock(&video->lock);
+
+        if (stop) break;
+
+        int result = apply_filter_image(video->chromosome, &frame->luma,
+            &frame->filtered);
+
+        pthread_mutex_lock(&video->lock);
+        if (result == 0) {
+            video->filtered++;
+        } else {
+            fprintf(stderr, "Failed to allocate memory for image rows\n");
+            video->failed = true;
+        }
+        pthread_cond_broadcast(&video->changed);
+        pthread_mutex_unlock(&video->lock);
+    }
+
+    pthread_mutex_lock(&video->lock);
+    video->filter_done = true;
+    pthread_cond_broadcast(&video->changed);
+    pthread_mutex_unlock(&video->lock);
+}
+
+
+/**
+ * Filters luma plane of all frames of video stream. Output stream has the
+ * same format as the input one, Y4M headers are copied.
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  output
+ * @param  raw Format of raw planar YUV input, NULL if input is Y4M
+ * @return 0 if all frames were filtered
+ */
+int video_filter_stream(ga_chr_t chromosome, FILE *input, FILE *output,
+    video_format_t *raw)
+{
+    video_t video = {
+        .chromosome = chromosome,
+        .input = input,
+        .output = output,
+        .y4m = (raw == NULL),
+    };
+
+    if (raw) {
+        video.format = *raw;
+    } else if (_video_read_y4m_header(&video)) {
+        return -1;
+    }
+
+    video.luma_size = (size_t) video.format.width * video.format.height;
+    video.frame_size = video.luma_size + _video_chroma_size(&video.format);
+
+    if (_video_frames_alloc(&video)) {
+        fprintf(stderr, "Failed to allocate memory for video frames.\n");
+        return -1;
+    }
+
+    pthread_mutex_init(&video.lock, NULL);
+    pthread_cond_init(&video.changed, NULL);
+
+    pthread_t reader, writer;
+    bool reader_started = pthread_create(&reader, NULL, _video_reader, &video) == 0;
+    bool writer_started = pthread_create(&writer, NULL, _video_writer, &video) == 0;
+
+    if (reader_started && writer_started) {
+        _video_filter(&video);
+    } else {
+        fprintf(stderr, "Failed to start video threads.\n");
+        pthread_mutex_lock(&video.lock);
+        video.failed = true;
+        video.filter_done = true;
+        pthread_cond_broadcast(&video.changed);
+        pthread_mutex_unlock(&video.lock);
+    }
+
+    if (reader_started) pthread_join(reader, NULL);
+    if (writer_started) pthread_join(writer, NULL);
+
+    pthread_mutex_destroy(&video.lock);
+    pthread_cond_destroy(&video.changed);
+    _video_frames_free(&video);
+
+    return (video.failed || video.read_error) ? -1 : 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Colearning in Coevolutionary Algorithms
+ * Bc. Michal Wiglasz <xwigla00@stud.fit.vutbr.cz>
+ *
+ * Master's Thesis
+ * 2014/2015
+ *
+ * Supervisor: Ing. Michaela Šikulová <isikulova@fit.vutbr.cz>
+ *
+ * Faculty of Information Technologies
+ * Brno University of Technology
+ * http://www.fit.vutbr.cz/
+ *
+ * Started on 28/07/2014.
+ *      _       _
+ *   __(.)=   =(.)__
+ *   \___)     (___/
+ */
+
+
+
+#pragma once
+
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "../cgp/cgp.h"
+
+
+/**
+ * Filtering of video streams
+ *
+ * Frames are read from Y4M (YUV4MPEG2) or raw planar YUV stream, only
+ * luma plane is filtered, chroma planes are passed through untouched.
+ * Reading, filtering and writing run in separate threads over a small ring
+ * of frame buffers, so that decoding and encoding processes connected with
+ * pipes are kept busy while the frame is being filtered.
+ */
+
+
+typedef enum {
+    VIDEO_CHROMA_420,
+    VIDEO_CHROMA_422,
+    VIDEO_CHROMA_444,
+    VIDEO_CHROMA_MONO,
+} video_chroma_t;
+
+
+/**
+ * Frame layout, samples are always 8-bit
+ */
+typedef struct {
+    int width;
+    int height;
+    video_chroma_t chroma;
+} video_format_t;
+
+
+/**
+ * Parses frame size given as `WIDTHxHEIGHT`
+ *
+ * @param  str
+ * @param  format Width and height are filled
+ * @return 0 on success
+ */
+int video_parse_size(char const *str, video_format_t *format);
+
+
+/**
+ * Parses chroma subsampling given as `420`, `422`, `444` or `mono`
+ *
+ * @param  str
+ * @param  format Chroma is filled
+ * @return 0 on success
+ */
+int video_parse_chroma(char const *str, video_format_t *format);
+
+
+/**
+ * Filters luma plane of all frames of video stream. Output stream has the
+ * same format as the input one, Y4M headers are copied.
+ *
+ * @param  chromosome
+ * @param  input
+ * @param  output
+ * @param  raw Format of raw planar YUV input, NULL if input is Y4M
+ * @return 0 if all frames were filtered
+ */
+int video_filter_stream(ga_chr_t chromosome, FILE *input, FILE *output,
+    video_format_t *raw);
@@ -136,6 +136,9 @@ static inline void _print_line(logger_t logger, history_entry_t *entry) {
         "%d,"        // entry->pred_length,
         "%d,"       // entry->pred_used_length,
         "%ld,"      // entry->cgp_evals,
+        "%ld,"      // entry->cgp_skipped_evals,
+        "%ld,"      // entry->cgp_aborted_evals,
+        "%ld,"      // entry->cgp_saved_pixels,
         "%.10g,"    // entry->velocity,
         "%d,"        // entry->delta_generation,
         "%.10g,"     // entry->delta_real_fitness,
@@ -153,6 +156,9 @@ static inline void _print_line(logger_t logger, history_entry_t *entry) {
         entry->pred_length,
         entry->pred_used_length,
         entry->cgp_evals,
+        entry->cgp_skipped_evals,
+        entry->cgp_aborted_evals,
+        entry->cgp_saved_pixels,
         entry->velocity,
         entry->delta_generation,
         entry->delta_real_fitness,
@@ -179,6 +185,9 @@ static void handle_started(logger_t logger, history_entry_t *state)
         "pred_length,"               // entry->pred_length,
         "pred_used_length,"         // entry->pred_used_length,
         "cgp_evals,"                // entry->cgp_evals,
+        "cgp_skipped_evals,"        // entry->cgp_skipped_evals,
+        "cgp_aborted_evals,"        // entry->cgp_aborted_evals,
+        "cgp_saved_pixels,"         // entry->cgp_saved_pixels,
         "velocity,"                 // entry->velocity,
         "delta_generation,"          // entry->delta_generation,
         "delta_fitness,"             // entry->delta_real_fitness,
@@ -75,6 +75,9 @@ void history_calc_entry(
     ga_fitness_t predicted_fitness,
     ga_fitness_t active_predictor_fitness,
     long cgp_evals,
+    long cgp_skipped_evals,
+    long cgp_aborted_evals,
+    long cgp_saved_pixels,
     int pred_length,
     int pred_used_length,
     int pred_generation
@@ -102,6 +105,9 @@ void history_calc_entry(
     entry->delta_velocity = entry->velocity - prev->velocity;
 
     entry->cgp_evals = cgp_evals;
+    entry->cgp_skipped_evals = cgp_skipped_evals;
+    entry->cgp_aborted_evals = cgp_aborted_evals;
+    entry->cgp_saved_pixels = cgp_saved_pixels;
 
     entry->pred_length = pred_length;
     entry->pred_used_length = pred_used_length;
@@ -53,6 +53,13 @@ typedef struct {
 
     long cgp_evals;
 
+    // offspring not evaluated because of identical phenotype as parent
+    long cgp_skipped_evals;
+
+    // offspring evaluations stopped early and pixels saved that way
+    long cgp_aborted_evals;
+    long cgp_saved_pixels;
+
     int pred_length;
     int pred_used_length;
     int pred_generation;
@@ -91,6 +98,9 @@ void history_calc_entry(
     ga_fitness_t predicted_fitness,
     ga_fitness_t active_predictor_fitness,
     long cgp_evals,
+    long cgp_skipped_evals,
+    long cgp_aborted_evals,
+    long cgp_saved_pixels,
     int pred_length,
     int pred_used_length,
     int pred_generation
@@ -108,6 +108,70 @@ static void logger_summary_destruct(logger_t logger)
 }
 
 
+/**
+ * Returns percentage of CGP evaluation pixels saved by stopping
+ * evaluations early
+ */
+static inline double _saved_percent(history_entry_t *state)
+{
+    long total = state->cgp_evals + state->cgp_saved_pixels;
+    return total ? 100.0 * state->cgp_saved_pixels / total : 0;
+}
+
+
+#ifndef SYMREG
+    /**
+     * Prints PSNR of best circuit on each training image, if there are more
+     * of them
+     */
+    static void _print_images_psnr(FILE *fp, input_data_t *input,
+        ga_chr_t circuit)
+    {
+        if (input->images_count < 2) return;
+
+        for (int i = 0; i < input->images_count; i++) {
+            fprintf(fp, "PSNR of image %d: %.2f\n", i,
+                fitness_to_psnr(fitness_eval_cgp_image(circuit, i)));
+        }
+    }
+
+
+    /**
+     * Saves original, noisy and filtered images, file names are numbered
+     * if there are more of them
+     */
+    static void _save_images(logger_summary_t slogger, input_data_t *input,
+        ga_chr_t circuit)
+    {
+        _BUFFER;
+
+        for (int i = 0; i < input->images_count; i++) {
+            input_image_t *image = &input->images[i];
+            char suffix[20] = "";
+            if (input->images_count > 1) {
+                snprintf(suffix, sizeof(suffix), "_%d", i);
+            }
+
+            snprintf(_buffer, _buffer_size, "%s/img_original%s.png",
+                slogger->target_dir, suffix);
+            img_save_png(&image->original, _buffer);
+
+            snprintf(_buffer, _buffer_size, "%s/img_noisy%s.png",
+                slogger->target_dir, suffix);
+            img_image_t img_noisy = img_unpad(image->noisy_padded);
+            img_save_png(img_noisy, _buffer);
+            img_destroy(img_noisy);
+
+            snprintf(_buffer, _buffer_size, "%s/img_best%s.png",
+                slogger->target_dir, suffix);
+            img_image_t img_best = input_data_filter(input, i, circuit);
+            img_save_png(img_best, _buffer);
+            img_destroy(img_best);
+        }
+    }
+#endif
+
+
 static void handle_started(logger_t logger, history_entry_t *state)
 {
     logger_summary_t slogger = (logger_summary_t) logger;
@@ -180,8 +244,13 @@ static void handle_finished(logger_t logger, finish_reason_t reason, history_ent
             fprintf(fp, "Best fitness: " FITNESS_FMT "\n", circuit->fitness);
             #ifndef SYMREG
                 fprintf(fp, "PSNR: %.2f\n", fitness_to_psnr(circuit->fitness));
+                _print_images_psnr(fp, &work_data->input_data, circuit);
             #endif
-            fprintf(fp, "CGP evaluations: %ld\n\n", state->cgp_evals);
+            fprintf(fp, "CGP evaluations: %ld\n", state->cgp_evals);
+            fprintf(fp, "Skipped CGP evaluations: %ld\n", state->cgp_skipped_evals);
+            fprintf(fp, "Aborted CGP evaluations: %ld\n", state->cgp_aborted_evals);
+            fprintf(fp, "Pixels saved by aborting: %ld (%.1f %%)\n\n", state->cgp_saved_pixels,
+                _saved_percent(state));
             fprintf(fp, "Time in user mode: %s\n", _usertime_str);
             fprintf(fp, "Wall clock: %s\n", _wallclock_str);
             fclose(fp);
@@ -201,16 +270,7 @@ static void handle_finished(logger_t logger, finish_reason_t reason, history_ent
             }
 
         #else
-            SPRINTF_FILENAME("img_original.png");
-            img_save_png(work_data->input_data.img_original, _buffer);
-
-            SPRINTF_FILENAME("img_noisy.png");
-            img_save_png(work_data->input_data.img_noisy, _buffer);
-
-            SPRINTF_FILENAME("img_best.png");
-            img_image_t img_best = input_data_filter(&work_data->input_data, circuit);
-            img_save_png(img_best, _buffer);
-            img_destroy(img_best);
+            _save_images(slogger, &work_data->input_data, circuit);
         #endif
 
     }
@@ -221,8 +281,13 @@ static void handle_finished(logger_t logger, finish_reason_t reason, history_ent
         printf("Best fitness: " FITNESS_FMT "\n", circuit->fitness);
         #ifndef SYMREG
             printf("PSNR: %.2f\n", fitness_to_psnr(circuit->fitness));
+            _print_images_psnr(stdout, &work_data->input_data, circuit);
         #endif
-        printf("CGP evaluations: %ld\n\n", state->cgp_evals);
+        printf("CGP evaluations: %ld\n", state->cgp_evals);
+        printf("Skipped CGP evaluations: %ld\n", state->cgp_skipped_evals);
+        printf("Aborted CGP evaluations: %ld\n", state->cgp_aborted_evals);
+        printf("Pixels saved by aborting: %ld (%.1f %%)\n\n", state->cgp_saved_pixels,
+            _saved_percent(state));
         printf("Time in user mode: %s\n", _usertime_str);
         printf("Wall clock: %s\n", _wallclock_str);
     }
@@ -56,6 +56,10 @@ static config_t config = {
     .cgp_mutate_genes = 5,
     .cgp_population_size = 8,
     .cgp_archive_size = 10,
+    #ifndef SYMREG
+        .cgp_node_cache = 64,
+        .cgp_jit = false,
+    #endif
 
     .pred_size = 0.25,
     .pred_initial_size = 0,
@@ -221,7 +225,8 @@ int main(int argc, char *argv[])
     rand_init_seed(config.random_seed);
 
     // cgp evolution
-    cgp_init(config.cgp_mutate_genes, fitness_eval_or_predict_cgp);
+    cgp_init(config.cgp_mutate_genes, fitness_eval_or_predict_cgp,
+        fitness_eval_or_predict_cgp_batch);
 
     // predictors population and both archives
     if (config.algorithm != simple_cgp) {
@@ -285,7 +290,7 @@ int main(int argc, char *argv[])
             .alloc_genome = cgp_alloc_genome,
             .free_genome = cgp_free_genome,
             .copy_genome = cgp_copy_genome,
-            .fitness = fitness_eval_cgp,
+            .slot_fitness = fitness_eval_archived_cgp,
         };
         work_data.cgp_archive = arc_create(config.cgp_archive_size, arc_cgp_methods, CGP_PROBLEM_TYPE);
         if (work_data.cgp_archive == NULL) {
@@ -359,7 +364,9 @@ int main(int argc, char *argv[])
     if (config.algorithm != simple_cgp) {
         arc_insert(work_data.cgp_archive, work_data.cgp_population->best_chromosome);
         ga_evaluate_pop(work_data.pred_population);
-        arc_insert(work_data.pred_archive, work_data.pred_population->best_chromosome);
+        ga_chr_t archived = arc_insert(work_data.pred_archive,
+            work_data.pred_population->best_chromosome);
+        pred_prepare_for_simd(archived->genome);
 
         logger_fire(&work_data.loggers,
             better_pred,
@@ -21,6 +21,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -40,6 +41,11 @@ static pred_metadata_t *_metadata;
 #endif
 
 
+// digit width of phenotype radix sort
+#define PHENOTYPE_RADIX_BITS 8
+#define PHENOTYPE_RADIX (1 << PHENOTYPE_RADIX_BITS)
+
+
 enum _offspring_op {
     random_mutant,
     crossover_product,
@@ -47,6 +53,48 @@ enum _offspring_op {
 };
 
 
+/* used gene values bitset ****************************************************/
+
+
+#define USED_VALUES_WORD_BITS 64
+
+
+/**
+ * Returns number of words of used gene values bitset
+ */
+static inline size_t _pred_used_values_words()
+{
+    return _metadata->max_gene_value / USED_VALUES_WORD_BITS + 1;
+}
+
+
+static inline bool _pred_is_used(pred_genome_t genome, pred_gene_t value)
+{
+    uint64_t word = genome->_used_values[value / USED_VALUES_WORD_BITS];
+    return (word >> (value % USED_VALUES_WORD_BITS)) & 1;
+}
+
+
+static inline void _pred_set_used(pred_genome_t genome, pred_gene_t value)
+{
+    genome->_used_values[value / USED_VALUES_WORD_BITS] |=
+        (uint64_t) 1 << (value % USED_VALUES_WORD_BITS);
+}
+
+
+static inline void _pred_clear_used(pred_genome_t genome, pred_gene_t value)
+{
+    genome->_used_values[value / USED_VALUES_WORD_BITS] &=
+        ~((uint64_t) 1 << (value % USED_VALUES_WORD_BITS));
+}
+
+
+static inline void _pred_clear_all_used(pred_genome_t genome)
+{
+    memset(genome->_used_values, 0, sizeof(uint64_t) * _pred_used_values_words());
+}
+
+
 /* initialization *************************************************************/
 
 
@@ -108,51 +156,34 @@ void* pred_alloc_genome()
 
     /*
         For permuted genotype: holds which values has been used.
-        For repeated genotype: used for calculating genotype (also holds
-            which values has been used in phenotype)
+        For repeated genotype: used for calculating phenotype, starts empty
      */
-    genome->_used_values = (bool*) malloc(sizeof(bool) * (_metadata->max_gene_value + 1));
+    genome->_used_values = (uint64_t*) calloc(_pred_used_values_words(), sizeof(uint64_t));
     if (genome->_used_values == NULL) {
         free(genome->_genes);
         free(genome);
         return NULL;
     }
 
-    if (_metadata->genome_type == permuted) {
-
-        // one-to-one mapping
-        // field genome->used_pixels must be updated manually after every change!
-        genome->pixels = genome->_genes;
-
-    } else {
-        // phenotype is different
-        genome->pixels = (unsigned int*) malloc(sizeof(unsigned int) * _metadata->genotype_length);
-        if (genome->pixels == NULL) {
-            free(genome->_genes);
-            free(genome);
-            return NULL;
-        }
+    // phenotype is sorted, so it is different even for permuted genotype
+    genome->pixels = (unsigned int*) malloc(sizeof(unsigned int) * _metadata->genotype_length);
+    genome->_pixels_buffer = (unsigned int*) malloc(sizeof(unsigned int) * _metadata->genotype_length);
+    if (genome->pixels == NULL || genome->_pixels_buffer == NULL) {
+        free(genome->pixels);
+        free(genome->_pixels_buffer);
+        free(genome->_used_values);
+        free(genome->_genes);
+        free(genome);
+        return NULL;
     }
 
-    // allocate space for simd-friendly data using calloc, since we
-    // want initialized padding bits
-    if (can_use_simd()) {
-        int size = _metadata->genotype_length;
-        int padding = SIMD_PADDING_BYTES - (size % SIMD_PADDING_BYTES);
-        genome->output_simd = (cgp_value_t *) calloc(size + padding, sizeof(cgp_value_t));
-        if (genome->output_simd == NULL) {
-            // TODO: implement proper deallocation on failure
-            // Whatever, if it fails, everything fails, OS cleans it, so...
-            return NULL;
-        }
-
-        for (int i = 0; i < CGP_INPUTS; i++) {
-            genome->inputs_simd[i] = (cgp_value_t *) calloc(size + padding, sizeof(cgp_value_t));
-            if (genome->inputs_simd[i] == NULL) {
-                return NULL;
-            }
-        }
+    // simd-friendly data are allocated when predictor is prepared
+    genome->output_simd = NULL;
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        genome->inputs_simd[i] = NULL;
     }
+    genome->simd_pixels = NULL;
+    genome->_simd_moves = NULL;
 
     return genome;
 }
@@ -168,13 +199,14 @@ void pred_free_genome(void *_genome)
     pred_genome_t genome = (pred_genome_t) _genome;
     free(genome->_used_values);
     free(genome->_genes);
-    if (_metadata->genome_type != permuted) free(genome->pixels);
-    if (can_use_simd()) {
-        free(genome->output_simd);
-        for (int i = 0; i < CGP_INPUTS; i++) {
-            free(genome->inputs_simd[i]);
-        }
+    free(genome->pixels);
+    free(genome->_pixels_buffer);
+    free(genome->output_simd);
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        free(genome->inputs_simd[i]);
     }
+    free(genome->simd_pixels);
+    free(genome->_simd_moves);
     free(genome);
 }
 
@@ -192,45 +224,83 @@ int _pred_get_circular_index(pred_genome_t genome, int index)
 
 void _pred_calculate_repeated_phenotype(pred_genome_t genome)
 {
-    // clear used values helper
-    memset(genome->_used_values, 0, sizeof(bool) * (_metadata->max_gene_value + 1));
-
+    // used values helper is empty here
     int pheno_index = 0;
     for (int geno_index = 0; geno_index < _metadata->genotype_used_length; geno_index++) {
         int locus = _pred_get_circular_index(genome, geno_index);
         pred_gene_t value = genome->_genes[locus];
-        if (genome->_used_values[value]) {
+        if (_pred_is_used(genome, value)) {
             continue;
 
         } else {
-            genome->_used_values[value] = true;
+            _pred_set_used(genome, value);
             genome->pixels[pheno_index] = value;
             pheno_index++;
         }
     }
     genome->used_pixels = pheno_index;
 
-    if (can_use_simd()) {
-        fitness_prepare_predictor_for_simd(genome);
+    // clear only the values used, instead of whole image sized bitset
+    for (int i = 0; i < pheno_index; i++) {
+        _pred_clear_used(genome, genome->pixels[i]);
     }
 }
 
 
 /**
- * Recalculates phenotype for repeated genotype
+ * Sorts phenotype by pixel index using LSD radix sort, so that data of used
+ * pixels are read in memory order
+ */
+static void _pred_sort_phenotype(pred_genome_t genome)
+{
+    unsigned int *pixels = genome->pixels;
+    unsigned int *buffer = genome->_pixels_buffer;
+    int count = genome->used_pixels;
+
+    for (int shift = 0; shift < 32 && (_metadata->max_gene_value >> shift) > 0;
+        shift += PHENOTYPE_RADIX_BITS)
+    {
+        int offsets[PHENOTYPE_RADIX] = {0};
+        for (int i = 0; i < count; i++) {
+            offsets[(pixels[i] >> shift) & (PHENOTYPE_RADIX - 1)]++;
+        }
+
+        int start = 0;
+        for (int d = 0; d < PHENOTYPE_RADIX; d++) {
+            int digit_count = offsets[d];
+            offsets[d] = start;
+            start += digit_count;
+        }
+
+        for (int i = 0; i < count; i++) {
+            buffer[offsets[(pixels[i] >> shift) & (PHENOTYPE_RADIX - 1)]++] = pixels[i];
+        }
+
+        unsigned int *tmp = pixels;
+        pixels = buffer;
+        buffer = tmp;
+    }
+
+    if (pixels != genome->pixels) {
+        memcpy(genome->pixels, pixels, sizeof(unsigned int) * count);
+    }
+}
+
+
+/**
+ * Recalculates phenotype, which is kept sorted by pixel index
  */
 void pred_calculate_phenotype(pred_genome_t genome)
 {
     if (_metadata->genome_type == permuted) {
         genome->used_pixels = _metadata->genotype_used_length;
+        memcpy(genome->pixels, genome->_genes, sizeof(unsigned int) * genome->used_pixels);
 
     } else {
         _pred_calculate_repeated_phenotype(genome);
     }
 
-    if (can_use_simd()) {
-        fitness_prepare_predictor_for_simd(genome);
-    }
+    _pred_sort_phenotype(genome);
 }
 
 
@@ -246,6 +316,168 @@ void pred_pop_calculate_phenotype(ga_pop_t pop)
 }
 
 
+/**
+ * Allocates simd-friendly data of predictor genome, using calloc since we
+ * want initialized padding bits
+ * @param  genome
+ * @return Whether memory was allocated
+ */
+static bool _pred_alloc_simd(pred_genome_t genome)
+{
+    int size = _metadata->genotype_length;
+    int padding = SIMD_PADDING_BYTES - (size % SIMD_PADDING_BYTES);
+
+    genome->output_simd = (cgp_value_t *) calloc(size + padding, sizeof(cgp_value_t));
+    if (genome->output_simd == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        genome->inputs_simd[i] = (cgp_value_t *) calloc(size + padding, sizeof(cgp_value_t));
+        if (genome->inputs_simd[i] == NULL) {
+            return false;
+        }
+    }
+
+    // no pixel is prepared yet, one more position for terminator
+    genome->simd_pixels = (unsigned int *) malloc(sizeof(unsigned int) * (size + 1));
+    if (genome->simd_pixels == NULL) {
+        return false;
+    }
+    genome->simd_pixels[0] = UINT_MAX;
+
+    genome->_simd_moves = (pred_simd_move_t *) malloc(sizeof(pred_simd_move_t) * size);
+    return genome->_simd_moves != NULL;
+}
+
+
+/**
+ * Moves simd-friendly data of one position
+ */
+static inline void _pred_move_simd_position(pred_genome_t genome,
+    unsigned int to, unsigned int from)
+{
+    genome->output_simd[to] = genome->output_simd[from];
+    for (int k = 0; k < CGP_INPUTS; k++) {
+        genome->inputs_simd[k][to] = genome->inputs_simd[k][from];
+    }
+}
+
+
+/**
+ * Moves simd-friendly data by given runs. Runs are ordered and never
+ * cross, so data moving down are safely moved in ascending order and data
+ * moving up in descending one. Runs between mutated pixels are short, so
+ * all arrays are moved together, position by position.
+ */
+static void _pred_move_simd_runs(pred_genome_t genome, pred_simd_move_t *moves,
+    int count)
+{
+    for (int m = 0; m < count; m++) {
+        pred_simd_move_t move = moves[m];
+        if (move.from > move.to) {
+            for (unsigned int i = 0; i < move.length; i++) {
+                _pred_move_simd_position(genome, move.to + i, move.from + i);
+            }
+        }
+    }
+    for (int m = count - 1; m >= 0; m--) {
+        pred_simd_move_t move = moves[m];
+        if (move.from < move.to) {
+            for (unsigned int i = move.length; i > 0; i--) {
+                _pred_move_simd_position(genome, move.to + i - 1, move.from + i - 1);
+            }
+        }
+    }
+}
+
+
+/**
+ * Moves simd-friendly data of pixels kept in phenotype to their new
+ * positions. Both phenotype and prepared pixels are sorted, so they are
+ * merged in one pass. Positions of new pixels are marked as not prepared.
+ */
+static void _pred_move_simd_data(pred_genome_t genome)
+{
+    unsigned int *prepared = genome->simd_pixels;
+    pred_simd_move_t *moves = genome->_simd_moves;
+    int used = genome->used_pixels;
+
+    // usually phenotype has not changed since last call
+    if (prepared[used] == UINT_MAX
+        && memcmp(prepared, genome->pixels, sizeof(unsigned int) * used) == 0)
+    {
+        return;
+    }
+
+    // runs of kept pixels, terminator stops advancing in prepared pixels
+    int count = 0;
+    bool moving = false;
+    int i = 0, j = 0;
+    while (i < used) {
+        unsigned int pixel = genome->pixels[i];
+        unsigned int old = prepared[j];
+
+        if (pixel == old) {
+            if (count > 0 && moves[count - 1].to + moves[count - 1].length == i
+                && moves[count - 1].from + moves[count - 1].length == j)
+            {
+                moves[count - 1].length++;
+            } else {
+                moves[count].to = i;
+                moves[count].from = j;
+                moves[count].length = 1;
+                moving |= i != j;
+                count++;
+            }
+            i++;
+            j++;
+
+        } else if (pixel < old) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+
+    if (moving) {
+        _pred_move_simd_runs(genome, moves, count);
+    }
+
+    memset(prepared, 0xFF, sizeof(unsigned int) * (used + 1));
+    for (int m = 0; m < count; m++) {
+        memcpy(&prepared[moves[m].to], &genome->pixels[moves[m].to],
+            sizeof(unsigned int) * moves[m].length);
+    }
+}
+
+
+/**
+ * Prepares simd-friendly image data of predictor phenotype. Only pixels
+ * which were not in phenotype at last call are gathered, data of the others
+ * are moved to their new positions.
+ *
+ * Phenotype changes and copies do not touch the data, it must be prepared
+ * before the predictor is used to predict CGP fitness.
+ *
+ * @param genome
+ */
+void pred_prepare_for_simd(pred_genome_t genome)
+{
+    if (!can_use_simd()) {
+        return;
+    }
+
+    if (genome->simd_pixels == NULL && !_pred_alloc_simd(genome)) {
+        fprintf(stderr, "Failed to allocate memory for predictor data.\n");
+        exit(1);
+    }
+
+    _pred_move_simd_data(genome);
+    fitness_prepare_predictor_for_simd(genome);
+}
+
+
 /**
  * Initializes predictor genome to random values
  * @param chromosome
@@ -255,17 +487,17 @@ int pred_randomize_genome(ga_chr_t chromosome)
     pred_genome_t genome = (pred_genome_t) chromosome->genome;
 
     if (_metadata->genome_type == permuted) {
-        memset(genome->_used_values, 0, sizeof(bool) * (_metadata->max_gene_value + 1));
+        _pred_clear_all_used(genome);
     }
 
     for (int i = 0; i < _metadata->genotype_length; i++) {
         pred_gene_t value = rand_urange(0, _metadata->max_gene_value);
         if (_metadata->genome_type == permuted) {
             // only unused is valid, so make corrections
-            while(genome->_used_values[value]) {
+            while(_pred_is_used(genome, value)) {
                 value = (value + 1) % (_metadata->max_gene_value + 1);
             };
-            genome->_used_values[value] = true;
+            _pred_set_used(genome, value);
         }
 
         genome->_genes[i] = value;
@@ -289,18 +521,15 @@ void pred_copy_genome(void *_dst, void *_src)
     pred_genome_t src = (pred_genome_t) _src;
 
     memcpy(dst->_genes, src->_genes, sizeof(pred_gene_t) * _metadata->genotype_length);
-    memcpy(dst->_used_values, src->_used_values, sizeof(bool) * _metadata->max_gene_value);
-
-    if (_metadata->genome_type == repeated || _metadata->genome_type == circular) {
-        memcpy(dst->pixels, src->pixels, sizeof(pred_gene_t) * _metadata->genotype_length);
+    // used values of repeated genotype are always empty here
+    if (_metadata->genome_type == permuted) {
+        memcpy(dst->_used_values, src->_used_values, sizeof(uint64_t) * _pred_used_values_words());
     }
 
-    if (can_use_simd()) {
-        memcpy(dst->output_simd, src->output_simd, sizeof(cgp_value_t) * src->used_pixels);
-        for (int w = 0; w < CGP_INPUTS; w++) {
-            memcpy(dst->inputs_simd[w], src->inputs_simd[w], sizeof(cgp_value_t) * src->used_pixels);
-        }
-    }
+    memcpy(dst->pixels, src->pixels, sizeof(unsigned int) * src->used_pixels);
+
+    // simd-friendly data of dst still match its simd_pixels, they are
+    // updated when dst is prepared
 
     dst->used_pixels = src->used_pixels;
     dst->_circular_offset = src->_circular_offset;
@@ -330,14 +559,14 @@ void pred_mutate(pred_genome_t genome)
         pred_gene_t value = rand_urange(0, _metadata->max_gene_value);
         if (_metadata->genome_type == permuted) {
             // either unused or same value is valid, so make corrections
-            while(genome->_used_values[value] && old_value != value) {
+            while(_pred_is_used(genome, value) && old_value != value) {
                 value = (value + 1) % (_metadata->max_gene_value + 1);
             };
+            _pred_set_used(genome, value);
         }
 
         // rewrite gene
         genome->_genes[gene] = value;
-        genome->_used_values[value] = true;
     }
 
     pred_calculate_phenotype(genome);
@@ -400,7 +629,7 @@ void _crossover1p_permuted(pred_genome_t baby, pred_genome_t mom, pred_genome_t
     const int split_point = rand_range(0, _metadata->genotype_length - 1);
 
     // first clear usage flags
-    memset(baby->_used_values, 0, sizeof(bool) * (_metadata->max_gene_value + 1));
+    _pred_clear_all_used(baby);
 
     // second copy everything we can from mom
     int geneIndex = 0;
@@ -409,9 +638,9 @@ void _crossover1p_permuted(pred_genome_t baby, pred_genome_t mom, pred_genome_t
     VERBOSELOG("Copying.");
     for (int i = 0; i < _metadata->genotype_length; i++) {
         pred_gene_t value = parent_genes[i];
-        if (!baby->_used_values[value]) {
+        if (!_pred_is_used(baby, value)) {
             baby->_genes[geneIndex] = value;
-            baby->_used_values[value] = true;
+            _pred_set_used(baby, value);
             geneIndex++;
         }
 
@@ -425,11 +654,11 @@ void _crossover1p_permuted(pred_genome_t baby, pred_genome_t mom, pred_genome_t
     // now create random values in place of duplicates
     for (; geneIndex < _metadata->genotype_length; geneIndex++) {
         pred_gene_t value = rand_urange(0, _metadata->max_gene_value);
-        while(baby->_used_values[value]) {
+        while(_pred_is_used(baby, value)) {
             value = (value + 1) % (_metadata->max_gene_value + 1);
         };
         baby->_genes[geneIndex] = value;
-        baby->_used_values[value] = true;
+        _pred_set_used(baby, value);
     }
 }
 
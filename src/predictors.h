@@ -21,6 +21,8 @@
 #pragma once
 
 
+#include <stdint.h>
+
 #include "ga.h"
 #include "cgp/cgp.h"
 
@@ -33,15 +35,25 @@ static const ga_problem_type_t PRED_PROBLEM_TYPE = minimize;
 typedef unsigned int pred_gene_t;
 typedef pred_gene_t* pred_gene_array_t;
 
+/* run of kept pixels whose simd-friendly data move by the same distance */
+typedef struct {
+    unsigned int to;
+    unsigned int from;
+    unsigned int length;
+} pred_simd_move_t;
+
+
 struct pred_genome {
     /* genotype */
     pred_gene_array_t _genes;
 
     /*
+        bitset of gene values
         for permuted genotype: which gene values were already used?
-        for repeated genotype: used to generate phenotype to avoid duplicities
+        for repeated genotype: used to generate phenotype to avoid duplicities,
+            it is empty between phenotype calculations
     */
-    bool *_used_values;
+    uint64_t *_used_values;
 
     /* how many pixels are in the phenotype */
     unsigned int used_pixels;
@@ -49,12 +61,22 @@ struct pred_genome {
     /* for circular repeated genotype: phenotype starting locus */
     unsigned int _circular_offset;
 
-    /* phenotype */
+    /* phenotype, sorted by pixel index */
     unsigned int *pixels;
 
-    /* simd-friendly prepared image data */
+    /* scratch space for sorting phenotype */
+    unsigned int *_pixels_buffer;
+
+    /* simd-friendly prepared image data, allocated on first use */
     cgp_value_t *output_simd;
     cgp_value_t *inputs_simd[CGP_INPUTS];
+
+    /* which pixel is prepared on each position of simd-friendly data,
+       terminated by UINT_MAX */
+    unsigned int *simd_pixels;
+
+    /* scratch space for moving simd-friendly data */
+    pred_simd_move_t *_simd_moves;
 };
 typedef struct pred_genome* pred_genome_t;
 
@@ -125,7 +147,7 @@ void pred_free_genome(void *genome);
 
 
 /**
- * Recalculates phenotype for repeated genotype
+ * Recalculates phenotype, which is kept sorted by pixel index
  */
 void pred_calculate_phenotype(pred_genome_t genome);
 
@@ -136,6 +158,19 @@ void pred_calculate_phenotype(pred_genome_t genome);
 void pred_pop_calculate_phenotype(ga_pop_t pop);
 
 
+/**
+ * Prepares simd-friendly image data of predictor phenotype. Only pixels
+ * which were not in phenotype at last call are gathered, data of the others
+ * are moved to their new positions.
+ *
+ * Phenotype changes and copies do not touch the data, it must be prepared
+ * before the predictor is used to predict CGP fitness.
+ *
+ * @param genome
+ */
+void pred_prepare_for_simd(pred_genome_t genome);
+
+
 /**
  * Initializes predictor genome to random values
  * @param chromosome
@@ -24,6 +24,7 @@
 #endif
 
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -37,6 +38,10 @@
 
 static double _epsilon;
 
+// misses of circuits stored in CGP archive, one row of all fitness cases
+// per archive slot
+static fitness_error_t *_archive_errors;
+
 
 /* Private functions */
 
@@ -46,6 +51,18 @@ static inline double fitness_psnr_coeficient(int pixels_count)
 }
 
 
+/**
+ * Returns misses of circuit stored in archive slot
+ *
+ * @param  slot
+ * @return Row of all fitness cases
+ */
+static inline fitness_error_t *_fitness_archive_errors(int slot)
+{
+    return _archive_errors + (size_t) slot * fitness_input_data->fitness_cases;
+}
+
+
 /** Public and "friend" API ***************************************************/
 
 
@@ -60,6 +77,26 @@ void _fitness_init(config_t *config, input_data_t *input,
     archive_t cgp_archive, archive_t pred_archive)
 {
     _epsilon = config->epsilon;
+
+    _archive_errors = NULL;
+    if (cgp_archive != NULL) {
+        _archive_errors = (fitness_error_t*) malloc(sizeof(fitness_error_t)
+            * (size_t) cgp_archive->capacity * input->fitness_cases);
+        if (_archive_errors == NULL) {
+            fprintf(stderr, "Failed to allocate memory for archive errors.\n");
+            exit(1);
+        }
+    }
+}
+
+
+/**
+ * Deinitializes fitness module internals
+ */
+void _fitness_deinit()
+{
+    free(_archive_errors);
+    _archive_errors = NULL;
 }
 
 
@@ -88,13 +125,46 @@ ga_fitness_t fitness_eval_cgp(ga_chr_t chr)
             hits++;
         }
     }
-    #pragma omp atomic
-        fitness_cgp_evals += fitness_input_data->fitness_cases;
+    fitness_count_cgp_evals(fitness_input_data->fitness_cases, 0, 0);
 
     return (100.0 * hits) / fitness_input_data->fitness_cases;
 }
 
 
+/**
+ * Evaluates fitness of multiple CGP circuits at once
+ *
+ * @param  chrs
+ * @param  n
+ * @param  parent Unused
+ */
+void fitness_eval_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t parent)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        chrs[i]->fitness = fitness_eval_cgp(chrs[i]);
+    }
+}
+
+
+/**
+ * Predicts fitness of multiple CGP circuits at once
+ *
+ * @param  chrs
+ * @param  n
+ * @param  pred_chr
+ * @param  parent Unused
+ */
+void fitness_predict_cgp_batch(ga_chr_t *chrs, int n, ga_chr_t pred_chr,
+    ga_chr_t parent)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        chrs[i]->fitness = fitness_predict_cgp(chrs[i], pred_chr);
+    }
+}
+
+
 /**
  * Predictes CGP circuit fitness
  *
@@ -125,8 +195,7 @@ ga_fitness_t fitness_predict_cgp(ga_chr_t cgp_chr, ga_chr_t pred_chr)
             hits++;
         }
     }
-    #pragma omp atomic
-        fitness_cgp_evals += predictor->used_pixels;
+    fitness_count_cgp_evals(predictor->used_pixels, 0, 0);
 
     return (100.0 * hits) / predictor->used_pixels;
 }
@@ -135,7 +204,97 @@ ga_fitness_t fitness_predict_cgp(ga_chr_t cgp_chr, ga_chr_t pred_chr)
 
 
 /**
- * Fills simd-friendly predictor arrays with correct image data
+ * Evaluates CGP circuit stored in archive slot and keeps whether it missed
+ * each fitness case
+ *
+ * @param  chr
+ * @param  slot
+ * @return fitness value
+ */
+ga_fitness_t _fitness_eval_archived_cgp(ga_chr_t chr, int slot)
+{
+    fitness_error_t *errors = _fitness_archive_errors(slot);
+    unsigned int hits = 0;
+
+    for (int i = 0; i < fitness_input_data->fitness_cases; i++) {
+        cgp_value_t *inputs = &fitness_input_data->inputs[INPUT_IDX(i, 0)];
+        cgp_value_t target_output = fitness_input_data->outputs[i];
+        cgp_value_t cgp_output;
+        bool should_restart = cgp_get_output(chr, inputs, &cgp_output);
+        if (should_restart) {
+            // errors of all cases must belong to the changed circuit
+            i = -1;
+            hits = 0;
+            continue;
+        }
+
+        bool hit = fabs(target_output - cgp_output) < _epsilon;
+        errors[i] = !hit;
+        hits += hit;
+    }
+    fitness_count_cgp_evals(fitness_input_data->fitness_cases, 0, 0);
+
+    return (100.0 * hits) / fitness_input_data->fitness_cases;
+}
+
+
+/**
+ * Predicts fitness of CGP circuit stored in archive slot from its misses
+ *
+ * @param  slot
+ * @param  predictor
+ * @return fitness value
+ */
+ga_fitness_t _fitness_predict_archived_cgp(int slot, pred_genome_t predictor)
+{
+    fitness_error_t *errors = _fitness_archive_errors(slot);
+    unsigned int misses = 0;
+    for (int i = 0; i < predictor->used_pixels; i++) {
+        misses += errors[predictor->pixels[i]];
+    }
+
+    return _fitness_predict_cgp_by_errors(misses, predictor->used_pixels);
+}
+
+
+/**
+ * Copies misses of CGP circuit stored in archive slot in given fitness
+ * cases
+ *
+ * @param  slot
+ * @param  cases
+ * @param  count
+ * @param  errors
+ */
+void _fitness_get_archived_cgp_errors(int slot, pred_gene_t *cases, int count,
+    uint64_t *errors)
+{
+    fitness_error_t *row = _fitness_archive_errors(slot);
+    for (int i = 0; i < count; i++) {
+        errors[i] = row[cases[i]];
+    }
+}
+
+
+/**
+ * Predicts CGP circuit fitness from total misses in used fitness cases
+ *
+ * @param  sum
+ * @param  used_pixels
+ * @return fitness value
+ */
+ga_fitness_t _fitness_predict_cgp_by_errors(uint64_t sum, int used_pixels)
+{
+    unsigned int hits = used_pixels - sum;
+    return (100.0 * hits) / used_pixels;
+}
+
+
+
+
+/**
+ * Fills simd-friendly predictor arrays with correct image data, positions
+ * already holding the right pixel are skipped
  * @param  genome
  */
 void fitness_prepare_predictor_for_simd(pred_genome_t predictor)
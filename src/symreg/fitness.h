@@ -19,3 +19,9 @@
 
 
 #pragma once
+
+
+/**
+ * Whether fitness case was missed (1) or hit (0) by circuit
+ */
+typedef unsigned char fitness_error_t;
@@ -0,0 +1,87 @@
+/**
+ * Tests SIMD filter application gives the same results as scalar one,
+ * including image borders and row tails not filling whole register.
+ * "Stand-alone" test executable - no expected output provided.
+ * Compile with -DSSE2 -DAVX2 -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1 -mavx2
+ * Source files cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp.c ifilter/apply.c ifilter/apply_sse.c ifilter/apply_avx.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../cpu.h"
+#include "../random.h"
+#include "../cgp/cgp.h"
+#include "../ifilter/apply.h"
+
+
+#define WIDTH 77
+#define HEIGHT 5
+#define CIRCUITS 500
+
+
+int main(int argc, char const *argv[])
+{
+    // pre-flight check
+    if (!can_use_intel_core_4th_gen_features()) {
+        fprintf(stderr, "%s", "AVX2 not supported.\n");
+        exit(1);
+    }
+
+    rand_init_seed(42);
+    cgp_init(5, NULL, NULL);
+
+    img_pixel_t image[HEIGHT][WIDTH];
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            image[y][x] = rand() & 0xFF;
+        }
+    }
+
+    struct ga_chr chr;
+    chr.genome = cgp_alloc_genome();
+
+    // narrower widths test tails of all lengths
+    for (int width = 1; width <= WIDTH; width += 19) {
+        int size = apply_row_size(width);
+        img_pixel_t padded[HEIGHT][size];
+        memset(padded, 0, sizeof(padded));
+        for (int y = 0; y < HEIGHT; y++) {
+            memcpy(&padded[y][1], image[y], width);
+            apply_pad_row(padded[y], width);
+        }
+
+        for (int i = 0; i < CIRCUITS; i++) {
+            cgp_randomize_genome(&chr);
+
+            for (int y = 0; y < HEIGHT; y++) {
+                img_pixel_t *rows[3] = {
+                    padded[(y > 0) ? y - 1 : 0],
+                    padded[y],
+                    padded[(y < HEIGHT - 1) ? y + 1 : HEIGHT - 1]
+                };
+
+                img_pixel_t scalar[WIDTH], sse[WIDTH + 1], avx[WIDTH + 1];
+                sse[width] = avx[width] = 0xAA;
+
+                apply_row_scalar(&chr, rows, width, scalar);
+                apply_row_sse(&chr, rows, width, sse);
+                apply_row_avx(&chr, rows, width, avx);
+
+                if (memcmp(scalar, sse, width) || memcmp(scalar, avx, width)
+                    || sse[width] != 0xAA || avx[width] != 0xAA)
+                {
+                    fprintf(stderr, "Circuit %d, row %d, width %d differs\n",
+                        i, y, width);
+                    cgp_dump_chr_asciiart(&chr, stderr, false);
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    cgp_free_genome(chr.genome);
+    cgp_deinit();
+    return 0;
+}
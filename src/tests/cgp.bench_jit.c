@@ -0,0 +1,130 @@
+/**
+ * Benchmarks circuits compiled to native code against interpreted SIMD
+ * evaluation (cgp_get_output_sse/avx) and checks both give the same results.
+ * "Stand-alone" test executable - no expected output provided.
+ * Compile with -DAVX2 -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1 -mavx2
+ * Source files cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp.c ifilter/cgp_sse.c ifilter/cgp_avx.c ifilter/fitness_sse.c ifilter/fitness_avx.c ifilter/fitness_jit.c ifilter/cgp_jit.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../cpu.h"
+#include "../random.h"
+#include "../fitness.h"
+#include "../cgp/cgp.h"
+#include "../ifilter/cgp_jit.h"
+
+
+#define PIXELS (256 * 256 + 37)
+#define CIRCUITS 200
+#define REPEAT 20
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static double bench(fitness_simd_func_t func, ga_chr_t chrs,
+    img_pixel_t *original, img_pixel_t *noisy[WINDOW_SIZE])
+{
+    double start = now();
+    volatile double sum = 0;
+    for (int i = 0; i < CIRCUITS; i++) {
+        for (int r = 0; r < REPEAT; r++) {
+            sum += func(original, noisy, &chrs[i], 0, PIXELS);
+        }
+    }
+    return now() - start;
+}
+
+
+int main(int argc, char const *argv[])
+{
+    // pre-flight check
+    if (!can_use_intel_core_4th_gen_features()) {
+        fprintf(stderr, "%s", "AVX2 not supported.\n");
+        exit(1);
+    }
+    if (!cgp_jit_supported()) {
+        fprintf(stderr, "%s", "Code generation not supported.\n");
+        exit(1);
+    }
+
+    rand_init_seed(42);
+    cgp_init(5, NULL, NULL);
+
+    // random image, planes are padded as in input data
+    int padded = (PIXELS / 32 + 1) * 32;
+    img_pixel_t *original = (img_pixel_t*) malloc(PIXELS);
+    img_pixel_t *noisy[WINDOW_SIZE];
+    for (int i = 0; i < PIXELS; i++) {
+        original[i] = rand() & 0xFF;
+    }
+    for (int w = 0; w < WINDOW_SIZE; w++) {
+        noisy[w] = (img_pixel_t*) aligned_alloc(32, padded);
+        for (int i = 0; i < padded; i++) {
+            noisy[w][i] = rand() & 0xFF;
+        }
+    }
+
+    struct ga_chr chrs[CIRCUITS];
+    for (int i = 0; i < CIRCUITS; i++) {
+        chrs[i].genome = cgp_alloc_genome();
+        cgp_randomize_genome(&chrs[i]);
+    }
+
+    // compiled code must give the same results, including unaligned tails
+    for (int i = 0; i < CIRCUITS; i++) {
+        int offset = rand_range(0, 100);
+        int length = PIXELS - offset - rand_range(0, 100);
+
+        double sse = _fitness_get_sqdiffsum_sse(original, noisy, &chrs[i], offset, length);
+        double jit_sse = _fitness_get_sqdiffsum_jit_sse(original, noisy, &chrs[i], offset, length);
+        double avx = _fitness_get_sqdiffsum_avx(original, noisy, &chrs[i], offset, length);
+        double jit_avx = _fitness_get_sqdiffsum_jit_avx(original, noisy, &chrs[i], offset, length);
+
+        if (sse != jit_sse || avx != jit_avx || sse != avx) {
+            fprintf(stderr, "Circuit %d: SSE2 %.0f, JIT SSE2 %.0f, AVX2 %.0f, JIT AVX2 %.0f\n",
+                i, sse, jit_sse, avx, jit_avx);
+            cgp_dump_chr_asciiart(&chrs[i], stderr, false);
+            exit(1);
+        }
+    }
+
+    // compilation alone
+    cgp_jit_t jit = cgp_jit_create(cgp_jit_avx2);
+    double start = now();
+    for (int i = 0; i < CIRCUITS; i++) {
+        cgp_jit_compile(jit, (cgp_genome_t) chrs[i].genome);
+    }
+    double compile_time = now() - start;
+    cgp_jit_destroy(jit);
+
+    double pixels = (double) PIXELS * CIRCUITS * REPEAT;
+    double t_sse = bench(_fitness_get_sqdiffsum_sse, chrs, original, noisy);
+    double t_jit_sse = bench(_fitness_get_sqdiffsum_jit_sse, chrs, original, noisy);
+    double t_avx = bench(_fitness_get_sqdiffsum_avx, chrs, original, noisy);
+    double t_jit_avx = bench(_fitness_get_sqdiffsum_jit_avx, chrs, original, noisy);
+
+    printf("Compilation:      %8.2f us per circuit\n", compile_time / CIRCUITS * 1e6);
+    printf("Interpreted SSE2: %8.1f Mpx/s\n", pixels / t_sse / 1e6);
+    printf("JIT SSE2:         %8.1f Mpx/s (%.2fx)\n", pixels / t_jit_sse / 1e6, t_sse / t_jit_sse);
+    printf("Interpreted AVX2: %8.1f Mpx/s\n", pixels / t_avx / 1e6);
+    printf("JIT AVX2:         %8.1f Mpx/s (%.2fx)\n", pixels / t_jit_avx / 1e6, t_avx / t_jit_avx);
+
+    for (int i = 0; i < CIRCUITS; i++) {
+        cgp_free_genome(chrs[i].genome);
+    }
+    for (int w = 0; w < WINDOW_SIZE; w++) {
+        free(noisy[w]);
+    }
+    free(original);
+    cgp_deinit();
+    return 0;
+}
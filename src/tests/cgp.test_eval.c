@@ -15,7 +15,7 @@ int main(int argc, char const *argv[])
     cgp_value_t inputs[CGP_INPUTS] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
     cgp_value_t outputs[CGP_OUTPUTS] = {};
 
-    cgp_init(0, NULL);
+    cgp_init(0, NULL, NULL);
 
     cgp_genome_t genome = (cgp_genome_t) cgp_alloc_genome();
     struct ga_chr chr = {
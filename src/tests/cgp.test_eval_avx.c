@@ -52,7 +52,7 @@ int main(int argc, char const *argv[])
         inputs[i] = _mm256_load_si256((__m256i*)(&_inputs[i]));
     };
 
-    cgp_init(0, NULL);
+    cgp_init(0, NULL, NULL);
 
     cgp_genome_t genome = (cgp_genome_t) cgp_alloc_genome();
     struct ga_chr chr = {
@@ -75,6 +75,9 @@ int main(int argc, char const *argv[])
     // define outputs
     genome->outputs[0] = 13;
 
+    // all nodes are marked active, compile them as they are
+    cgp_build_program(genome);
+
     cgp_dump_chr_asciiart(&chr, stdout, false);
     putchar('\n');
     cgp_get_output_avx(&chr, inputs, outputs);
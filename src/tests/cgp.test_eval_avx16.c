@@ -0,0 +1,128 @@
+/**
+ * Tests 16-bit AVX2 evaluation gives the same results as scalar one, both
+ * for single nodes (including extreme values) and whole filtered rows.
+ * "Stand-alone" test executable - no expected output provided.
+ * Compile with -DPIXEL16 -USSE2 -UAVX512 -DAVX2 -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1 -mavx2
+ * Source files cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp.c ifilter/apply.c ifilter/apply_avx.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "../cpu.h"
+#include "../random.h"
+#include "../cgp/cgp.h"
+#include "../ifilter/apply.h"
+#include "../ifilter/cgp_avx.h"
+
+
+#define VALUES 16
+#define ROUNDS 1000
+#define WIDTH 77
+#define HEIGHT 5
+#define CIRCUITS 500
+
+
+/**
+ * Compares AVX2 and scalar output of all functions for given operands
+ */
+static void check_nodes(cgp_value_t a[VALUES], cgp_value_t b[VALUES])
+{
+    __m256i A = _mm256_loadu_si256((__m256i*) a);
+    __m256i B = _mm256_loadu_si256((__m256i*) b);
+
+    for (int f = 0; f < CGP_FUNC_COUNT; f++) {
+        cgp_node_t node = { .function = f };
+        cgp_value_t simd[VALUES];
+        _mm256_storeu_si256((__m256i*) simd, cgp_eval_node_avx(f, A, B));
+
+        for (int i = 0; i < VALUES; i++) {
+            cgp_value_t expected;
+            cgp_get_node_output(&node, a[i], b[i], &expected);
+            if (simd[i] != expected) {
+                fprintf(stderr, "%s(%u, %u) = %u instead of %u\n",
+                    CGP_FUNC_NAMES[f], a[i], b[i], simd[i], expected);
+                exit(1);
+            }
+        }
+    }
+}
+
+
+int main(int argc, char const *argv[])
+{
+    // pre-flight check
+    if (!can_use_intel_core_4th_gen_features()) {
+        fprintf(stderr, "%s", "AVX2 not supported.\n");
+        exit(1);
+    }
+
+    rand_init_seed(42);
+    cgp_init(5, NULL, NULL);
+
+    cgp_value_t a[VALUES] = { 0, 0, 0xFFFF, 0xFFFF, 1, 0x8000, 0x7FFF, 0x00FF };
+    cgp_value_t b[VALUES] = { 0, 0xFFFF, 0, 0xFFFF, 0xFFFF, 0x8000, 0x8001, 0xFF00 };
+    check_nodes(a, b);
+
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < VALUES; i++) {
+            a[i] = rand() & CGP_VALUE_MAX;
+            b[i] = rand() & CGP_VALUE_MAX;
+        }
+        check_nodes(a, b);
+    }
+
+    img_pixel_t image[HEIGHT][WIDTH];
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            image[y][x] = rand() & IMG_PIXEL_MAX;
+        }
+    }
+
+    struct ga_chr chr;
+    chr.genome = cgp_alloc_genome();
+
+    // narrower widths test tails of all lengths
+    for (int width = 1; width <= WIDTH; width += 19) {
+        int size = apply_row_size(width);
+        img_pixel_t padded[HEIGHT][size];
+        memset(padded, 0, sizeof(padded));
+        for (int y = 0; y < HEIGHT; y++) {
+            memcpy(&padded[y][1], image[y], sizeof(img_pixel_t) * width);
+            apply_pad_row(padded[y], width);
+        }
+
+        for (int i = 0; i < CIRCUITS; i++) {
+            cgp_randomize_genome(&chr);
+
+            for (int y = 0; y < HEIGHT; y++) {
+                img_pixel_t *rows[3] = {
+                    padded[(y > 0) ? y - 1 : 0],
+                    padded[y],
+                    padded[(y < HEIGHT - 1) ? y + 1 : HEIGHT - 1]
+                };
+
+                img_pixel_t scalar[WIDTH], avx[WIDTH + 1];
+                avx[width] = 0xAAAA;
+
+                apply_row_scalar(&chr, rows, width, scalar);
+                apply_row_avx(&chr, rows, width, avx);
+
+                if (memcmp(scalar, avx, sizeof(img_pixel_t) * width)
+                    || avx[width] != 0xAAAA)
+                {
+                    fprintf(stderr, "Circuit %d, row %d, width %d differs\n",
+                        i, y, width);
+                    cgp_dump_chr_asciiart(&chr, stderr, false);
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    cgp_free_genome(chr.genome);
+    cgp_deinit();
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * Tests CGP evaluation = calculation of the outputs.
+ * Compile with -DTEST_EVAL_AVX512 -DAVX512 -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1 -mavx512f -mavx512bw
+ * Source files cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp_avx512.c ifilter/cgp.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <immintrin.h>
+
+#include "../cpu.h"
+#include "../cgp/cgp.h"
+#include "../ifilter/cgp_avx512.h"
+
+
+
+#define in1 {0, 1, 2, 3, 4, 5, 6, 7, 8}
+#define in4 in1, in1, in1, in1
+#define in16 in4, in4, in4, in4
+#define in32 in16, in16
+#define in64 in32, in32
+
+#define rep4(x) (x), (x), (x), (x)
+#define rep16(x) rep4((x)), rep4((x)), rep4((x)), rep4((x))
+#define rep32(x) rep16((x)), rep16((x))
+#define rep64(x) rep32((x)), rep32((x))
+
+
+int main(int argc, char const *argv[])
+{
+    // pre-flight check
+    if (!can_use_avx512bw()) {
+        fprintf(stderr, "%s", "AVX-512BW not supported.\n");
+        exit(1);
+    }
+
+
+    unsigned char _inputs[CGP_INPUTS][64] = {
+        {rep64(0)},
+        {rep64(1)},
+        {rep64(2)},
+        {rep64(3)},
+        {rep64(4)},
+        {rep64(5)},
+        {rep64(6)},
+        {rep64(7)},
+        {rep64(8)},
+    };
+
+    __m512i_aligned inputs[CGP_INPUTS];
+    __m512i_aligned outputs[CGP_OUTPUTS];
+
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        inputs[i] = _mm512_loadu_si512(&_inputs[i]);
+    };
+
+    cgp_init(0, NULL, NULL);
+
+    cgp_genome_t genome = (cgp_genome_t) cgp_alloc_genome();
+    struct ga_chr chr = {
+        .genome = genome
+    };
+
+    // define nodes
+    for (int x = 0; x < CGP_COLS; x++) {
+        for (int y = 0; y < CGP_ROWS; y++) {
+            int i = cgp_node_index(x, y);
+            cgp_node_t *n = &(genome->nodes[i]);
+            n->inputs[0] = i + CGP_INPUTS - y - y - 1;
+            n->inputs[1] = i + CGP_INPUTS - CGP_ROWS;
+            n->function = (cgp_func_t) (i % CGP_FUNC_COUNT);
+            n->is_active = true;
+            n->is_constant = false;
+        }
+    }
+
+    // define outputs
+    genome->outputs[0] = 13;
+
+    // all nodes are marked active, compile them as they are
+    cgp_build_program(genome);
+
+    cgp_dump_chr_asciiart(&chr, stdout, false);
+    putchar('\n');
+    cgp_get_output_avx512(&chr, inputs, outputs);
+
+    free(genome);
+    cgp_deinit();
+}
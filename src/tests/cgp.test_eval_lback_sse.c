@@ -0,0 +1,93 @@
+/**
+ * Tests SIMD CGP evaluation on geometry other than 8x4 with l-back 1.
+ * Compile with -DTEST_EVAL_SSE2 -DSSE2 -DCGP_COLS=6 -DCGP_ROWS=3 -DCGP_LBACK=3 -msse2
+ * Source files cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp_sse.c ifilter/cgp.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <immintrin.h>
+
+#include "../cpu.h"
+#include "../cgp/cgp.h"
+#include "../ifilter/cgp_sse.h"
+
+
+
+#define rep4(x) (x), (x), (x), (x)
+#define rep16(x) rep4((x)), rep4((x)), rep4((x)), rep4((x))
+
+
+int main(int argc, char const *argv[])
+{
+    // pre-flight check
+    if (!can_use_sse2()) {
+        fprintf(stderr, "%s", "SSE2 is not supported.\n");
+        exit(1);
+    }
+
+    unsigned char _inputs[CGP_INPUTS][16] = {
+        {rep16(3)},
+        {rep16(17)},
+        {rep16(42)},
+        {rep16(66)},
+        {rep16(100)},
+        {rep16(129)},
+        {rep16(200)},
+        {rep16(240)},
+        {rep16(255)},
+    };
+
+    __m128i_aligned inputs[CGP_INPUTS];
+    __m128i_aligned outputs[CGP_OUTPUTS];
+    cgp_value_t scalar_inputs[CGP_INPUTS];
+    cgp_value_t scalar_outputs[CGP_OUTPUTS];
+
+    for (int i = 0; i < CGP_INPUTS; i++) {
+        inputs[i] = _mm_load_si128((__m128i*)(&_inputs[i]));
+        scalar_inputs[i] = _inputs[i][0];
+    };
+
+    cgp_init(0, NULL, NULL);
+
+    cgp_genome_t genome = (cgp_genome_t) cgp_alloc_genome();
+    struct ga_chr chr = {
+        .genome = genome
+    };
+
+    // define nodes - first input reaches as far back as allowed, second one
+    // is taken from the previous column, avg is skipped because SIMD version
+    // rounds differently
+    for (int x = 0; x < CGP_COLS; x++) {
+        for (int y = 0; y < CGP_ROWS; y++) {
+            int i = cgp_node_index(x, y);
+            cgp_node_t *n = &(genome->nodes[i]);
+            n->inputs[0] = (x >= CGP_LBACK)
+                ? cgp_node_index(x - CGP_LBACK, y) + CGP_INPUTS
+                : (i % CGP_INPUTS);
+            n->inputs[1] = (x >= 1)
+                ? cgp_node_index(x - 1, (y + 1) % CGP_ROWS) + CGP_INPUTS
+                : ((i + 4) % CGP_INPUTS);
+            n->function = (cgp_func_t) ((i * 5 + 3) % CGP_FUNC_COUNT);
+            if (n->function == avg) n->function = max;
+            n->is_active = true;
+            n->is_constant = false;
+        }
+    }
+
+    // define outputs
+    genome->outputs[0] = CGP_INPUTS + CGP_NODES - 2;
+
+    // all nodes are marked active, compile them as they are
+    cgp_build_program(genome);
+
+    cgp_dump_chr_asciiart(&chr, stdout, false);
+    putchar('\n');
+    cgp_get_output_sse(&chr, inputs, outputs);
+
+    cgp_get_output(&chr, scalar_inputs, scalar_outputs);
+    printf("Scalar: %u\n", scalar_outputs[0]);
+
+    free(genome);
+    cgp_deinit();
+}
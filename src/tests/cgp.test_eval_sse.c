@@ -50,7 +50,7 @@ int main(int argc, char const *argv[])
         inputs[i] = _mm_load_si128((__m128i*)(&_inputs[i]));
     };
 
-    cgp_init(0, NULL);
+    cgp_init(0, NULL, NULL);
 
     cgp_genome_t genome = (cgp_genome_t) cgp_alloc_genome();
     struct ga_chr chr = {
@@ -73,6 +73,9 @@ int main(int argc, char const *argv[])
     // define outputs
     genome->outputs[0] = 13;
 
+    // all nodes are marked active, compile them as they are
+    cgp_build_program(genome);
+
     cgp_dump_chr_asciiart(&chr, stdout, false);
     putchar('\n');
     cgp_get_output_sse(&chr, inputs, outputs);
@@ -0,0 +1,226 @@
+/**
+ * Benchmarks one generation of predictors trained on large image (4096x4096
+ * pixels) against archive of circuits, for both permuted and repeated
+ * genotype: breeding offspring, summing archived errors in their phenotypes
+ * (predictor fitness) and preparing simd-friendly image data of the best
+ * predictor put into archive. Checks prepared data are correct.
+ * "Stand-alone" test executable - no expected output provided.
+ * Compile with -DSSE2 -DAVX2 -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1 -mavx2
+ * Source files predictors.c cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp.c ifilter/cgp_avx.c ifilter/fitness_avx.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "../random.h"
+#include "../fitness.h"
+#include "../predictors.h"
+
+
+#define IMAGE_WIDTH 4096
+#define IMAGE_PIXELS (IMAGE_WIDTH * IMAGE_WIDTH)
+#define PREDICTOR_SIZE 0.0025
+#define POPULATION 32
+#define ARCHIVE 10
+#define GENERATIONS 50
+
+
+static cgp_value_t *image;
+static fitness_error_t *errors;
+static double real_means[ARCHIVE];
+static long gathered;
+
+
+/* fitness is evaluated by benchmark itself */
+
+ga_fitness_t fitness_eval_predictor(ga_chr_t pred_chr)
+{
+    return 0;
+}
+
+
+ga_fitness_t fitness_eval_circular_predictor(ga_chr_t pred_chr)
+{
+    return 0;
+}
+
+
+/**
+ * Window offset in synthetic image, border pixels wrap around
+ */
+static inline unsigned int window_pixel(unsigned int index, int w)
+{
+    long offset = (w / 3 - 1) * IMAGE_WIDTH + (w % 3 - 1);
+    return (index + offset + IMAGE_PIXELS) % IMAGE_PIXELS;
+}
+
+
+/**
+ * Same as ifilter one, 3x3 window is read from synthetic image
+ */
+void fitness_prepare_predictor_for_simd(pred_genome_t predictor)
+{
+    for (int i = 0; i < predictor->used_pixels; i++) {
+        pred_gene_t index = predictor->pixels[i];
+        if (predictor->simd_pixels[i] == index) {
+            continue;
+        }
+
+        predictor->output_simd[i] = image[index];
+        for (int w = 0; w < CGP_INPUTS; w++) {
+            predictor->inputs_simd[w][i] = image[window_pixel(index, w)];
+        }
+        predictor->simd_pixels[i] = index;
+        gathered++;
+    }
+}
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static uint64_t sum_errors(fitness_error_t *row, unsigned int *cases, int count)
+{
+#ifdef AVX2
+    return _fitness_sum_errors_avx(row, cases, count);
+#else
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += row[cases[i]];
+    }
+    return sum;
+#endif
+}
+
+
+/**
+ * Predictor fitness - mean difference of predicted and real mean error
+ */
+static ga_fitness_t eval_predictor(pred_genome_t genome)
+{
+    double difference = 0;
+    for (int a = 0; a < ARCHIVE; a++) {
+        uint64_t sum = sum_errors(errors + (size_t) a * IMAGE_PIXELS,
+            genome->pixels, genome->used_pixels);
+        difference += fabs((double) sum / genome->used_pixels - real_means[a]);
+    }
+    return difference / ARCHIVE;
+}
+
+
+/**
+ * Checks prepared data match image
+ */
+static void check(pred_genome_t genome)
+{
+    for (int i = 0; i < genome->used_pixels; i++) {
+        pred_gene_t index = genome->pixels[i];
+        bool ok = genome->simd_pixels[i] == index
+            && genome->output_simd[i] == image[index];
+        for (int w = 0; w < CGP_INPUTS; w++) {
+            ok = ok && genome->inputs_simd[w][i] == image[window_pixel(index, w)];
+        }
+        if (!ok) {
+            fprintf(stderr, "Wrong data of pixel %u on position %d\n", index, i);
+            exit(1);
+        }
+    }
+}
+
+
+static void bench(pred_genome_type_t type, char const *name)
+{
+    pred_metadata_t metadata = {
+        .genome_type = type,
+        .max_gene_value = IMAGE_PIXELS - 1,
+        .genotype_length = IMAGE_PIXELS * PREDICTOR_SIZE,
+        .genotype_used_length = IMAGE_PIXELS * PREDICTOR_SIZE,
+        .mutation_rate = 0.05,
+        .offspring_elite = 0.25,
+        .offspring_combine = 0.5,
+    };
+    pred_init(&metadata);
+
+    ga_pop_t pop = pred_init_pop(POPULATION);
+    pred_genome_t archived = (pred_genome_t) pred_alloc_genome();
+
+    double offspring_time = 0, eval_time = 0, prepare_time = 0;
+    gathered = 0;
+
+    for (int g = 0; g < GENERATIONS; g++) {
+        double start = now();
+        if (g > 0) pred_offspring(pop);
+        double bred = now();
+
+        int best = 0;
+        for (int i = 0; i < pop->size; i++) {
+            ga_chr_t chr = pop->chromosomes[i];
+            chr->fitness = eval_predictor((pred_genome_t) chr->genome);
+            chr->has_fitness = true;
+            if (chr->fitness < pop->chromosomes[best]->fitness) best = i;
+        }
+        double evaluated = now();
+
+        pred_copy_genome(archived, pop->chromosomes[best]->genome);
+        pred_prepare_for_simd(archived);
+        double prepared = now();
+
+        offspring_time += bred - start;
+        eval_time += evaluated - bred;
+        prepare_time += prepared - evaluated;
+        check(archived);
+    }
+
+    printf("%s: offspring %7.2f ms, fitness %7.2f ms, prepare %6.2f ms "
+        "per generation, %5.1f %% of archived pixels gathered\n",
+        name, offspring_time / GENERATIONS * 1e3,
+        eval_time / GENERATIONS * 1e3, prepare_time / GENERATIONS * 1e3,
+        100.0 * gathered / archived->used_pixels / GENERATIONS);
+
+    pred_free_genome(archived);
+    ga_destroy_pop(pop);
+}
+
+
+int main(int argc, char const *argv[])
+{
+    rand_init_seed(42);
+
+    image = (cgp_value_t*) malloc(sizeof(cgp_value_t) * IMAGE_PIXELS);
+    // one row per archived circuit, padded by one error
+    errors = (fitness_error_t*) malloc(
+        sizeof(fitness_error_t) * ((size_t) IMAGE_PIXELS * ARCHIVE + 1));
+    if (image == NULL || errors == NULL) {
+        fprintf(stderr, "%s", "Out of memory.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < IMAGE_PIXELS; i++) {
+        image[i] = rand();
+    }
+    for (int a = 0; a < ARCHIVE; a++) {
+        uint64_t sum = 0;
+        for (int i = 0; i < IMAGE_PIXELS; i++) {
+            // circuits differ in their typical error
+            fitness_error_t error = rand() % (100 * (a + 1));
+            errors[(size_t) a * IMAGE_PIXELS + i] = error;
+            sum += error;
+        }
+        real_means[a] = (double) sum / IMAGE_PIXELS;
+    }
+    errors[(size_t) IMAGE_PIXELS * ARCHIVE] = 0;
+
+    bench(permuted, "Permuted");
+    bench(repeated, "Repeated");
+
+    free(image);
+    free(errors);
+    return 0;
+}
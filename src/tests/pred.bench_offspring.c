@@ -0,0 +1,107 @@
+/**
+ * Benchmarks creating new generation of predictors trained on large image
+ * (4096x4096 pixels), for both permuted and repeated genotype.
+ * "Stand-alone" test executable - no expected output provided.
+ * Compile with -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1
+ * Source files predictors.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../random.h"
+#include "../fitness.h"
+#include "../predictors.h"
+
+
+#define IMAGE_PIXELS (4096 * 4096)
+#define PREDICTOR_SIZE 0.0025
+#define POPULATION 32
+#define GENERATIONS 50
+
+
+/* fitness is not evaluated here */
+
+ga_fitness_t fitness_eval_predictor(ga_chr_t pred_chr)
+{
+    return 0;
+}
+
+
+ga_fitness_t fitness_eval_circular_predictor(ga_chr_t pred_chr)
+{
+    return 0;
+}
+
+
+void fitness_prepare_predictor_for_simd(pred_genome_t predictor)
+{
+}
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Checks that phenotype has no duplicate pixels and returns generation
+ * time in milliseconds
+ */
+static double bench(pred_genome_type_t type)
+{
+    pred_metadata_t metadata = {
+        .genome_type = type,
+        .max_gene_value = IMAGE_PIXELS - 1,
+        .genotype_length = IMAGE_PIXELS * PREDICTOR_SIZE,
+        .genotype_used_length = IMAGE_PIXELS * PREDICTOR_SIZE,
+        .mutation_rate = 0.05,
+        .offspring_elite = 0.25,
+        .offspring_combine = 0.5,
+    };
+    pred_init(&metadata);
+
+    ga_pop_t pop = pred_init_pop(POPULATION);
+    double start = now();
+
+    for (int g = 0; g < GENERATIONS; g++) {
+        for (int i = 0; i < pop->size; i++) {
+            pop->chromosomes[i]->fitness = rand_urange(0, 1000);
+            pop->chromosomes[i]->has_fitness = true;
+        }
+        pred_offspring(pop);
+    }
+
+    double time = now() - start;
+
+    char *seen = (char*) calloc(IMAGE_PIXELS, 1);
+    for (int i = 0; i < pop->size; i++) {
+        pred_genome_t genome = (pred_genome_t) pop->chromosomes[i]->genome;
+        for (int p = 0; p < genome->used_pixels; p++) {
+            if (seen[genome->pixels[p]] == i + 1) {
+                fprintf(stderr, "Duplicate pixel %u in predictor %d\n",
+                    genome->pixels[p], i);
+                exit(1);
+            }
+            seen[genome->pixels[p]] = i + 1;
+        }
+    }
+    free(seen);
+
+    ga_destroy_pop(pop);
+    return time / GENERATIONS * 1e3;
+}
+
+
+int main(int argc, char const *argv[])
+{
+    rand_init_seed(42);
+
+    printf("Permuted: %8.2f ms per generation\n", bench(permuted));
+    printf("Repeated: %8.2f ms per generation\n", bench(repeated));
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * Benchmarks summing errors of archived circuits in predictor phenotype
+ * against image size, with phenotype in genotype (random) and sorted order,
+ * scalar and with AVX2 gathers. Checks all variants give the same sums.
+ * "Stand-alone" test executable - no expected output provided.
+ * Compile with -DAVX2 -DCGP_COLS=8 -DCGP_ROWS=4 -DCGP_LBACK=1 -mavx2
+ * Source files cgp/cgp_core.c cgp/cgp_dump.c ifilter/cgp.c ifilter/cgp_avx.c ifilter/fitness_avx.c cpu.c ga.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../cpu.h"
+#include "../random.h"
+#include "../fitness.h"
+
+
+#define CASES 16384
+#define ARCHIVE 10
+#define REPEAT 200
+
+
+typedef uint64_t (*sum_func_t)(fitness_error_t *errors, unsigned int *cases,
+    int count);
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static int compare_cases(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int*) a;
+    unsigned int y = *(const unsigned int*) b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * Returns millions of cases summed per second
+ */
+static double bench(sum_func_t func, fitness_error_t *errors, int size,
+    unsigned int *cases, uint64_t *result)
+{
+    uint64_t sum = 0;
+    double start = now();
+    for (int r = 0; r < REPEAT; r++) {
+        for (int a = 0; a < ARCHIVE; a++) {
+            sum += func(errors + (size_t) a * size, cases, CASES);
+        }
+    }
+    double time = now() - start;
+
+    *result = sum;
+    return (double) CASES * ARCHIVE * REPEAT / time / 1e6;
+}
+
+
+int main(int argc, char const *argv[])
+{
+    // pre-flight check
+    if (!can_use_intel_core_4th_gen_features()) {
+        fprintf(stderr, "%s", "AVX2 not supported.\n");
+        exit(1);
+    }
+
+    rand_init_seed(42);
+
+    printf("%10s %12s %12s %12s %12s  (Mcases/s)\n",
+        "Image", "Random", "Random AVX2", "Sorted", "Sorted AVX2");
+
+    for (int side = 256; side <= 4096; side *= 2) {
+        int size = side * side;
+
+        // one row per archived circuit, padded by one error
+        fitness_error_t *errors = (fitness_error_t*) malloc(
+            sizeof(fitness_error_t) * ((size_t) size * ARCHIVE + 1));
+        unsigned int *cases = (unsigned int*) malloc(sizeof(unsigned int) * CASES);
+        if (errors == NULL || cases == NULL) {
+            fprintf(stderr, "%s", "Out of memory.\n");
+            exit(1);
+        }
+
+        for (size_t i = 0; i < (size_t) size * ARCHIVE + 1; i++) {
+            errors[i] = rand() & 0xFFFF;
+        }
+        for (int i = 0; i < CASES; i++) {
+            cases[i] = rand_urange(0, size - 1);
+        }
+
+        uint64_t sums[4];
+        double random = bench(fitness_sum_errors, errors, size, cases, &sums[0]);
+        double random_avx = bench(_fitness_sum_errors_avx, errors, size, cases, &sums[1]);
+        qsort(cases, CASES, sizeof(unsigned int), compare_cases);
+        double sorted = bench(fitness_sum_errors, errors, size, cases, &sums[2]);
+        double sorted_avx = bench(_fitness_sum_errors_avx, errors, size, cases, &sums[3]);
+
+        if (sums[0] != sums[1] || sums[0] != sums[2] || sums[0] != sums[3]) {
+            fprintf(stderr, "Sums differ: %lu %lu %lu %lu\n",
+                sums[0], sums[1], sums[2], sums[3]);
+            exit(1);
+        }
+
+        char name[20];
+        snprintf(name, sizeof(name), "%dx%d", side, side);
+        printf("%10s %12.1f %12.1f %12.1f %12.1f\n",
+            name, random, random_avx, sorted, sorted_avx);
+
+        free(errors);
+        free(cases);
+    }
+
+    return 0;
+}
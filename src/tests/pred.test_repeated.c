@@ -13,13 +13,15 @@ int main(int argc, char const *argv[])
         1, 2, 3, 4, 1, 1, 5, 6, 9, 10
     };
 
-    bool used_values[10] = {};
+    uint64_t used_values[1] = {};
     unsigned int pixels[10] = {};
+    unsigned int buffer[10] = {};
 
     struct pred_genome genome = {
         ._genes = &genes[0],
         ._used_values = &used_values[0],
         .pixels = &pixels[0],
+        ._pixels_buffer = &buffer[0],
     };
 
     pred_calculate_phenotype(&genome);
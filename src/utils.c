@@ -170,6 +170,16 @@ void print_sysinfo()
         printf("OpenMP is not compiled, coevolution is not available.\n");
     #endif
 
+    #ifdef AVX512
+        if (can_use_avx512bw()) {
+            printf("AVX-512BW is compiled.\n");
+        } else {
+            printf("AVX-512BW is compiled, but not supported by CPU.\n");
+        }
+    #else
+        printf("AVX-512BW is not compiled. Recompile with -DAVX512 defined to enable.\n");
+    #endif
+
     #ifdef AVX2
         if (can_use_intel_core_4th_gen_features()) {
             printf("AVX2 is compiled.\n");